@@ -0,0 +1,197 @@
+#include "account_index.h"
+#include "limit_rules.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static bool parseAccountKey(const std::string& key, uint64_t& account, std::string& field) {
+    size_t pos = key.find('_');
+    if (pos == 0 || pos == std::string::npos || pos > 19) return false;
+    for (size_t i = 0; i < pos; i++) {
+        if (key[i] < '0' || key[i] > '9') return false;
+    }
+    account = std::strtoull(key.c_str(), nullptr, 10);
+    field = key.substr(pos);
+    return true;
+}
+
+static int64_t parseCents(const std::string& value) {
+    return std::llround(std::strtod(value.c_str(), nullptr) * 100);
+}
+
+static std::string formatAccount(uint64_t account) {
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "%019llu", (unsigned long long)account);
+    return buffer;
+}
+
+void AccountIndex::assignField(Entry& entry, const std::string& field, const std::string& value) {
+    if (field == "_balance") entry.balanceCents = parseCents(value);
+    else if (field == "_daily_withdrawal") entry.dailyCents = parseCents(value);
+    else if (field == "_locked") entry.locked = value == "true";
+    else if (field == "_locked_until") entry.lockedUntil = std::strtoll(value.c_str(), nullptr, 10);
+    else if (field == "_name") entry.name = value;
+}
+
+// 全量重建：先填好每个账户的条目，再把各索引按排序后的顺序批量插入（带提示插入为线性时间）
+void AccountIndex::rebuild(const std::map<std::string, std::string>& data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    byBalance.clear();
+    byDailyWithdrawal.clear();
+    locked.clear();
+    byLockedUntil.clear();
+    byName.clear();
+
+    std::vector<uint64_t> order;
+    Entry* current = nullptr;
+    uint64_t currentAccount = 0;
+    for (const auto& pair : data) {
+        uint64_t account;
+        std::string field;
+        if (!parseAccountKey(pair.first, account, field)) continue;
+        // 数据按键排序，同一账户的字段相邻
+        if (!current || account != currentAccount) {
+            auto inserted = entries.try_emplace(account);
+            if (inserted.second) order.push_back(account);
+            current = &inserted.first->second;
+            currentAccount = account;
+        }
+        assignField(*current, field, pair.second);
+    }
+
+    std::vector<std::pair<int64_t, uint64_t>> balances, dailies, lockedUntils;
+    std::vector<std::pair<std::string, uint64_t>> names;
+    balances.reserve(order.size());
+    dailies.reserve(order.size());
+    names.reserve(order.size());
+    for (uint64_t account : order) {
+        const Entry& entry = entries[account];
+        balances.emplace_back(entry.balanceCents, account);
+        dailies.emplace_back(entry.dailyCents, account);
+        if (entry.lockedUntil) lockedUntils.emplace_back(entry.lockedUntil, account);
+        if (entry.locked) locked.insert(locked.end(), account);
+        if (!entry.name.empty()) names.emplace_back(entry.name, account);
+    }
+    std::sort(balances.begin(), balances.end());
+    std::sort(dailies.begin(), dailies.end());
+    std::sort(lockedUntils.begin(), lockedUntils.end());
+    std::sort(names.begin(), names.end());
+    byBalance.insert(balances.begin(), balances.end());
+    byDailyWithdrawal.insert(dailies.begin(), dailies.end());
+    byLockedUntil.insert(lockedUntils.begin(), lockedUntils.end());
+    byName.insert(names.begin(), names.end());
+}
+
+void AccountIndex::apply(const ChangeBatch& changes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& change : changes) {
+        uint64_t account;
+        std::string field;
+        if (parseAccountKey(change.first, account, field)) {
+            setFieldLocked(account, field, change.second);
+        }
+    }
+}
+
+// 先从旧值所在的索引中删除，再按新值插入
+void AccountIndex::setFieldLocked(uint64_t account, const std::string& field, const std::string& value) {
+    auto inserted = entries.try_emplace(account);
+    Entry& entry = inserted.first->second;
+    if (inserted.second) {
+        byBalance.emplace(0, account);
+        byDailyWithdrawal.emplace(0, account);
+    }
+
+    if (field == "_balance") {
+        byBalance.erase({ entry.balanceCents, account });
+        entry.balanceCents = parseCents(value);
+        byBalance.emplace(entry.balanceCents, account);
+    }
+    else if (field == "_daily_withdrawal") {
+        byDailyWithdrawal.erase({ entry.dailyCents, account });
+        entry.dailyCents = parseCents(value);
+        byDailyWithdrawal.emplace(entry.dailyCents, account);
+    }
+    else if (field == "_locked") {
+        entry.locked = value == "true";
+        if (entry.locked) {
+            locked.insert(account);
+        }
+        else {
+            locked.erase(account);
+        }
+    }
+    else if (field == "_locked_until") {
+        if (entry.lockedUntil) byLockedUntil.erase({ entry.lockedUntil, account });
+        entry.lockedUntil = std::strtoll(value.c_str(), nullptr, 10);
+        if (entry.lockedUntil) byLockedUntil.emplace(entry.lockedUntil, account);
+    }
+    else if (field == "_name") {
+        byName.erase({ entry.name, account });
+        entry.name = value;
+        if (!entry.name.empty()) byName.emplace(entry.name, account);
+    }
+}
+
+AccountSummary AccountIndex::summaryLocked(uint64_t account) {
+    const Entry& entry = entries[account];
+    return AccountSummary{ formatAccount(account), entry.name, entry.balanceCents / 100.0,
+        entry.dailyCents / 100.0, entry.locked, entry.lockedUntil };
+}
+
+std::vector<AccountSummary> AccountIndex::topBalances(size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<AccountSummary> result;
+    for (auto it = byBalance.rbegin(); it != byBalance.rend() && result.size() < limit; ++it) {
+        result.push_back(summaryLocked(it->second));
+    }
+    return result;
+}
+
+// 永久锁定的账户在前，其后是解锁时间晚于now的临时锁定
+std::vector<AccountSummary> AccountIndex::lockedAccounts(int64_t now, size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<AccountSummary> result;
+    for (auto it = locked.begin(); it != locked.end() && result.size() < limit; ++it) {
+        result.push_back(summaryLocked(*it));
+    }
+    for (auto it = byLockedUntil.upper_bound({ now, UINT64_MAX }); it != byLockedUntil.end() && result.size() < limit; ++it) {
+        if (!entries[it->second].locked) result.push_back(summaryLocked(it->second));
+    }
+    return result;
+}
+
+std::vector<AccountSummary> AccountIndex::nearDailyLimit(const LimitTable& limits, double marginRatio, size_t limit) {
+    auto thresholdOf = [marginRatio](const LimitRow& row) -> int64_t {
+        return row.withdrawDaily - std::llround(row.withdrawDaily * marginRatio);
+    };
+    int64_t lowest = thresholdOf(limits.row(0));
+    for (size_t tier = 1; tier < limits.tierCount(); tier++) {
+        lowest = std::min(lowest, thresholdOf(limits.row(tier)));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<AccountSummary> result;
+    auto first = byDailyWithdrawal.lower_bound({ lowest, 0 });
+    for (auto it = byDailyWithdrawal.rbegin(); it != std::make_reverse_iterator(first) && result.size() < limit; ++it) {
+        if (it->first >= thresholdOf(limits.rowFor(it->second))) result.push_back(summaryLocked(it->second));
+    }
+    return result;
+}
+
+std::vector<AccountSummary> AccountIndex::findByName(const std::string& prefix, size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<AccountSummary> result;
+    for (auto it = byName.lower_bound({ prefix, 0 }); it != byName.end() && result.size() < limit; ++it) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+        result.push_back(summaryLocked(it->second));
+    }
+    return result;
+}
+
+size_t AccountIndex::accountCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,65 @@
+#ifndef ACCOUNT_INDEX_H
+#define ACCOUNT_INDEX_H
+
+#include "replication.h"
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+class LimitTable;
+
+struct AccountSummary {
+    std::string account;
+    std::string name;
+    double balance;
+    double dailyWithdrawal;
+    bool locked;
+    int64_t lockedUntil;
+};
+
+// 运维查询用的二级索引，随每次提交增量维护：
+//   余额有序索引      (余额分, 账号)，取余额最高的N个
+//   当日取款有序索引  (当日取款分, 账号)，取接近单日限额的账户
+//   锁定集合          永久锁定的账号 + 按解锁时间排序的临时锁定
+//   姓名索引          (姓名, 账号)，按前缀查找
+// 查询只遍历结果所在的区间，与账户总数无关。
+class AccountIndex {
+public:
+    void rebuild(const std::map<std::string, std::string>& data);
+    void apply(const ChangeBatch& changes);
+
+    std::vector<AccountSummary> topBalances(size_t limit);
+    std::vector<AccountSummary> lockedAccounts(int64_t now, size_t limit);
+    // 按各账户所属层级的单日限额：当日取款达到本层级限额的 (1 - marginRatio) 即列出。
+    // 从最高的当日取款往下扫，到所有层级中最低的门槛为止
+    std::vector<AccountSummary> nearDailyLimit(const LimitTable& limits, double marginRatio, size_t limit);
+    std::vector<AccountSummary> findByName(const std::string& prefix, size_t limit);
+    size_t accountCount();
+
+private:
+    struct Entry {
+        int64_t balanceCents = 0;
+        int64_t dailyCents = 0;
+        int64_t lockedUntil = 0;
+        bool locked = false;
+        std::string name;
+    };
+
+    static void assignField(Entry& entry, const std::string& field, const std::string& value);
+    void setFieldLocked(uint64_t account, const std::string& field, const std::string& value);
+    AccountSummary summaryLocked(uint64_t account);
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::set<std::pair<int64_t, uint64_t>> byBalance;
+    std::set<std::pair<int64_t, uint64_t>> byDailyWithdrawal;
+    std::set<uint64_t> locked;
+    std::set<std::pair<int64_t, uint64_t>> byLockedUntil;
+    std::set<std::pair<std::string, uint64_t>> byName;
+    std::mutex mutex;
+};
+
+#endif
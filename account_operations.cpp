@@ -0,0 +1,155 @@
+#include "account_operations.h"
+#include "limit_rules.h"
+#include <charconv>
+#include <cstdio>
+
+void formatAmount(std::string& out, double value) {
+    char buffer[64];
+    int length = std::snprintf(buffer, sizeof(buffer), "%f", value);
+    out.assign(buffer, length);
+}
+
+AccountOperations::AccountOperations(AccountStore& store, const std::string& terminalId, LimitRules& rules) :
+    store(store),
+    terminalId(terminalId),
+    rules(rules),
+    requestCounter(0),
+    batch(2) {
+}
+
+const std::string& AccountOperations::key(const std::string& account, const char* field) {
+    keyBuffer.assign(account).append(field);
+    return keyBuffer;
+}
+
+double AccountOperations::balanceOf(const std::string& account) {
+    return std::stod(store.get(key(account, "_balance")));
+}
+
+double AccountOperations::dailyWithdrawalOf(const std::string& account) {
+    return std::stod(store.get(key(account, "_daily_withdrawal")));
+}
+
+bool AccountOperations::accountExists(const std::string& account) {
+    return store.hasKey(key(account, "_password"));
+}
+
+OperationStatus AccountOperations::login(LockoutManager& lockouts, const std::string& account, const std::string& password,
+    int64_t now, LockoutManager::Status& status) {
+    if (store.get(key(account, "_locked")) == "true") return OPERATION_ACCOUNT_LOCKED;
+
+    uint64_t number = accountNumber(account);
+    lockouts.advance(now);
+    status = lockouts.status(number, now);
+    if (!status.locked) {
+        // 本终端没有锁定记录时，以存储中的锁定截止时间为准
+        std::string lockedUntil = store.get(key(account, "_locked_until"));
+        if (!lockedUntil.empty() && std::stoll(lockedUntil) > now) {
+            lockouts.restoreLock(number, std::stoll(lockedUntil), now);
+            status = lockouts.status(number, now);
+        }
+    }
+    if (status.locked) return OPERATION_TEMPORARILY_LOCKED;
+
+    if (store.get(key(account, "_password")) == password) {
+        lockouts.recordSuccess(number);
+        return OPERATION_OK;
+    }
+    status = lockouts.recordFailure(number, now);
+    if (status.locked) {
+        // 其他终端同时写入时提交冲突，重读后保留较晚的截止时间
+        std::string lockedUntilKey = account + "_locked_until";
+        for (int attempt = 0; attempt < 8; attempt++) {
+            std::string existing = store.get(lockedUntilKey);
+            if (!existing.empty() && std::stoll(existing) >= status.lockedUntil) break;
+            ChangeBatch lock{ { lockedUntilKey, std::to_string(status.lockedUntil) } };
+            if (store.commit(lock, "", RequestResult{ REQUEST_NONE, 0 })) break;
+        }
+    }
+    return OPERATION_WRONG_PASSWORD;
+}
+
+// 与上一次未确认成功的操作相同则复用其请求ID，保证超时重试不会重复扣款
+void AccountOperations::requestIdFor() {
+    if (operationKey != pendingOperationKey) {
+        pendingOperationKey.assign(operationKey);
+        char digits[24];
+        auto end = std::to_chars(digits, digits + sizeof(digits), ++requestCounter).ptr;
+        pendingRequestId.assign(terminalId).append("-").append(digits, end);
+    }
+}
+
+OperationStatus AccountOperations::prepareWithdrawal(const std::string& account, double amount) {
+    double balance = balanceOf(account);
+    double dailyWithdrawal = dailyWithdrawalOf(account);
+    OperationStatus status = rules.table().checkWithdrawal(accountNumber(account), toCents(amount), toCents(balance),
+        toCents(dailyWithdrawal));
+    if (status != OPERATION_OK) return status;
+
+    batch[0].first.assign(account).append("_balance");
+    formatAmount(batch[0].second, balance - amount);
+    batch[1].first.assign(account).append("_daily_withdrawal");
+    formatAmount(batch[1].second, dailyWithdrawal + amount);
+    return OPERATION_OK;
+}
+
+OperationStatus checkTransferRules(bool selfTransfer, bool targetExists, double amount, double balance) {
+    if (selfTransfer) return OPERATION_SELF_TRANSFER;
+    if (!targetExists) return OPERATION_TARGET_MISSING;
+    if (amount <= 0) return OPERATION_NOT_POSITIVE;
+    if (amount > balance) return OPERATION_INSUFFICIENT_BALANCE;
+    return OPERATION_OK;
+}
+
+// 转入账户存在且金额为正时才读余额
+OperationStatus AccountOperations::prepareTransfer(const std::string& from, const std::string& to, double amount) {
+    bool selfTransfer = to == from;
+    bool targetExists = !selfTransfer && accountExists(to);
+    double balance = targetExists && amount > 0 ? balanceOf(from) : 0;
+    OperationStatus status = rules.table().checkTransfer(accountNumber(from), selfTransfer, targetExists, toCents(amount),
+        toCents(balance));
+    if (status != OPERATION_OK) return status;
+    double targetBalance = balanceOf(to);
+
+    batch[0].first.assign(from).append("_balance");
+    formatAmount(batch[0].second, balance - amount);
+    batch[1].first.assign(to).append("_balance");
+    formatAmount(batch[1].second, targetBalance + amount);
+    return OPERATION_OK;
+}
+
+OperationStatus AccountOperations::commitPrepared(const RequestResult& result) {
+    if (!store.commit(batch, pendingRequestId, result)) return OPERATION_COMMIT_FAILED;
+    pendingOperationKey.clear();
+    return OPERATION_OK;
+}
+
+OperationStatus AccountOperations::withdraw(const std::string& account, const std::string& amountText, double amount, RequestResult& previous) {
+    operationKey.assign("W|").append(account).append("|").append(amountText);
+    requestIdFor();
+    if (store.lookupRequest(pendingRequestId, previous)) {
+        pendingOperationKey.clear();
+        return OPERATION_DUPLICATE;
+    }
+
+    rules.refresh();
+    amount = toCents(amount) / 100.0;
+    OperationStatus status = prepareWithdrawal(account, amount);
+    if (status != OPERATION_OK) return status;
+    return commitPrepared(RequestResult{ REQUEST_WITHDRAW, amount });
+}
+
+OperationStatus AccountOperations::transfer(const std::string& from, const std::string& to, const std::string& amountText, double amount, RequestResult& previous) {
+    operationKey.assign("T|").append(from).append("|").append(to).append("|").append(amountText);
+    requestIdFor();
+    if (store.lookupRequest(pendingRequestId, previous)) {
+        pendingOperationKey.clear();
+        return OPERATION_DUPLICATE;
+    }
+
+    rules.refresh();
+    amount = toCents(amount) / 100.0;
+    OperationStatus status = prepareTransfer(from, to, amount);
+    if (status != OPERATION_OK) return status;
+    return commitPrepared(RequestResult{ REQUEST_TRANSFER, amount });
+}
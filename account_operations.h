@@ -0,0 +1,75 @@
+#ifndef ACCOUNT_OPERATIONS_H
+#define ACCOUNT_OPERATIONS_H
+
+#include "account_store.h"
+#include "lockout_manager.h"
+#include <string>
+#include <cstdint>
+
+enum OperationStatus {
+    OPERATION_OK,
+    OPERATION_DUPLICATE,            // 同一请求已提交过，原结果见previous
+    OPERATION_NOT_POSITIVE,
+    OPERATION_BAD_DENOMINATION,     // 无法用钞箱现有面额凑出
+    OPERATION_OVER_SINGLE_LIMIT,
+    OPERATION_INSUFFICIENT_BALANCE,
+    OPERATION_OVER_DAILY_LIMIT,
+    OPERATION_OVER_TRANSFER_LIMIT,
+    OPERATION_TARGET_MISSING,
+    OPERATION_SELF_TRANSFER,
+    OPERATION_ACCOUNT_LOCKED,       // 人工锁定（_locked为true），需联系客服
+    OPERATION_TEMPORARILY_LOCKED,   // 密码错误次数过多，锁定到status.lockedUntil
+    OPERATION_WRONG_PASSWORD,       // status给出剩余次数；本次导致锁定时status.locked为true
+    OPERATION_COMMIT_FAILED
+};
+
+class LimitRules;
+
+// 转账的基本规则，不读存储、不含层级限额：定期转账（已预先授权）使用
+OperationStatus checkTransferRules(bool selfTransfer, bool targetExists, double amount, double balance);
+// 与std::to_string(double)相同的金额文本格式，但写入已有的字符串
+void formatAmount(std::string& out, double value);
+
+// 登录、取款与转账的核心流程：请求查重、规则校验、组装修改批次、提交。界面与基准、压测工具共用。
+// 限额与面额规则来自LimitRules的编译表，每次操作前先让它检查配置文件是否有更新。
+// 键名、金额文本、请求ID和修改批次都是成员缓冲区，每次操作覆盖重写，
+// 稳定状态下准备阶段不分配堆内存；提交阶段的分配取决于存储实现。
+class AccountOperations {
+public:
+    AccountOperations(AccountStore& store, const std::string& terminalId, LimitRules& rules);
+
+    double balanceOf(const std::string& account);
+    double dailyWithdrawalOf(const std::string& account);
+    bool accountExists(const std::string& account);
+
+    // 登录校验：人工锁定、临时锁定、密码。临时锁定先看本终端的失败计数，再看存储中
+    // 其他终端或重启前写下的 _locked_until；密码错误累计到锁定时写入 _locked_until
+    OperationStatus login(LockoutManager& lockouts, const std::string& account, const std::string& password, int64_t now,
+        LockoutManager::Status& status);
+
+    // 只做校验并填好修改批次，不提交
+    OperationStatus prepareWithdrawal(const std::string& account, double amount);
+    OperationStatus prepareTransfer(const std::string& from, const std::string& to, double amount);
+
+    // amountText是用户输入的原文，同一账号同一输入的重试沿用上一次未成功提交的请求ID
+    OperationStatus withdraw(const std::string& account, const std::string& amountText, double amount, RequestResult& previous);
+    OperationStatus transfer(const std::string& from, const std::string& to, const std::string& amountText, double amount, RequestResult& previous);
+
+private:
+    const std::string& key(const std::string& account, const char* field);
+    void requestIdFor();
+    OperationStatus commitPrepared(const RequestResult& result);
+
+    AccountStore& store;
+    std::string terminalId;
+    LimitRules& rules;
+
+    std::string keyBuffer;
+    std::string operationKey;
+    std::string pendingOperationKey;
+    std::string pendingRequestId;
+    uint64_t requestCounter;
+    ChangeBatch batch;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "account_prefix_index.h"
+#include <algorithm>
+
+static const int ACCOUNT_DIGITS = 19;
+
+static size_t countRange(const std::vector<uint64_t>& values, uint64_t low, uint64_t high) {
+    return std::upper_bound(values.begin(), values.end(), high) - std::lower_bound(values.begin(), values.end(), low);
+}
+
+void AccountPrefixIndex::build(std::vector<uint64_t> accounts) {
+    std::sort(accounts.begin(), accounts.end());
+    accounts.erase(std::unique(accounts.begin(), accounts.end()), accounts.end());
+    accounts.shrink_to_fit();
+    sorted = std::move(accounts);
+    recent.clear();
+}
+
+void AccountPrefixIndex::insert(uint64_t account) {
+    if (contains(account)) return;
+    recent.insert(std::upper_bound(recent.begin(), recent.end(), account), account);
+    if (recent.size() >= MERGE_THRESHOLD) {
+        std::vector<uint64_t> merged;
+        merged.reserve(sorted.size() + recent.size());
+        std::merge(sorted.begin(), sorted.end(), recent.begin(), recent.end(), std::back_inserter(merged));
+        sorted = std::move(merged);
+        recent.clear();
+    }
+}
+
+// 前缀p（k位）对应区间 [p * 10^(19-k), (p + 1) * 10^(19-k) - 1]，10^19仍在uint64范围内
+bool accountPrefixRange(const std::string& prefix, uint64_t& low, uint64_t& high) {
+    if (prefix.empty() || prefix.size() > ACCOUNT_DIGITS) return false;
+    uint64_t value = 0;
+    for (char c : prefix) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    uint64_t scale = 1;
+    for (size_t i = prefix.size(); i < ACCOUNT_DIGITS; i++) {
+        scale *= 10;
+    }
+    low = value * scale;
+    high = (value + 1) * scale - 1;
+    return true;
+}
+
+size_t AccountPrefixIndex::countPrefix(const std::string& prefix) const {
+    uint64_t low, high;
+    if (!accountPrefixRange(prefix, low, high)) return 0;
+    return countRange(sorted, low, high) + countRange(recent, low, high);
+}
+
+bool AccountPrefixIndex::contains(uint64_t account) const {
+    return std::binary_search(sorted.begin(), sorted.end(), account) ||
+        std::binary_search(recent.begin(), recent.end(), account);
+}
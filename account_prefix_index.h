@@ -0,0 +1,34 @@
+#ifndef ACCOUNT_PREFIX_INDEX_H
+#define ACCOUNT_PREFIX_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// 账号前缀索引：19位账号按数值排序后紧凑存放在uint64数组中（每个账号8字节）。
+// 1-19位数字的前缀恰好对应一段连续的数值区间，两次二分查找即可得到匹配个数，
+// 每次按键的查询与账户总数成对数关系。
+// 新注册的账号先放进小的有序增量数组，超过阈值后再合并进主数组，避免每次插入都搬动整个数组。
+class AccountPrefixIndex {
+public:
+    void build(std::vector<uint64_t> accounts);
+    void insert(uint64_t account);
+
+    // prefix不是1-19位数字时返回0
+    size_t countPrefix(const std::string& prefix) const;
+    bool contains(uint64_t account) const;
+
+    size_t size() const { return sorted.size() + recent.size(); }
+    size_t memoryBytes() const { return (sorted.capacity() + recent.capacity()) * sizeof(uint64_t); }
+
+private:
+    static const size_t MERGE_THRESHOLD = 4096;
+
+    std::vector<uint64_t> sorted;
+    std::vector<uint64_t> recent;
+};
+
+// 前缀对应的账号数值区间 [low, high]；prefix不是1-19位数字时返回false
+bool accountPrefixRange(const std::string& prefix, uint64_t& low, uint64_t& high);
+
+#endif
@@ -0,0 +1,391 @@
+#include "account_store.h"
+#include "columnar_snapshot.h"
+#include "audit_log.h"
+#include "durable_file.h"
+#include <cstdio>
+#include <unistd.h>
+#include <cstdlib>
+#include <ctime>
+
+// 事务日志超过该大小时做检查点
+static const size_t TX_LOG_CHECKPOINT_BYTES = 4 << 20;
+// 检查点每次持锁复制的键数
+static const size_t CHECKPOINT_CHUNK_KEYS = 4096;
+// 读集槽位预留的键、值长度，常见的键名和金额文本复用时不再分配
+static const size_t READ_SET_TEXT_BYTES = 48;
+
+std::string accountOfKey(const std::string& key) {
+    size_t pos = key.find('_');
+    return pos == std::string::npos ? key : key.substr(0, pos);
+}
+
+uint64_t hashKey(const std::string& text) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+int64_t unixTimeNow() {
+    return (int64_t)time(nullptr);
+}
+
+// 有密码字段的19位账号即已开户的账号
+static bool isPasswordKey(const std::string& key) {
+    static const std::string suffix = "_password";
+    return key.size() == 19 + suffix.size() && key.compare(19, suffix.size(), suffix) == 0;
+}
+
+bool saveAccountData(const SimpleJson& json, const std::string& dataFile) {
+    if (isColumnarSnapshotFile(dataFile)) {
+        return saveColumnarSnapshot(json.getAll(), dataFile, columnarCompressionAvailable());
+    }
+    std::string tmp = dataFile + ".tmp";
+    if (!json.saveToFile(tmp)) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return replaceFileDurably(tmp, dataFile);
+}
+
+LocalAccountStore::LocalAccountStore(const std::string& dataFile, size_t dedupBudgetBytes, int dedupWindowSeconds) :
+    dataFile(dataFile),
+    replication(nullptr),
+    index(nullptr),
+    audit(nullptr),
+    txLog(dataFile + ".txlog"),
+    dedup(dedupBudgetBytes, dedupWindowSeconds),
+    commitCount(0),
+    conflicts(0),
+    loaded(false),
+    uncheckpointed(false),
+    checkpointing(false),
+    trackingChanges(false) {
+}
+
+LocalAccountStore::~LocalAccountStore() {
+    if (loaded && uncheckpointed) {
+        checkpoint();
+    }
+}
+
+bool loadAccountData(const std::string& dataFile, std::map<std::string, std::string>& data) {
+    data.clear();
+    bool exists = ::access(dataFile.c_str(), F_OK) == 0;
+    if (exists && isColumnarSnapshotFile(dataFile)) {
+        if (!loadColumnarSnapshot(dataFile, data)) return false;
+    }
+    else if (exists) {
+        SimpleJson json;
+        if (!json.loadFromFile(dataFile)) return false;
+        data = json.getAll();
+    }
+    bool replayed = false;
+    for (const auto& log : { dataFile + ".txlog.checkpoint", dataFile + ".txlog" }) {
+        TransactionLog(log).replay([&](const TransactionRecord& record) {
+            for (const auto& change : record.changes) {
+                data[change.first] = change.second;
+            }
+            replayed = true;
+        });
+    }
+    return exists || replayed;
+}
+
+bool LocalAccountStore::load() {
+    std::lock_guard<std::mutex> lock(mutex);
+    bool exists = loadDataLocked();
+
+    // 数据文件落后于事务日志（上次检查点之后的提交，或检查点中途退出），按顺序重放即可补齐
+    int64_t now = unixTimeNow();
+    bool replayed = false;
+    std::vector<TransactionRecord> recent;
+    auto apply = [&](const TransactionRecord& record) {
+        for (const auto& change : record.changes) {
+            data.set(change.first, change.second);
+        }
+        if (!record.requestId.empty() && record.committedAt + dedup.window() > now) {
+            dedup.insert(record.requestId, record.committedAt, record.result);
+        }
+        if (audit && !record.changes.empty()) {
+            recent.push_back(record);
+        }
+        replayed = true;
+    };
+    TransactionLog(dataFile + ".txlog.checkpoint").replay(apply);
+    txLog.replay(apply);
+    txLog.open();
+    loaded = true;
+    if (audit && !audit->open(data.getAll(), recent)) {
+        return false;
+    }
+    // 数据文件没能落盘时保留事务日志，下次启动再重放
+    if (replayed && saveAccountData(data, dataFile)) {
+        compactLogsLocked(now, false);
+    }
+    if (index) {
+        index->rebuild(data.getAll());
+    }
+    std::vector<uint64_t> accounts;
+    for (const auto& pair : data.getAll()) {
+        if (isPasswordKey(pair.first)) {
+            accounts.push_back(std::strtoull(pair.first.c_str(), nullptr, 10));
+        }
+    }
+    prefixes.build(std::move(accounts));
+    return exists || replayed;
+}
+
+// 读取也加锁：多个处理线程共用一个存储时，读取与其他线程的提交互斥
+std::string LocalAccountStore::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string value = data.get(key);
+    ReadSet& reads = readSets[std::this_thread::get_id()];
+    if (reads.entries.empty()) {
+        reads.entries.resize(READ_SET_KEYS);
+        for (auto& entry : reads.entries) {
+            entry.first.reserve(READ_SET_TEXT_BYTES);
+            entry.second.reserve(READ_SET_TEXT_BYTES);
+        }
+    }
+    for (size_t i = 0; i < reads.used; i++) {
+        if (reads.entries[i].first == key) {
+            reads.entries[i].second = value;
+            return value;
+        }
+    }
+    if (reads.used < READ_SET_KEYS) {
+        reads.entries[reads.used].first = key;
+        reads.entries[reads.used].second = value;
+        reads.used++;
+    }
+    else if (!reads.overflowed) {
+        reads.overflowed = true;
+        reads.overflowedAt = commitCount;
+    }
+    return value;
+}
+
+bool LocalAccountStore::hasKey(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return data.hasKey(key);
+}
+
+std::string LocalAccountStore::findAccountByIdCard(const std::string& idCard) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return data.findAccountByIdCard(idCard);
+}
+
+bool LocalAccountStore::commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) {
+    bool checkpointDue = false;
+    if (!applyCommit(changes, requestId, result, checkpointDue)) {
+        return false;
+    }
+    // 等备机确认在锁外进行，备机接入取快照时要取这把锁
+    if (replication && !changes.empty()) {
+        replication->waitForStandby();
+    }
+    // 检查点在锁外写数据文件，不阻塞其他线程的读取和提交
+    if (checkpointDue) {
+        checkpoint();
+    }
+    return true;
+}
+
+bool LocalAccountStore::applyCommit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result,
+    bool& checkpointDue) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = readSets.find(std::this_thread::get_id());
+    if (found != readSets.end()) {
+        ReadSet& reads = found->second;
+        bool changed = reads.overflowed && reads.overflowedAt != commitCount;
+        for (size_t i = 0; i < reads.used && !changed; i++) {
+            const auto& read = reads.entries[i];
+            for (const auto& change : changes) {
+                if (change.first == read.first) {
+                    changed = data.get(read.first) != read.second;
+                    break;
+                }
+            }
+        }
+        reads.used = 0;
+        reads.overflowed = false;
+        if (changed) {
+            conflicts++;
+            return false;
+        }
+    }
+    TransactionRecord record{ requestId, result, unixTimeNow(), changes };
+    if (!txLog.append(record)) {
+        return false;
+    }
+    commitCount++;
+    uncheckpointed = true;
+    if (audit) {
+        audit->append(record);
+    }
+
+    for (const auto& change : changes) {
+        data.set(change.first, change.second);
+        if (trackingChanges) {
+            changedAccounts.insert(accountOfKey(change.first));
+        }
+        if (isPasswordKey(change.first)) {
+            prefixes.insert(std::strtoull(change.first.c_str(), nullptr, 10));
+        }
+    }
+    if (!requestId.empty()) {
+        dedup.insert(requestId, record.committedAt, result);
+    }
+    if (index) {
+        index->apply(changes);
+    }
+    if (replication && !changes.empty()) {
+        replication->publish(changes);
+    }
+    checkpointDue = !checkpointing && txLog.size() > TX_LOG_CHECKPOINT_BYTES;
+    return true;
+}
+
+bool LocalAccountStore::lookupRequest(const std::string& requestId, RequestResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dedup.lookup(requestId, unixTimeNow(), result);
+}
+
+bool LocalAccountStore::loadDataLocked() {
+    if (!isColumnarSnapshotFile(dataFile)) {
+        return data.loadFromFile(dataFile);
+    }
+    std::map<std::string, std::string> entries;
+    if (!loadColumnarSnapshot(dataFile, entries)) return false;
+    data.clear();
+    for (const auto& entry : entries) {
+        data.set(entry.first, entry.second);
+    }
+    return true;
+}
+
+bool LocalAccountStore::checkpoint() {
+    std::string rotated = dataFile + ".txlog.checkpoint";
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (checkpointing) return true;
+        // 审计日志没落盘时不动事务日志，未审计的提交还要留在里面
+        if (audit && !audit->flush()) return false;
+        // 上次检查点没做完时轮换日志还在，不再轮换，重写数据文件后一并压缩
+        if (::access(rotated.c_str(), F_OK) != 0 && !txLog.rotate(rotated)) return false;
+        checkpointing = true;
+        uncheckpointed = false;
+    }
+
+    SimpleJson image;
+    std::vector<std::pair<std::string, std::string>> chunk;
+    std::string after;
+    for (bool more = true; more; ) {
+        chunk.clear();
+        more = copyRange(after, CHECKPOINT_CHUNK_KEYS, chunk);
+        for (const auto& entry : chunk) {
+            image.set(entry.first, entry.second);
+        }
+        if (!chunk.empty()) after = chunk.back().first;
+    }
+    bool saved = saveAccountData(image, dataFile);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    checkpointing = false;
+    if (!saved) uncheckpointed = true;
+    return saved && compactLogsLocked(unixTimeNow(), true);
+}
+
+// 轮换日志的修改已在数据文件里，只留下去重窗口内的请求结果；当前日志在检查点期间的提交
+// 不一定被复制到，修改须保留（load()时数据文件已包含全部修改，两份日志都只留结果）。
+// 合并重写为当前日志并fsync目录后才删除轮换日志
+bool LocalAccountStore::compactLogsLocked(int64_t now, bool keepCurrentChanges) {
+    std::string rotated = dataFile + ".txlog.checkpoint";
+    int64_t keepAfter = now - dedup.window();
+    std::vector<TransactionRecord> records;
+    auto keepResult = [&](const TransactionRecord& record) {
+        if (!record.requestId.empty() && record.committedAt > keepAfter) {
+            records.push_back({ record.requestId, record.result, record.committedAt, ChangeBatch() });
+        }
+    };
+    TransactionLog(rotated).replay(keepResult);
+    if (keepCurrentChanges) {
+        txLog.replay([&](const TransactionRecord& record) { records.push_back(record); });
+    }
+    else {
+        txLog.replay(keepResult);
+    }
+    if (!txLog.rewrite(records) || !syncParentDirectory(dataFile)) return false;
+    std::remove(rotated.c_str());
+    return true;
+}
+
+void LocalAccountStore::setReplication(ReplicationPrimary* primary) {
+    replication = primary;
+}
+
+void LocalAccountStore::setIndex(AccountIndex* accountIndex) {
+    std::lock_guard<std::mutex> lock(mutex);
+    index = accountIndex;
+    if (index) {
+        index->rebuild(data.getAll());
+    }
+}
+
+void LocalAccountStore::setAudit(AuditLog* auditLog) {
+    std::lock_guard<std::mutex> lock(mutex);
+    audit = auditLog;
+}
+
+bool LocalAccountStore::countAccountPrefix(const std::string& prefix, size_t& count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    count = prefixes.countPrefix(prefix);
+    return true;
+}
+
+
+uint64_t LocalAccountStore::conflictCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return conflicts;
+}
+
+std::map<std::string, std::string> LocalAccountStore::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return data.getAll();
+}
+
+void LocalAccountStore::trackChanges(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    trackingChanges = enabled;
+    changedAccounts.clear();
+}
+
+bool LocalAccountStore::copyRange(const std::string& after, size_t limit,
+    std::vector<std::pair<std::string, std::string>>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto& all = data.getAll();
+    auto it = after.empty() ? all.begin() : all.upper_bound(after);
+    for (size_t copied = 0; it != all.end() && copied < limit; ++it, ++copied) {
+        out.emplace_back(it->first, it->second);
+    }
+    return it != all.end();
+}
+
+// 同一账号的键在键序上相邻（"<账号>_<字段>"），从账号本身开始顺序取即可
+size_t LocalAccountStore::takeChanges(std::map<std::string, std::string>& changed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto& all = data.getAll();
+    for (const auto& account : changedAccounts) {
+        for (auto it = all.lower_bound(account); it != all.end() && it->first.compare(0, account.size(), account) == 0; ++it) {
+            if (it->first.size() == account.size() || it->first[account.size()] == '_') {
+                changed.emplace_hint(changed.end(), it->first, it->second);
+            }
+        }
+    }
+    size_t accounts = changedAccounts.size();
+    changedAccounts.clear();
+    return accounts;
+}
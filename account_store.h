@@ -0,0 +1,133 @@
+#ifndef ACCOUNT_STORE_H
+#define ACCOUNT_STORE_H
+
+#include "simple_json.h"
+#include "replication.h"
+#include "request_dedup.h"
+#include "transaction_log.h"
+#include "account_index.h"
+#include "account_prefix_index.h"
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+class AuditLog;
+
+// 账户数据存储接口。键沿用 "<账号>_<字段>" 的形式，
+// 修改以批次提交，一个批次要么全部生效要么全部不生效。
+// 携带请求ID的提交会记录结果，同一ID的重复请求通过lookupRequest()取回原结果。
+class AccountStore {
+public:
+    virtual ~AccountStore() {}
+
+    virtual bool load() = 0;
+    virtual std::string get(const std::string& key) = 0;
+    virtual bool hasKey(const std::string& key) = 0;
+    virtual std::string findAccountByIdCard(const std::string& idCard) = 0;
+    virtual bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) = 0;
+    virtual bool lookupRequest(const std::string& requestId, RequestResult& result) = 0;
+    // 统计以prefix（1-19位数字）开头的账号数，供转账输入联想；给不出准确数目的实现返回false，
+    // 调用方此时不作"没有此账号"的提示
+    virtual bool countAccountPrefix(const std::string& /*prefix*/, size_t& /*count*/) { return false; }
+};
+
+// 单机存储：整个数据文件加载到内存，每次提交写事务日志（fsync）后即生效并推送给备机，
+// 提交不重写数据文件；事务日志超过阈值时做一次检查点把数据写回数据文件（见checkpoint()）。
+// 启动时依次重放轮换出的日志和当前日志，既补齐数据文件也恢复去重窗口内的请求结果。
+// 可由多个处理线程共用：按线程记下自上次提交以来读到的值，提交时批次里读过的键
+// 已被其他线程改掉则提交失败，由调用方重新读取后重试（与共享内存存储相同的乐观并发控制）。
+// 每个线程至多逐键记下READ_SET_KEYS个读取，槽位提交后复用，读取本身不分配内存；
+// 超出的读取只记下当时的提交序号，其后有任何提交即按冲突处理。
+// 数据文件以 .snap 结尾时使用列式快照格式，否则为JSON。
+class LocalAccountStore : public AccountStore {
+public:
+    LocalAccountStore(const std::string& dataFile,
+        size_t dedupBudgetBytes = 1 << 20, int dedupWindowSeconds = 3600);
+    // 加载过且有未写回的提交时做一次检查点，正常退出后数据文件即为最新状态
+    ~LocalAccountStore();
+
+    bool load() override;
+    std::string get(const std::string& key) override;
+    bool hasKey(const std::string& key) override;
+    std::string findAccountByIdCard(const std::string& idCard) override;
+    bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) override;
+    bool lookupRequest(const std::string& requestId, RequestResult& result) override;
+    bool countAccountPrefix(const std::string& prefix, size_t& count) override;
+
+    void setReplication(ReplicationPrimary* primary);
+    // 挂接运维查询索引：立即按当前数据重建，之后随load()和每次提交维护
+    void setIndex(AccountIndex* accountIndex);
+    // 挂接审计日志，须在load()之前调用：load()时打开（首次开启时以全部数据为基线），
+    // 并补记事务日志中尚未审计的提交；之后每次提交追加一条，压缩事务日志前先落盘
+    void setAudit(AuditLog* auditLog);
+    std::map<std::string, std::string> snapshot();
+    uint64_t conflictCount();
+    // 模糊检查点：锁内把事务日志轮换为 <数据文件>.txlog.checkpoint，锁外分块复制数据
+    // （每块单独持锁）并写回数据文件，落盘后再在锁内把轮换日志中去重窗口内的请求结果
+    // 并回当前日志、删除轮换日志。修改都是整值覆盖，复制期间又被改动的键由当前日志补上，
+    // 所以数据文件 + 轮换日志 + 当前日志按顺序重放总能得到最新状态，任何一步中断都不丢提交。
+    // 提交时日志超过阈值会自动调用；其他线程正在做时直接返回true
+    bool checkpoint();
+
+    // 在线备份用的变更跟踪：开启后每次提交记下改动过的账号
+    void trackChanges(bool enabled);
+    // 按键序复制after之后的至多limit个键，只在复制这一块期间持锁；复制到末尾时返回false
+    bool copyRange(const std::string& after, size_t limit, std::vector<std::pair<std::string, std::string>>& out);
+    // 取走上次调用以来改动过的账号，并在同一次持锁内复制这些账号当前的全部字段，
+    // 返回账号数；这一刻即增量备份的时间点
+    size_t takeChanges(std::map<std::string, std::string>& changed);
+
+private:
+    // 一个线程自上次提交以来的读取；槽位在该线程首次读取时一次分配好，used之后的留待复用
+    struct ReadSet {
+        std::vector<std::pair<std::string, std::string>> entries;
+        size_t used = 0;
+        bool overflowed = false;
+        uint64_t overflowedAt = 0;
+    };
+    static const size_t READ_SET_KEYS = 32;
+
+    bool applyCommit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result,
+        bool& checkpointDue);
+    bool loadDataLocked();
+    bool compactLogsLocked(int64_t now, bool keepCurrentChanges);
+
+    SimpleJson data;
+    std::string dataFile;
+    std::mutex mutex;
+    ReplicationPrimary* replication;
+    AccountIndex* index;
+    AuditLog* audit;
+    TransactionLog txLog;
+    DedupCache dedup;
+    AccountPrefixIndex prefixes;
+    std::map<std::thread::id, ReadSet> readSets;
+    uint64_t commitCount;
+    uint64_t conflicts;
+    bool loaded;
+    bool uncheckpointed;
+    bool checkpointing;
+    bool trackingChanges;
+    std::set<std::string> changedAccounts;
+};
+
+int64_t unixTimeNow();
+
+// 只读加载数据文件（JSON或.snap），再依次叠加 <数据文件>.txlog.checkpoint 和 <数据文件>.txlog
+// 中尚未写回的修改，结果与LocalAccountStore::load()相同但不改动任何文件。
+// 数据文件存在却读不出时返回false；数据文件和日志都不存在时也返回false
+bool loadAccountData(const std::string& dataFile, std::map<std::string, std::string>& data);
+// 按数据文件的扩展名写JSON或.snap：写临时文件后fsync、rename、fsync目录；
+// 只有返回true时才可以丢弃事务日志里的修改
+bool saveAccountData(const SimpleJson& json, const std::string& dataFile);
+
+// 从 "<账号>_<字段>" 中取出账号部分
+std::string accountOfKey(const std::string& key);
+// FNV-1a哈希，跨进程稳定（分片路由、请求去重都依赖这一点）
+uint64_t hashKey(const std::string& text);
+
+#endif
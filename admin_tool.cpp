@@ -0,0 +1,197 @@
+#include "account_index.h"
+#include "account_prefix_index.h"
+#include "account_store.h"
+#include "limit_rules.h"
+#include "synthetic_accounts.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printRows(const std::vector<AccountSummary>& rows) {
+    for (const auto& row : rows) {
+        std::printf("  %s  %-12s 余额 %12.2f  当日取款 %8.2f%s", row.account.c_str(), row.name.c_str(),
+            row.balance, row.dailyWithdrawal, row.locked ? "  [锁定]" : "");
+        if (!row.locked && row.lockedUntil > std::time(nullptr)) {
+            std::printf("  [锁定至 %lld]", (long long)row.lockedUntil);
+        }
+        std::printf("\n");
+    }
+}
+
+static size_t countArgument(std::istringstream& in, size_t fallback) {
+    size_t value;
+    return in >> value ? value : fallback;
+}
+
+// 每个前缀长度随机取一个真实账号的前缀，测量转账界面每次按键的查询耗时
+static int runPrefixBench(size_t count) {
+    std::mt19937_64 rng(20240601);
+    std::vector<uint64_t> accounts(count);
+    uint64_t account = 6222000000000000000ULL;
+    for (auto& value : accounts) {
+        value = (account += 1 + rng() % 1000);
+    }
+    std::shuffle(accounts.begin(), accounts.end(), rng);
+
+    AccountPrefixIndex prefixes;
+    auto start = std::chrono::steady_clock::now();
+    prefixes.build(accounts);
+    std::printf("前缀索引 %zu 个账号，%zu 字节，构建耗时 %.1f ms\n", prefixes.size(), prefixes.memoryBytes(), elapsedMs(start));
+
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < 100000; i++) {
+        std::string digits = std::to_string(accounts[rng() % count]);
+        queries.push_back(digits.substr(0, 1 + rng() % 19));
+    }
+    size_t matched = 0;
+    start = std::chrono::steady_clock::now();
+    for (const auto& query : queries) {
+        matched += prefixes.countPrefix(query) > 0;
+    }
+    double ms = elapsedMs(start);
+    std::printf("%zu 次前缀查询，平均 %.3f us/次，命中 %zu 次\n", queries.size(), ms * 1000 / queries.size(), matched);
+    return matched == queries.size() ? 0 : 1;
+}
+
+// 执行一条查询命令，返回false表示命令无法识别
+static bool runQuery(AccountIndex& index, const AccountPrefixIndex& prefixes, const std::string& line, const LimitTable& limits) {
+    std::istringstream in(line);
+    std::string command;
+    in >> command;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<AccountSummary> rows;
+    if (command == "top") {
+        rows = index.topBalances(countArgument(in, 10));
+    }
+    else if (command == "locked") {
+        rows = index.lockedAccounts(std::time(nullptr), countArgument(in, 50));
+    }
+    else if (command == "near-limit") {
+        double marginRatio = 0.2;
+        in >> marginRatio;
+        rows = index.nearDailyLimit(limits, marginRatio, 50);
+    }
+    else if (command == "name") {
+        std::string prefix;
+        in >> prefix;
+        rows = index.findByName(prefix, countArgument(in, 50));
+    }
+    else if (command == "prefix") {
+        std::string prefix;
+        in >> prefix;
+        size_t matches = prefixes.countPrefix(prefix);
+        std::printf("以 %s 开头的账号: %zu 个，耗时 %.3f ms\n", prefix.c_str(), matches, elapsedMs(start));
+        return true;
+    }
+    else if (command == "count") {
+        std::printf("账户数: %zu\n", index.accountCount());
+        return true;
+    }
+    else {
+        return false;
+    }
+    double ms = elapsedMs(start);
+    printRows(rows);
+    std::printf("%zu 条，耗时 %.3f ms\n", rows.size(), ms);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dataFile = "users.json";
+    size_t synthetic = 0;
+    size_t prefixBench = 0;
+    std::string limitsFile = "limits.conf";
+    bool limitsGiven = false;
+    std::vector<std::string> commands;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        }
+        else if (arg == "--synthetic" && i + 1 < argc) {
+            synthetic = std::stoul(argv[++i]);
+        }
+        else if (arg == "--prefix-bench" && i + 1 < argc) {
+            prefixBench = std::stoul(argv[++i]);
+        }
+        else if (arg == "--limits" && i + 1 < argc) {
+            limitsFile = argv[++i];
+            limitsGiven = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "用法: " << argv[0] << " [--data 文件 | --synthetic N] [--limits 文件] [\"命令\" ...]\n"
+                << "       " << argv[0] << " --prefix-bench 账号数\n"
+                << "命令: top [N] | locked [N] | near-limit [余量比例，默认0.2] | name <前缀> [N] | prefix <账号前缀> | count\n"
+                << "不带命令时从标准输入逐行读取命令" << std::endl;
+            return 1;
+        }
+        else {
+            commands.push_back(arg);
+        }
+    }
+
+    if (prefixBench) {
+        return runPrefixBench(prefixBench);
+    }
+
+    // 与主程序相同：默认的 limits.conf 不存在时用内置限额，配置有错或指定的文件不存在时退出
+    LimitRules limitRules(limitsFile);
+    if (!limitRules.load() && (limitsGiven || std::ifstream(limitsFile).good())) {
+        std::cerr << limitRules.lastError() << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, std::string> data;
+    if (synthetic) {
+        generateAccounts(synthetic, data);
+    }
+    else if (!loadAccountData(dataFile, data)) {
+        std::cerr << "无法读取: " << dataFile << std::endl;
+        return 1;
+    }
+
+    AccountIndex index;
+    auto start = std::chrono::steady_clock::now();
+    index.rebuild(data);
+    std::vector<uint64_t> accounts;
+    for (const auto& pair : data) {
+        if (pair.first.size() == 28 && pair.first.compare(19, 9, "_password") == 0) {
+            accounts.push_back(std::strtoull(pair.first.c_str(), nullptr, 10));
+        }
+    }
+    AccountPrefixIndex prefixes;
+    prefixes.build(std::move(accounts));
+    std::printf("索引 %zu 个账户，构建耗时 %.1f ms\n", index.accountCount(), elapsedMs(start));
+    data.clear();
+
+    bool ok = true;
+    for (const auto& command : commands) {
+        if (!runQuery(index, prefixes, command, limitRules.table())) {
+            std::cerr << "未知命令: " << command << std::endl;
+            ok = false;
+        }
+    }
+    if (!commands.empty()) return ok ? 0 : 1;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line == "quit") break;
+        if (!line.empty() && !runQuery(index, prefixes, line, limitRules.table())) {
+            std::cout << "未知命令: " << line << std::endl;
+        }
+    }
+    return 0;
+}
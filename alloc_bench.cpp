@@ -0,0 +1,152 @@
+#include "limit_rules.h"
+#include "alloc_stats.h"
+#include "operation_arena.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+struct BenchRow {
+    const char* name;
+    uint64_t ops;
+    double allocsPerOp;
+    double bytesPerOp;
+    double nsPerOp;
+    bool enforced;
+};
+
+// 先执行一次让缓冲区达到稳定容量，再统计ops次的分配与耗时
+template <class F>
+static BenchRow measure(const char* name, uint64_t ops, bool enforced, F&& body) {
+    body(0);
+    AllocationStats before = allocationStats();
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        body(i);
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    AllocationStats after = allocationStats();
+    return BenchRow{ name, ops, (double)(after.count - before.count) / ops, (double)(after.bytes - before.bytes) / ops, elapsed / ops, enforced };
+}
+
+static std::string accountName(uint64_t index) {
+    // 前缀8位加上最长20位的序号
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "62220000%011llu", (unsigned long long)index);
+    return buffer;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t accountCount = 2000;
+    uint64_t ops = 100000;
+    uint64_t commits = 200;
+    double maxAllocs = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--accounts" && i + 1 < argc) {
+            accountCount = std::stoull(argv[++i]);
+        }
+        else if (arg == "--ops" && i + 1 < argc) {
+            ops = std::stoull(argv[++i]);
+        }
+        else if (arg == "--commits" && i + 1 < argc) {
+            commits = std::stoull(argv[++i]);
+        }
+        else if (arg == "--max-allocs" && i + 1 < argc) {
+            maxAllocs = std::stod(argv[++i]);
+        }
+        else {
+            std::cerr << "用法: " << argv[0] << " [--accounts N] [--ops N] [--commits N] [--max-allocs N]" << std::endl;
+            return 1;
+        }
+    }
+    if (accountCount < 2) accountCount = 2;
+
+    const std::string dataFile = "bench_alloc.json";
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+
+    std::vector<std::string> accounts;
+    {
+        LocalAccountStore setup(dataFile);
+        setup.load();
+        ChangeBatch batch;
+        for (uint64_t i = 0; i < accountCount; i++) {
+            accounts.push_back(accountName(i));
+            batch.emplace_back(accounts.back() + "_password", "123456");
+            batch.emplace_back(accounts.back() + "_balance", std::to_string(1000000.0));
+            batch.emplace_back(accounts.back() + "_daily_withdrawal", "0");
+            batch.emplace_back(accounts.back() + "_name", "张三");
+        }
+        setup.commit(batch, "", RequestResult{ REQUEST_NONE, 0 });
+    }
+
+    LocalAccountStore store(dataFile);
+    store.load();
+    LimitRules limitRules;
+    AccountOperations operations(store, "BENCH", limitRules);
+    std::vector<BenchRow> rows;
+
+    rows.push_back(measure("withdraw.prepare", ops, true, [&](uint64_t i) {
+        operations.prepareWithdrawal(accounts[i % accountCount], 100);
+    }));
+    rows.push_back(measure("transfer.prepare", ops, true, [&](uint64_t i) {
+        operations.prepareTransfer(accounts[i % accountCount], accounts[(i + 1) % accountCount], 100);
+    }));
+
+    // 与取款界面每帧生成的限额信息列表相同的内容
+    OperationArena<16 << 10> frameArena;
+    size_t sink = 0;
+    rows.push_back(measure("frame.info(arena)", ops, true, [&](uint64_t i) {
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> info({
+            arenaText(frame, "当前余额: ", (int)i, " 元"),
+            arenaText(frame, "今日已取: ", (int)(i % 5000), " 元"),
+            arenaText(frame, "单笔限额: ", 2000, " 元"),
+            arenaText(frame, "单日限额: ", 5000, " 元"),
+            arenaText(frame, "剩余可取: ", (int)(5000 - i % 5000), " 元")
+        }, frame);
+        sink += info.back().size();
+    }));
+    rows.push_back(measure("frame.info(std)", ops, false, [&](uint64_t i) {
+        std::vector<std::string> info = {
+            "当前余额: " + std::to_string((int)i) + " 元",
+            "今日已取: " + std::to_string((int)(i % 5000)) + " 元",
+            "单笔限额: " + std::to_string(2000) + " 元",
+            "单日限额: " + std::to_string(5000) + " 元",
+            "剩余可取: " + std::to_string((int)(5000 - i % 5000)) + " 元"
+        };
+        sink += info.back().size();
+    }));
+
+    // 含事务日志fsync，只报告不设上限
+    std::string amountText = "100";
+    rows.push_back(measure("withdraw.commit", commits, false, [&](uint64_t i) {
+        RequestResult previous;
+        operations.withdraw(accounts[i % accountCount], amountText, 100, previous);
+    }));
+
+    std::printf("accounts: %llu  allocation stats: %s\n", (unsigned long long)accountCount,
+        allocationStatsEnabled() ? "on" : "off (rebuild with -DATM_ALLOC_STATS=ON)");
+    std::printf("%-20s %10s %12s %12s %12s\n", "operation", "ops", "allocs/op", "bytes/op", "ns/op");
+    bool withinBudget = true;
+    for (const auto& row : rows) {
+        bool over = row.enforced && maxAllocs >= 0 && row.allocsPerOp > maxAllocs;
+        withinBudget = withinBudget && !over;
+        std::printf("%-20s %10llu %12.2f %12.1f %12.1f%s\n", row.name, (unsigned long long)row.ops,
+            row.allocsPerOp, row.bytesPerOp, row.nsPerOp, over ? "  OVER BUDGET" : "");
+    }
+
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    if (maxAllocs >= 0 && !allocationStatsEnabled()) {
+        std::cerr << "--max-allocs 需要以 -DATM_ALLOC_STATS=ON 构建" << std::endl;
+        return 2;
+    }
+    return withinBudget && sink ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include "alloc_stats.h"
+
+#ifdef ATM_ALLOC_STATS
+
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t allocationCount = 0;
+static thread_local uint64_t allocationBytes = 0;
+
+static void* countedAllocate(std::size_t size) {
+    allocationCount++;
+    allocationBytes += size;
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+static void* countedAllocateAligned(std::size_t size, std::align_val_t alignment) {
+    allocationCount++;
+    allocationBytes += size;
+    std::size_t align = (std::size_t)alignment;
+    void* pointer = std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size) { return countedAllocate(size); }
+void* operator new[](std::size_t size) { return countedAllocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAllocateAligned(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAllocateAligned(size, alignment); }
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+AllocationStats allocationStats() {
+    return AllocationStats{ allocationCount, allocationBytes };
+}
+
+bool allocationStatsEnabled() {
+    return true;
+}
+
+#else
+
+AllocationStats allocationStats() {
+    return AllocationStats{ 0, 0 };
+}
+
+bool allocationStatsEnabled() {
+    return false;
+}
+
+#endif
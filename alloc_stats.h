@@ -0,0 +1,16 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <cstdint>
+
+// 堆分配计数。以 -DATM_ALLOC_STATS=ON 构建时替换全局operator new/delete，
+// 按线程累计分配次数与字节数；未开启时计数恒为0。
+struct AllocationStats {
+    uint64_t count;
+    uint64_t bytes;
+};
+
+AllocationStats allocationStats();
+bool allocationStatsEnabled();
+
+#endif
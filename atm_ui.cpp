@@ -4,10 +4,18 @@
 #include <iomanip>
 #include <cmath>
 #include <ctime>
-
-ATMWithFTXUI::ATMWithFTXUI() :
+#include <chrono>
+#include <unistd.h>
+
+ATMWithFTXUI::ATMWithFTXUI(std::unique_ptr<AccountStore> store, LimitRules& rules, AccountIndex* index,
+    const Sha256Digest* operatorKey, FraudMonitor* fraud) :
+    userData(std::move(store)),
+    accountIndex(index),
+    fraudMonitor(fraud),
+    terminalId("T" + std::to_string(getpid()) + "-" + std::to_string(time(0))),
     isLoggedIn(false),
-    loginAttempts(0),
+    limitRules(rules),
+    operations(*userData, terminalId, rules),
     accountInput(""),
     passwordInput(""),
     message("WELLCOME！"),
@@ -21,6 +29,12 @@ ATMWithFTXUI::ATMWithFTXUI() :
     confirmPassword(""),
     idCardInput(""),
     nameInput(""),
+    operatorEnabled(index && operatorKey),
+    operatorKey(operatorKey ? *operatorKey : Sha256Digest()),
+    operatorAuthenticated(false),
+    operatorFailures(0),
+    operatorLockedUntil(0),
+    operatorQueryMs(0),
     selectedMenuItem(0),
     shouldExit(false) {
 
@@ -29,17 +43,24 @@ ATMWithFTXUI::ATMWithFTXUI() :
 }
 
 void ATMWithFTXUI::loadUserData() {
-    if (!userData.loadFromFile("users.json")) {
+    if (!userData->load()) {
         message = "用户数据文件不存在，将创建新文件。";
     }
 }
 
-void ATMWithFTXUI::saveUserData() {
-    userData.saveToFile("users.json");
+// 修改先暂存，saveUserData()时作为一个批次原子提交
+void ATMWithFTXUI::updateUserData(const std::string& key, const std::string& value) {
+    pendingChanges.emplace_back(key, value);
+}
+
+bool ATMWithFTXUI::saveUserData() {
+    bool committed = userData->commit(pendingChanges, "", RequestResult{ REQUEST_NONE, 0 });
+    pendingChanges.clear();
+    return committed;
 }
 
 bool ATMWithFTXUI::isAccountExists(const std::string& account) {
-    return userData.hasKey(account + "_password");
+    return userData->hasKey(account + "_password");
 }
 
 std::string ATMWithFTXUI::getCurrentTime() {
@@ -77,7 +98,76 @@ bool ATMWithFTXUI::isValidAccount(const std::string& account) {
 }
 
 bool ATMWithFTXUI::isIdCardRegistered(const std::string& idCard) {
-    return !userData.findAccountByIdCard(idCard).empty();
+    return !userData->findAccountByIdCard(idCard).empty();
+}
+
+// 只显示姓名的最后一个字，其余每个字替换为*（按UTF-8字符计）
+static std::string maskName(const std::string& name) {
+    if (name.empty()) return "";
+    size_t last = name.size() - 1;
+    while (last > 0 && ((unsigned char)name[last] & 0xC0) == 0x80) {
+        last--;
+    }
+    size_t hidden = 0;
+    for (size_t i = 0; i < last; i++) {
+        if (((unsigned char)name[i] & 0xC0) != 0x80) hidden++;
+    }
+    return last == 0 ? "*" : std::string(hidden, '*') + name.substr(last);
+}
+
+// 每次按键都会重绘，输入未变化时直接返回上次的结果。
+// 未输完时向存储查前缀计数（存储给不出准确数目时只显示已输位数）；输满19位后确认账号并显示脱敏姓名
+const std::string& ATMWithFTXUI::transferTargetHint() {
+    if (transferAccount == transferLookupInput) {
+        return transferLookupText;
+    }
+    transferLookupInput = transferAccount;
+
+    if (transferAccount.empty()) {
+        transferLookupText = "";
+    }
+    else if (!isAllDigits(transferAccount)) {
+        transferLookupText = "❌ 账号只能包含数字";
+    }
+    else if (transferAccount.size() > 19) {
+        transferLookupText = "❌ 账号超过19位";
+    }
+    else if (transferAccount.size() < 19) {
+        std::string typed = "已输入 " + std::to_string(transferAccount.size()) + "/19 位";
+        size_t matches = 0;
+        if (!userData->countAccountPrefix(transferAccount, matches)) {
+            transferLookupText = typed;
+        }
+        else {
+            transferLookupText = matches == 0 ? "❌ 没有以此开头的账号" : "🔎 " + typed + "，匹配 " + std::to_string(matches) + " 个账号";
+        }
+    }
+    else if (transferAccount == currentAccount) {
+        transferLookupText = "❌ 不能转账给自己";
+    }
+    else if (isAccountExists(transferAccount)) {
+        transferLookupText = "✅ 收款人：" + maskName(userData->get(transferAccount + "_name"));
+    }
+    else {
+        transferLookupText = "❌ 账号不存在";
+    }
+    return transferLookupText;
+}
+
+std::string ATMWithFTXUI::transferConfirmHint() {
+    if (transferConfirmAccount.empty()) return "";
+    if (transferConfirmAccount == transferAccount) return "✅ 两次输入一致";
+    if (transferAccount.compare(0, transferConfirmAccount.size(), transferConfirmAccount) == 0) return "";
+    return "❌ 与上面的账号不一致";
+}
+
+// 复用message已有的容量，避免每次提示都重新分配
+void ATMWithFTXUI::setMessage(std::string_view text) {
+    message.assign(text.data(), text.size());
+}
+
+const LimitRow& ATMWithFTXUI::limitsOf(const std::string& account) const {
+    return limitRules.table().rowFor(accountNumber(account));
 }
 
 Element ATMWithFTXUI::largeText(const std::string& content) {
@@ -105,10 +195,14 @@ Element ATMWithFTXUI::card(Element content) {
         size(WIDTH, GREATER_THAN, 70) | size(HEIGHT, GREATER_THAN, 15);
 }
 
-Element ATMWithFTXUI::infoPanel(const std::string& title, const std::vector<std::string>& items) {
+Element ATMWithFTXUI::infoPanel(const std::string& title, const std::pmr::vector<std::pmr::string>& items) {
     std::vector<Element> itemElements;
+    itemElements.reserve(items.size());
     for (const auto& item : items) {
-        itemElements.push_back(text(" • " + item));
+        std::string line;
+        line.reserve(item.size() + 5);
+        line.append(" • ").append(item.data(), item.size());
+        itemElements.push_back(text(std::move(line)));
     }
 
     return vbox({
@@ -139,6 +233,12 @@ Component ATMWithFTXUI::createLoginComponent() {
         shouldExit = true;
         });
 
+    auto operatorButton = largeButton("🛠 运维查询", [this] {
+        selectedMenuItem = 8;
+        message = "请输入运维口令";
+        operatorPassword = "";
+        });
+
     auto container = Container::Vertical({
         accountInputComponent,
         passwordInputComponent,
@@ -148,15 +248,21 @@ Component ATMWithFTXUI::createLoginComponent() {
         }),
         exitButton
         });
+    if (operatorEnabled) {
+        container->Add(operatorButton);
+    }
 
     return Renderer(container, [=] {
-        std::vector<std::string> infoItems = {
-            "单笔取款限额: " + std::to_string((int)SINGLE_WITHDRAWAL_LIMIT) + " 元",
-            "单日取款限额: " + std::to_string((int)DAILY_WITHDRAWAL_LIMIT) + " 元",
-            "初始账户余额: " + std::to_string((int)INITIAL_BALANCE) + " 元",
-            "账号要求: 19位数字",
-            "密码要求: 6位数字"
-        };
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> infoItems({
+            arenaText(frame, "单笔取款限额（标准层级）: ", limitRules.table().defaultRow().withdrawSingle / 100, " 元"),
+            arenaText(frame, "单日取款限额（标准层级）: ", limitRules.table().defaultRow().withdrawDaily / 100, " 元"),
+            arenaText(frame, "取款面额: ", limitRules.table().denominationText(), " 元"),
+            arenaText(frame, "初始账户余额（标准层级）: ", limitRules.table().defaultRow().initialBalance / 100, " 元"),
+            arenaText(frame, "账号要求: 19位数字"),
+            arenaText(frame, "密码要求: 6位数字")
+        }, frame);
 
         auto infoPanelElement = infoPanel("系统信息", infoItems);
 
@@ -179,6 +285,7 @@ Component ATMWithFTXUI::createLoginComponent() {
                     }),
                     separator(),
                     exitButton->Render() | center,
+                    operatorEnabled ? operatorButton->Render() | center : filler(),
                 }) | flex,
                 separator(),
                 infoPanelElement | flex,
@@ -226,13 +333,15 @@ Component ATMWithFTXUI::createRegisterComponent() {
         });
 
     return Renderer(container, [=] {
-        std::vector<std::string> infoItems = {
-            "账号要求: 19位数字",
-            "密码要求: 6位数字",
-            "身份证号: 18位（17位数字+1位数字或X）",
-            "姓名要求: 2-20个字符",
-            "初始余额: " + std::to_string((int)INITIAL_BALANCE) + " 元"
-        };
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> infoItems({
+            arenaText(frame, "账号要求: 19位数字"),
+            arenaText(frame, "密码要求: 6位数字"),
+            arenaText(frame, "身份证号: 18位（17位数字+1位数字或X）"),
+            arenaText(frame, "姓名要求: 2-20个字符"),
+            arenaText(frame, "初始余额（标准层级）: ", limitRules.table().defaultRow().initialBalance / 100, " 元")
+        }, frame);
 
         auto infoPanelElement = infoPanel("📋 注册要求", infoItems);
 
@@ -289,17 +398,19 @@ Component ATMWithFTXUI::createMainMenuComponent() {
             menuElements.push_back(menuButtons[i]->Render() | size(HEIGHT, EQUAL, 4));
         }
 
-        double balance = std::stod(userData.get(currentAccount + "_balance"));
-        double dailyWithdrawal = std::stod(userData.get(currentAccount + "_daily_withdrawal"));
-        std::string userName = userData.get(currentAccount + "_name");
+        double balance = operations.balanceOf(currentAccount);
+        double dailyWithdrawal = operations.dailyWithdrawalOf(currentAccount);
+        std::string userName = userData->get(currentAccount + "_name");
 
-        std::vector<std::string> accountInfo = {
-            "账户号码: " + currentAccount,
-            "客户姓名: " + userName,
-            "当前余额: " + std::to_string((int)balance) + " 元",
-            "今日已取款: " + std::to_string((int)dailyWithdrawal) + " 元",
-            "剩余可取: " + std::to_string((int)(DAILY_WITHDRAWAL_LIMIT - dailyWithdrawal)) + " 元"
-        };
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> accountInfo({
+            arenaText(frame, "账户号码: ", currentAccount),
+            arenaText(frame, "客户姓名: ", userName),
+            arenaText(frame, "当前余额: ", (int)balance, " 元"),
+            arenaText(frame, "今日已取款: ", (int)dailyWithdrawal, " 元"),
+            arenaText(frame, "剩余可取: ", (int)(limitsOf(currentAccount).withdrawDaily / 100 - dailyWithdrawal), " 元")
+        }, frame);
 
         auto accountInfoPanel = infoPanel("账户信息", accountInfo);
 
@@ -330,8 +441,8 @@ Component ATMWithFTXUI::createBalanceComponent() {
         });
 
     return Renderer(backButton, [=] {
-        double balance = std::stod(userData.get(currentAccount + "_balance"));
-        std::string userName = userData.get(currentAccount + "_name");
+        double balance = operations.balanceOf(currentAccount);
+        std::string userName = userData->get(currentAccount + "_name");
 
         auto balanceCard = vbox({
             text("💰 账户余额") | bold | center,
@@ -379,16 +490,21 @@ Component ATMWithFTXUI::createWithdrawComponent() {
         });
 
     return Renderer(container, [=] {
-        double balance = std::stod(userData.get(currentAccount + "_balance"));
-        double dailyWithdrawal = std::stod(userData.get(currentAccount + "_daily_withdrawal"));
-
-        std::vector<std::string> limitInfo = {
-            "当前余额: " + std::to_string((int)balance) + " 元",
-            "今日已取: " + std::to_string((int)dailyWithdrawal) + " 元",
-            "单笔限额: " + std::to_string((int)SINGLE_WITHDRAWAL_LIMIT) + " 元",
-            "单日限额: " + std::to_string((int)DAILY_WITHDRAWAL_LIMIT) + " 元",
-            "剩余可取: " + std::to_string((int)(DAILY_WITHDRAWAL_LIMIT - dailyWithdrawal)) + " 元"
-        };
+        double balance = operations.balanceOf(currentAccount);
+        double dailyWithdrawal = operations.dailyWithdrawalOf(currentAccount);
+        limitRules.refresh();
+        const LimitRow& limits = limitsOf(currentAccount);
+
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> limitInfo({
+            arenaText(frame, "当前余额: ", (int)balance, " 元"),
+            arenaText(frame, "今日已取: ", (int)dailyWithdrawal, " 元"),
+            arenaText(frame, "单笔限额: ", limits.withdrawSingle / 100, " 元"),
+            arenaText(frame, "单日限额: ", limits.withdrawDaily / 100, " 元"),
+            arenaText(frame, "剩余可取: ", (int)(limits.withdrawDaily / 100 - dailyWithdrawal), " 元"),
+            arenaText(frame, "可用面额: ", limitRules.table().denominationText(), " 元")
+        }, frame);
 
         auto limitPanel = infoPanel("💵 取款限额", limitInfo);
 
@@ -445,14 +561,19 @@ Component ATMWithFTXUI::createTransferComponent() {
         });
 
     return Renderer(container, [=] {
-        double balance = std::stod(userData.get(currentAccount + "_balance"));
-
-        std::vector<std::string> transferInfo = {
-            "当前余额: " + std::to_string((int)balance) + " 元",
-            "请确保对方账户存在",
-            "转账前请仔细核对信息",
-            "转账操作不可撤销"
-        };
+        double balance = operations.balanceOf(currentAccount);
+        limitRules.refresh();
+
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> transferInfo({
+            arenaText(frame, "当前余额: ", (int)balance, " 元"),
+            limitsOf(currentAccount).transferSingle == NO_LIMIT_CENTS ? arenaText(frame, "单笔转账限额: 不限") :
+                arenaText(frame, "单笔转账限额: ", limitsOf(currentAccount).transferSingle / 100, " 元"),
+            arenaText(frame, "请确保对方账户存在"),
+            arenaText(frame, "转账前请仔细核对信息"),
+            arenaText(frame, "转账操作不可撤销")
+        }, frame);
 
         auto infoPanelElement = infoPanel("💡 转账说明", transferInfo);
 
@@ -465,7 +586,9 @@ Component ATMWithFTXUI::createTransferComponent() {
                     separator(),
                     vbox({
                         hbox(text("👤 对方账号: "), accountInput->Render()),
+                        text(transferTargetHint()) | dim,
                         hbox(text("✅ 确认账号: "), confirmInput->Render()),
+                        text(transferConfirmHint()) | dim,
                         hbox(text("💰 转账金额: "), amountInput->Render()),
                     }),
                     separator(),
@@ -513,12 +636,14 @@ Component ATMWithFTXUI::createChangePasswordComponent() {
         });
 
     return Renderer(container, [=] {
-        std::vector<std::string> passwordInfo = {
-            "密码必须为6位数字",
-            "不要使用简单密码",
-            "不要使用生日等个人信息",
-            "定期更换密码更安全"
-        };
+        frameArena.reset();
+        auto frame = frameArena.get();
+        std::pmr::vector<std::pmr::string> passwordInfo({
+            arenaText(frame, "密码必须为6位数字"),
+            arenaText(frame, "不要使用简单密码"),
+            arenaText(frame, "不要使用生日等个人信息"),
+            arenaText(frame, "定期更换密码更安全")
+        }, frame);
 
         auto infoPanelElement = infoPanel("🔒 密码要求", passwordInfo);
 
@@ -553,6 +678,108 @@ Component ATMWithFTXUI::createChangePasswordComponent() {
         });
 }
 
+Component ATMWithFTXUI::createOperatorLoginComponent() {
+    auto passwordInputComponent = largeInput(&operatorPassword, "请输入运维口令");
+    auto confirmButton = largeButton("🔐 进入运维查询", [this] {
+        if (operatorLogin()) {
+            selectedMenuItem = 7;
+            message = "运维查询";
+        }
+        });
+    auto backButton = largeButton("🔙 返回登录", [this] {
+        leaveOperator();
+        message = "返回登录界面";
+        });
+
+    auto container = Container::Vertical({
+        passwordInputComponent,
+        Container::Horizontal({
+            confirmButton,
+            backButton
+        })
+        });
+
+    return Renderer(container, [=] {
+        return vbox({
+            titleText("🛠 运维查询"),
+            separator(),
+            hbox(text("🔑 运维口令: "), passwordInputComponent->Render() | flex) | borderRounded,
+            hbox({
+                confirmButton->Render() | flex,
+                backButton->Render() | flex,
+            }),
+            separator(),
+            text(message) | center | size(HEIGHT, EQUAL, 2),
+            filler()
+            }) | borderDouble |
+            size(WIDTH, GREATER_THAN, 120) | size(HEIGHT, GREATER_THAN, 35);
+        });
+}
+
+Component ATMWithFTXUI::createOperatorComponent() {
+    auto prefixInput = largeInput(&operatorNamePrefix, "输入姓名或前缀");
+    auto topButton = largeButton("💰 余额最高", [this] { runOperatorQuery(0); });
+    auto lockedButton = largeButton("🔒 锁定账户", [this] { runOperatorQuery(1); });
+    auto nearLimitButton = largeButton("📈 接近日限额", [this] { runOperatorQuery(2); });
+    auto nameButton = largeButton("👤 姓名查询", [this] { runOperatorQuery(3); });
+    auto backButton = largeButton("🔙 返回登录", [this] {
+        leaveOperator();
+        message = "返回登录界面";
+        });
+
+    auto container = Container::Vertical({
+        Container::Horizontal({
+            topButton,
+            lockedButton,
+            nearLimitButton
+        }),
+        Container::Horizontal({
+            prefixInput,
+            nameButton
+        }),
+        backButton
+        });
+
+    return Renderer(container, [=] {
+        std::vector<Element> rows;
+        for (const auto& row : operatorResults) {
+            char balance[64];
+            std::snprintf(balance, sizeof(balance), "%12.2f  当日 %8.2f", row.balance, row.dailyWithdrawal);
+            rows.push_back(hbox({
+                text(row.account) | size(WIDTH, EQUAL, 22),
+                text(row.name) | size(WIDTH, EQUAL, 14),
+                text(balance),
+                text(row.locked || row.lockedUntil > time(0) ? "  🔒" : "")
+                }));
+        }
+        if (rows.empty()) {
+            rows.push_back(text("（无结果）") | center);
+        }
+
+        char summary[96];
+        std::snprintf(summary, sizeof(summary), "共 %zu 个账户，本次 %zu 条，耗时 %.3f ms",
+            accountIndex ? accountIndex->accountCount() : (size_t)0, operatorResults.size(), operatorQueryMs);
+
+        return vbox({
+            titleText("🛠 运维查询"),
+            separator(),
+            hbox({
+                topButton->Render() | flex,
+                lockedButton->Render() | flex,
+                nearLimitButton->Render() | flex,
+            }),
+            hbox(text("👤 姓名: "), prefixInput->Render() | flex, nameButton->Render()),
+            separator(),
+            text(operatorTitle) | bold | center,
+            vbox(rows) | vscroll_indicator | frame | flex,
+            separator(),
+            text(summary) | center,
+            backButton->Render() | center,
+            }) | borderDouble |
+            size(WIDTH, GREATER_THAN, 120) | size(HEIGHT, GREATER_THAN, 35);
+        });
+}
+
 Component ATMWithFTXUI::createAppComponent() {
     auto loginComponent = createLoginComponent();
     auto mainMenuComponent = createMainMenuComponent();
@@ -561,6 +788,8 @@ Component ATMWithFTXUI::createAppComponent() {
     auto transferComponent = createTransferComponent();
     auto passwordComponent = createChangePasswordComponent();
     auto registerComponent = createRegisterComponent();
+    auto operatorComponent = createOperatorComponent();
+    auto operatorLoginComponent = createOperatorLoginComponent();
 
     return Container::Tab({
         loginComponent,        // 0 - 登录界面
@@ -569,7 +798,9 @@ Component ATMWithFTXUI::createAppComponent() {
         withdrawComponent,     // 3 - 取款
         transferComponent,     // 4 - 转账
         passwordComponent,     // 5 - 修改密码
-        registerComponent      // 6 - 注册界面
+        registerComponent,     // 6 - 注册界面
+        operatorComponent,     // 7 - 运维查询
+        operatorLoginComponent // 8 - 运维口令
         }, &selectedMenuItem);
 }
 
@@ -589,28 +820,36 @@ bool ATMWithFTXUI::login() {
         return false;
     }
 
-    if (userData.get(accountInput + "_locked") == "true") {
-        message = "❌ 账户已被锁定，请联系银行客服！";
+    // 按终端限流，挡住暴力破解
+    int64_t now = unixTimeNow();
+    int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (!lockouts.allowAttempt(terminalId, nowMs)) {
+        message = "❌ 登录尝试过于频繁，请稍后再试！";
         return false;
     }
 
-    if (userData.get(accountInput + "_password") == passwordInput) {
+    LockoutManager::Status status;
+    switch (operations.login(lockouts, accountInput, passwordInput, now, status)) {
+    case OPERATION_OK:
         currentAccount = accountInput;
         isLoggedIn = true;
-        loginAttempts = 0;
         selectedMenuItem = 1;
         passwordInput = "";
         return true;
-    }
-    else {
-        loginAttempts++;
-        if (loginAttempts >= 3) {
-            userData.set(accountInput + "_locked", "true");
-            saveUserData();
-            message = "❌ 密码错误3次，账户已被锁定！";
+    case OPERATION_ACCOUNT_LOCKED:
+        message = "❌ 账户已被锁定，请联系银行客服！";
+        return false;
+    case OPERATION_TEMPORARILY_LOCKED:
+        message = "❌ 账户已被临时锁定，请 " + std::to_string((status.lockedUntil - now + 59) / 60) + " 分钟后再试！";
+        return false;
+    default:
+        if (fraudMonitor) fraudMonitor->publish(EVENT_LOGIN_FAILURE, accountInput, "", 0);
+        if (status.locked) {
+            message = "❌ 密码错误3次，账户已被锁定 " + std::to_string((status.lockedUntil - now + 59) / 60) + " 分钟！";
         }
         else {
-            message = "❌ 密码错误，还剩 " + std::to_string(3 - loginAttempts) + " 次尝试机会";
+            message = "❌ 密码错误，还剩 " + std::to_string(status.remainingAttempts) + " 次尝试机会";
         }
         return false;
     }
@@ -638,7 +877,7 @@ bool ATMWithFTXUI::createNewAccount() {
     }
 
     if (isIdCardRegistered(idCardInput)) {
-        std::string existingAccount = userData.findAccountByIdCard(idCardInput);
+        std::string existingAccount = userData->findAccountByIdCard(idCardInput);
         message = "❌ 该身份证号已注册账户：" + existingAccount;
         return false;
     }
@@ -653,13 +892,18 @@ bool ATMWithFTXUI::createNewAccount() {
         return false;
     }
 
-    userData.set(accountInput + "_password", passwordInput);
-    userData.set(accountInput + "_balance", std::to_string(INITIAL_BALANCE));
-    userData.set(accountInput + "_daily_withdrawal", "0");
-    userData.set(accountInput + "_locked", "false");
-    userData.set(accountInput + "_idcard", idCardInput);
-    userData.set(accountInput + "_name", nameInput);
-    saveUserData();
+    updateUserData(accountInput + "_password", passwordInput);
+    limitRules.refresh();
+    double initialBalance = limitsOf(accountInput).initialBalance / 100.0;
+    updateUserData(accountInput + "_balance", std::to_string(initialBalance));
+    updateUserData(accountInput + "_daily_withdrawal", "0");
+    updateUserData(accountInput + "_locked", "false");
+    updateUserData(accountInput + "_idcard", idCardInput);
+    updateUserData(accountInput + "_name", nameInput);
+    if (!saveUserData()) {
+        message = "❌ 注册提交失败，请重试！";
+        return false;
+    }
 
     currentAccount = accountInput;
     isLoggedIn = true;
@@ -669,7 +913,7 @@ bool ATMWithFTXUI::createNewAccount() {
     idCardInput = "";
     nameInput = "";
 
-    message = "✅ 账户注册成功！初始余额: " + std::to_string((int)INITIAL_BALANCE) + " 元";
+    message = "✅ 账户注册成功！初始余额: " + std::to_string((int)initialBalance) + " 元";
     return true;
 }
 
@@ -699,43 +943,38 @@ void ATMWithFTXUI::handleWithdraw() {
         return;
     }
 
-    double balance = std::stod(userData.get(currentAccount + "_balance"));
-    double dailyWithdrawal = std::stod(userData.get(currentAccount + "_daily_withdrawal"));
-
-    if (amount <= 0) {
+    requestArena.reset();
+    auto arena = requestArena.get();
+    RequestResult previous;
+    switch (operations.withdraw(currentAccount, withdrawAmount, amount, previous)) {
+    case OPERATION_DUPLICATE:
+        setMessage(arenaText(arena, "✅ 取款已完成（重复请求未再次执行），金额: ", (int)previous.amount, " 元"));
+        withdrawAmount.clear();
+        return;
+    case OPERATION_NOT_POSITIVE:
         message = "❌ 取款金额必须大于0！";
         return;
-    }
-
-    if (std::fmod(amount, 100) != 0) {
-        message = "❌ 取款金额必须是100的整数倍！";
+    case OPERATION_BAD_DENOMINATION:
+        setMessage(arenaText(arena, "❌ 取款金额须能由 ", limitRules.table().denominationText(), " 元面额的钞票凑出！"));
         return;
-    }
-
-    if (amount > SINGLE_WITHDRAWAL_LIMIT) {
-        message = "❌ 单笔取款金额不能超过 " + std::to_string((int)SINGLE_WITHDRAWAL_LIMIT) + " 元！";
+    case OPERATION_OVER_SINGLE_LIMIT:
+        setMessage(arenaText(arena, "❌ 单笔取款金额不能超过 ", limitsOf(currentAccount).withdrawSingle / 100, " 元！"));
         return;
-    }
-
-    if (amount > balance) {
+    case OPERATION_INSUFFICIENT_BALANCE:
         message = "❌ 余额不足！";
         return;
-    }
-
-    if (dailyWithdrawal + amount > DAILY_WITHDRAWAL_LIMIT) {
+    case OPERATION_OVER_DAILY_LIMIT:
         message = "❌ 超过单日取款限额！";
         return;
+    case OPERATION_OK:
+        if (fraudMonitor) fraudMonitor->publish(EVENT_WITHDRAW, currentAccount, "", amount);
+        setMessage(arenaText(arena, "✅ 取款成功！取款金额: ", (int)amount, " 元"));
+        withdrawAmount.clear();
+        return;
+    default:
+        message = "❌ 取款提交失败，请重试！";
+        return;
     }
-
-    balance -= amount;
-    dailyWithdrawal += amount;
-
-    userData.set(currentAccount + "_balance", std::to_string(balance));
-    userData.set(currentAccount + "_daily_withdrawal", std::to_string(dailyWithdrawal));
-    saveUserData();
-
-    message = "✅ 取款成功！取款金额: " + std::to_string((int)amount) + " 元";
-    withdrawAmount = "";
 }
 
 void ATMWithFTXUI::handleTransfer() {
@@ -749,16 +988,6 @@ void ATMWithFTXUI::handleTransfer() {
         return;
     }
 
-    if (!isAccountExists(transferAccount)) {
-        message = "❌ 转入账户不存在！";
-        return;
-    }
-
-    if (transferAccount == currentAccount) {
-        message = "❌ 不能转账给自己！";
-        return;
-    }
-
     double amount;
     try {
         amount = std::stod(transferAmount);
@@ -768,31 +997,39 @@ void ATMWithFTXUI::handleTransfer() {
         return;
     }
 
-    double balance = std::stod(userData.get(currentAccount + "_balance"));
-
-    if (amount <= 0) {
+    requestArena.reset();
+    auto arena = requestArena.get();
+    RequestResult previous;
+    switch (operations.transfer(currentAccount, transferAccount, transferAmount, amount, previous)) {
+    case OPERATION_DUPLICATE:
+        setMessage(arenaText(arena, "✅ 转账已完成（重复请求未再次执行），金额: ", (int)previous.amount, " 元"));
+        break;
+    case OPERATION_SELF_TRANSFER:
+        message = "❌ 不能转账给自己！";
+        return;
+    case OPERATION_TARGET_MISSING:
+        message = "❌ 转入账户不存在！";
+        return;
+    case OPERATION_NOT_POSITIVE:
         message = "❌ 转账金额必须大于0！";
         return;
-    }
-
-    if (amount > balance) {
+    case OPERATION_OVER_TRANSFER_LIMIT:
+        setMessage(arenaText(arena, "❌ 单笔转账金额不能超过 ", limitsOf(currentAccount).transferSingle / 100, " 元！"));
+        return;
+    case OPERATION_INSUFFICIENT_BALANCE:
         message = "❌ 余额不足！";
         return;
+    case OPERATION_OK:
+        if (fraudMonitor) fraudMonitor->publish(EVENT_TRANSFER, currentAccount, transferAccount, amount);
+        setMessage(arenaText(arena, "✅ 转账成功！转账金额: ", (int)amount, " 元"));
+        break;
+    default:
+        message = "❌ 转账提交失败，请重试！";
+        return;
     }
-
-    double targetBalance = std::stod(userData.get(transferAccount + "_balance"));
-
-    balance -= amount;
-    targetBalance += amount;
-
-    userData.set(currentAccount + "_balance", std::to_string(balance));
-    userData.set(transferAccount + "_balance", std::to_string(targetBalance));
-    saveUserData();
-
-    message = "✅ 转账成功！转账金额: " + std::to_string((int)amount) + " 元";
-    transferAccount = "";
-    transferConfirmAccount = "";
-    transferAmount = "";
+    transferAccount.clear();
+    transferConfirmAccount.clear();
+    transferAmount.clear();
 }
 
 void ATMWithFTXUI::handleChangePassword() {
@@ -801,7 +1038,7 @@ void ATMWithFTXUI::handleChangePassword() {
         return;
     }
 
-    if (userData.get(currentAccount + "_password") != oldPassword) {
+    if (userData->get(currentAccount + "_password") != oldPassword) {
         message = "❌ 旧密码错误！";
         return;
     }
@@ -816,8 +1053,11 @@ void ATMWithFTXUI::handleChangePassword() {
         return;
     }
 
-    userData.set(currentAccount + "_password", newPassword);
-    saveUserData();
+    updateUserData(currentAccount + "_password", newPassword);
+    if (!saveUserData()) {
+        message = "❌ 密码修改失败，请重试！";
+        return;
+    }
 
     message = "✅ 密码修改成功！";
     oldPassword = "";
@@ -844,6 +1084,63 @@ void ATMWithFTXUI::ejectCard() {
     nameInput = "";
 }
 
+// 口令只比对SHA-256摘要，终端里不保存明文；输入框在核对后立即清空
+bool ATMWithFTXUI::operatorLogin() {
+    time_t now = time(0);
+    if (!operatorEnabled) return false;
+    if (operatorLockedUntil > now) {
+        message = "❌ 运维口令错误次数过多，请 " + std::to_string((long long)(operatorLockedUntil - now)) + " 秒后再试";
+        operatorPassword = "";
+        return false;
+    }
+    bool matched = sha256(operatorPassword.data(), operatorPassword.size()) == operatorKey;
+    operatorPassword = "";
+    if (!matched) {
+        if (++operatorFailures >= 3) {
+            operatorFailures = 0;
+            operatorLockedUntil = now + 300;
+        }
+        message = "❌ 运维口令错误！";
+        return false;
+    }
+    operatorFailures = 0;
+    operatorAuthenticated = true;
+    return true;
+}
+
+void ATMWithFTXUI::leaveOperator() {
+    operatorAuthenticated = false;
+    operatorPassword = "";
+    operatorResults.clear();
+    operatorTitle = "";
+    selectedMenuItem = 0;
+}
+
+void ATMWithFTXUI::runOperatorQuery(int query) {
+    if (!accountIndex || !operatorAuthenticated) return;
+    auto start = std::chrono::steady_clock::now();
+    switch (query) {
+    case 0:
+        operatorTitle = "余额最高的账户";
+        operatorResults = accountIndex->topBalances(20);
+        break;
+    case 1:
+        operatorTitle = "锁定中的账户";
+        operatorResults = accountIndex->lockedAccounts(time(0), 50);
+        break;
+    case 2:
+        // 每个账户按所属层级的单日限额，余量为限额的20%
+        operatorTitle = "今日取款接近所属层级单日限额的账户";
+        operatorResults = accountIndex->nearDailyLimit(limitRules.table(), 0.2, 50);
+        break;
+    case 3:
+        operatorTitle = "姓名以「" + operatorNamePrefix + "」开头的账户";
+        operatorResults = accountIndex->findByName(operatorNamePrefix, 50);
+        break;
+    }
+    operatorQueryMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 bool ATMWithFTXUI::isAllDigits(const std::string& str) {
     return std::all_of(str.begin(), str.end(), ::isdigit);
 }
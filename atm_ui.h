@@ -1,7 +1,13 @@
 #ifndef ATM_UI_H
 #define ATM_UI_H
 
-#include "simple_json.h"
+#include "account_store.h"
+#include "lockout_manager.h"
+#include "limit_rules.h"
+#include "account_index.h"
+#include "fraud_detector.h"
+#include "operation_arena.h"
+#include "sha256.h"
 #include "ftxui/dom/elements.hpp"
 #include "ftxui/component/component.hpp"
 #include "ftxui/component/screen_interactive.hpp"
@@ -9,18 +15,29 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <ctime>
 
 using namespace ftxui;
 
 class ATMWithFTXUI {
 private:
-    SimpleJson userData;
+    std::unique_ptr<AccountStore> userData;
+    AccountIndex* accountIndex;
+    FraudMonitor* fraudMonitor;
+    ChangeBatch pendingChanges;
+
+    std::string terminalId;
     std::string currentAccount;
     bool isLoggedIn;
-    int loginAttempts;
-    const double INITIAL_BALANCE = 10000.0;
-    const double DAILY_WITHDRAWAL_LIMIT = 5000.0;
-    const double SINGLE_WITHDRAWAL_LIMIT = 2000.0;
+    LockoutManager lockouts;
+    LimitRules& limitRules;
+    AccountOperations operations;
+
+    // 临时字符串的内存：每帧渲染开始时重置frameArena，每次处理请求开始时重置requestArena
+    OperationArena<16 << 10> frameArena;
+    OperationArena<4 << 10> requestArena;
 
     // UI状态变量
     std::string accountInput;
@@ -31,24 +48,44 @@ private:
     std::string transferAccount;
     std::string transferConfirmAccount;
     std::string transferAmount;
+
+    // 转账对方账号的输入提示：按键时向存储查前缀计数，按输入内容缓存结果
+    std::string transferLookupInput;
+    std::string transferLookupText;
     std::string oldPassword;
     std::string newPassword;
     std::string confirmPassword;
     std::string idCardInput;
     std::string nameInput;
 
+    // 运维查询（仅在同时传入索引和运维口令摘要时可用）。从登录界面进入须先输入口令，
+    // 连续输错3次锁定5分钟；返回登录界面即退出运维身份
+    bool operatorEnabled;
+    Sha256Digest operatorKey;
+    std::string operatorPassword;
+    bool operatorAuthenticated;
+    int operatorFailures;
+    time_t operatorLockedUntil;
+    std::string operatorNamePrefix;
+    std::string operatorTitle;
+    std::vector<AccountSummary> operatorResults;
+    double operatorQueryMs;
+
     int selectedMenuItem;
     bool shouldExit;
     std::vector<std::string> menuItems;
 
 public:
-    ATMWithFTXUI();
+    // operatorKey为运维口令的SHA-256，与index同时给出时才开放运维查询
+    ATMWithFTXUI(std::unique_ptr<AccountStore> store, LimitRules& rules, AccountIndex* index = nullptr,
+        const Sha256Digest* operatorKey = nullptr, FraudMonitor* fraud = nullptr);
     void run();
 
 private:
     // 核心业务方法
     void loadUserData();
-    void saveUserData();
+    bool saveUserData();
+    void updateUserData(const std::string& key, const std::string& value);
     bool isAccountExists(const std::string& account);
     bool login();
     bool createNewAccount();
@@ -57,11 +94,19 @@ private:
     void handleTransfer();
     void handleChangePassword();
     void ejectCard();
+    bool operatorLogin();
+    void leaveOperator();
+    void runOperatorQuery(int query);
     bool isAllDigits(const std::string& str);
     std::string getCurrentTime();
     bool isValidIdCard(const std::string& idCard);
     bool isValidAccount(const std::string& account);
     bool isIdCardRegistered(const std::string& idCard);
+    void setMessage(std::string_view text);
+    // 账户所属层级的限额（分）
+    const LimitRow& limitsOf(const std::string& account) const;
+    const std::string& transferTargetHint();
+    std::string transferConfirmHint();
 
     // UI组件方法
     Component createLoginComponent();
@@ -71,6 +116,8 @@ private:
     Component createWithdrawComponent();
     Component createTransferComponent();
     Component createChangePasswordComponent();
+    Component createOperatorLoginComponent();
+    Component createOperatorComponent();
     Component createAppComponent();
 
     // UI辅助方法
@@ -79,7 +126,7 @@ private:
     Component largeButton(const std::string& label, std::function<void()> on_click);
     Component largeInput(std::string* content, const std::string& placeholder);
     Element card(Element content);
-    Element infoPanel(const std::string& title, const std::vector<std::string>& items);
+    Element infoPanel(const std::string& title, const std::pmr::vector<std::pmr::string>& items);
 };
 
 #endif
\ No newline at end of file
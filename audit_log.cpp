@@ -0,0 +1,489 @@
+#include "audit_log.h"
+#include "account_store.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+struct AuditCheckpoint {
+    uint64_t segment;
+    uint64_t lastSequence;
+    Sha256Digest head;
+    Sha256Digest root;
+    Sha256Digest lastDigest;
+    std::vector<Sha256Digest> peaks;    // 按层从低到高，只含存在的峰
+};
+
+// 叶子数为leaves时追加一个叶子：与同层的峰两两合并，直到遇到空层
+static void pushLeaf(std::vector<Sha256Digest>& peaks, uint64_t leaves, Sha256Digest leaf) {
+    size_t level = 0;
+    while (leaves & (1ULL << level)) {
+        leaf = sha256Pair(peaks[level], leaf);
+        level++;
+    }
+    if (peaks.size() <= level) peaks.resize(level + 1);
+    peaks[level] = leaf;
+}
+
+// 从低层往高层把各峰并成一个根
+static Sha256Digest bagPeaks(const std::vector<Sha256Digest>& peaks, uint64_t leaves) {
+    Sha256Digest root = Sha256Digest();
+    bool first = true;
+    for (size_t level = 0; level < 64; level++) {
+        if (!(leaves & (1ULL << level))) continue;
+        root = first ? peaks[level] : sha256Pair(peaks[level], root);
+        first = false;
+    }
+    return root;
+}
+
+static bool parseCheckpoint(const char* line, size_t length, AuditCheckpoint& checkpoint) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+        if (i == length || line[i] == ' ' || line[i] == '\n') {
+            if (i > start) fields.emplace_back(line + start, i - start);
+            start = i + 1;
+        }
+    }
+    if (fields.size() < 6 || fields[0] != "C") return false;
+    char* end = nullptr;
+    checkpoint.segment = std::strtoull(fields[1].c_str(), &end, 10);
+    if (*end != '\0') return false;
+    checkpoint.lastSequence = std::strtoull(fields[2].c_str(), &end, 10);
+    if (*end != '\0') return false;
+    if (!parseDigestHex(fields[3], checkpoint.head) || !parseDigestHex(fields[4], checkpoint.root) ||
+        !parseDigestHex(fields[5], checkpoint.lastDigest)) return false;
+    checkpoint.peaks.resize(fields.size() - 6);
+    for (size_t i = 6; i < fields.size(); i++) {
+        if (!parseDigestHex(fields[i], checkpoint.peaks[i - 6])) return false;
+    }
+    return checkpoint.peaks.size() == (size_t)__builtin_popcountll(checkpoint.segment + 1);
+}
+
+// 记录正文（不含标记和序号），其摘要用于重启时在事务日志中找到最后一条已审计的提交
+static std::string encodeBody(const TransactionRecord& record) {
+    std::string text = std::to_string(record.committedAt) + " " +
+        (record.requestId.empty() ? std::string("-") : record.requestId) + " " +
+        std::to_string(record.result.kind) + " " + std::to_string(record.result.amount) + " " +
+        std::to_string(record.changes.size()) + "\n";
+    for (const auto& change : record.changes) {
+        text += change.first + "\t" + change.second + "\n";
+    }
+    return text;
+}
+
+AuditLog::AuditLog(const std::string& path, size_t batchBytes) :
+    path(path),
+    fd(-1),
+    batchBytes(batchBytes),
+    fileBytes(0),
+    lastBodyStart(0),
+    lastTag('E'),
+    nextSequence(1),
+    segments(0),
+    chainHead(),
+    lastDigest() {
+}
+
+AuditLog::~AuditLog() {
+    if (fd >= 0) {
+        flush();
+        ::close(fd);
+    }
+}
+
+// 检查点行总在一批的末尾；从文件末尾往前找最后一个完整的检查点行，找不到就把读取范围放大
+bool AuditLog::readLastCheckpoint(uint64_t fileSize, uint64_t& checkpointEnd) {
+    for (uint64_t chunk = 64 << 10;; chunk *= 4) {
+        uint64_t offset = fileSize > chunk ? fileSize - chunk : 0;
+        std::string tail(fileSize - offset, '\0');
+        if (::pread(fd, &tail[0], tail.size(), offset) != (ssize_t)tail.size()) return false;
+
+        size_t lineEnd = tail.rfind('\n');
+        while (lineEnd != std::string::npos) {
+            size_t previous = lineEnd == 0 ? std::string::npos : tail.rfind('\n', lineEnd - 1);
+            if (previous == std::string::npos && offset > 0) break;
+            size_t lineStart = previous == std::string::npos ? 0 : previous + 1;
+            AuditCheckpoint checkpoint;
+            if (tail.compare(lineStart, 2, "C ") == 0 &&
+                parseCheckpoint(tail.data() + lineStart, lineEnd - lineStart, checkpoint)) {
+                segments = checkpoint.segment + 1;
+                nextSequence = checkpoint.lastSequence + 1;
+                chainHead = checkpoint.head;
+                lastDigest = checkpoint.lastDigest;
+                peaks.assign(64, Sha256Digest());
+                size_t next = 0;
+                for (size_t level = 0; level < 64; level++) {
+                    if (segments & (1ULL << level)) peaks[level] = checkpoint.peaks[next++];
+                }
+                checkpointEnd = offset + lineEnd + 1;
+                return bagPeaks(peaks, segments) == checkpoint.root;
+            }
+            lineEnd = previous;
+        }
+        if (offset == 0) return false;
+    }
+}
+
+bool AuditLog::open(const std::map<std::string, std::string>& current, const std::vector<TransactionRecord>& recent) {
+    if (fd >= 0) return true;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    if (!openFile(current, recent)) {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        pending.clear();
+        entryEnds.clear();
+        return false;
+    }
+    return true;
+}
+
+bool AuditLog::openFile(const std::map<std::string, std::string>& current, const std::vector<TransactionRecord>& recent) {
+    struct stat info;
+    if (::fstat(fd, &info) != 0) return false;
+
+    uint64_t checkpointEnd = 0;
+    if (info.st_size > 0 && readLastCheckpoint(info.st_size, checkpointEnd)) {
+        if (checkpointEnd < (uint64_t)info.st_size && ::ftruncate(fd, checkpointEnd) != 0) return false;
+        fileBytes = checkpointEnd;
+        for (size_t i = firstUnauditedRecord(recent, lastDigest); i < recent.size(); i++) {
+            append(recent[i]);
+        }
+        return flush();
+    }
+
+    // 新日志，或者连第一批都没写完：以当前全部数据为基线重新开始
+    if (::ftruncate(fd, 0) != 0) return false;
+    fileBytes = 0;
+    std::string body = std::to_string(unixTimeNow()) + " " + std::to_string(current.size()) + "\n";
+    for (const auto& pair : current) {
+        body += pair.first + "\t" + pair.second + "\n";
+    }
+    appendEntry(body, 'S');
+    return flush();
+}
+
+void AuditLog::appendEntry(const std::string& body, char tag) {
+    pending += tag;
+    pending += ' ';
+    pending += std::to_string(nextSequence++);
+    pending += ' ';
+    lastBodyStart = pending.size();
+    lastTag = tag;
+    pending += body;
+    entryEnds.push_back(pending.size());
+}
+
+void AuditLog::append(const TransactionRecord& record) {
+    if (record.changes.empty()) return;
+    appendEntry(encodeBody(record), 'E');
+    if (pending.size() >= batchBytes) flush();
+}
+
+// 整批一次算完链头，连同检查点一次写入
+bool AuditLog::flush() {
+    if (fd < 0 || entryEnds.empty()) return fd >= 0;
+    Sha256Digest head = chainHead;
+    size_t start = 0;
+    for (size_t end : entryEnds) {
+        Sha256 hash;
+        hash.update(head.bytes, sizeof(head.bytes));
+        hash.update(pending.data() + start, end - start);
+        head = hash.finish();
+        start = end;
+    }
+    Sha256Digest batchLastDigest = lastTag == 'E' ?
+        sha256(pending.data() + lastBodyStart, pending.size() - lastBodyStart) : Sha256Digest();
+    std::vector<Sha256Digest> nextPeaks = peaks;
+    pushLeaf(nextPeaks, segments, head);
+    uint64_t leaves = segments + 1;
+
+    size_t entriesEnd = pending.size();
+    pending += "C " + std::to_string(segments) + " " + std::to_string(nextSequence - 1) + " " + digestHex(head) + " " +
+        digestHex(bagPeaks(nextPeaks, leaves)) + " " + digestHex(batchLastDigest);
+    for (size_t level = 0; level < 64; level++) {
+        if (leaves & (1ULL << level)) pending += " " + digestHex(nextPeaks[level]);
+    }
+    pending += "\n";
+
+    size_t written = 0;
+    while (written < pending.size()) {
+        ssize_t n = ::write(fd, pending.data() + written, pending.size() - written);
+        if (n <= 0) break;
+        written += n;
+    }
+    if (written < pending.size() || ::fdatasync(fd) != 0) {
+        if (::ftruncate(fd, fileBytes) != 0) {
+            // 截不回去就停止追加，下次打开时丢弃最后一个检查点之后残缺的一批
+            ::close(fd);
+            fd = -1;
+        }
+        pending.resize(entriesEnd);
+        return false;
+    }
+
+    fileBytes += pending.size();
+    chainHead = head;
+    peaks.swap(nextPeaks);
+    segments = leaves;
+    lastDigest = batchLastDigest;
+    pending.clear();
+    entryEnds.clear();
+    return true;
+}
+
+namespace {
+
+struct SegmentResult {
+    AuditCheckpoint checkpoint;
+    uint64_t entries;
+};
+
+struct RangeResult {
+    std::vector<SegmentResult> segments;
+    std::string error;
+    uint64_t trailingBytes = 0;
+};
+
+class AuditVerifier {
+public:
+    AuditVerifier(const char* data, size_t size) : data(data), size(size) {}
+
+    // 处理检查点行起点落在[begin, limit)内的检查点之后的各段；begin为0时先处理第0段
+    void verifyRange(size_t begin, size_t limit, RangeResult& result) {
+        size_t position = begin;
+        Sha256Digest head = Sha256Digest();
+        uint64_t sequence = 0;
+        if (begin > 0) {
+            if (data[begin - 1] != '\n') position = nextLine(begin);
+            while (position < limit && !isCheckpoint(position)) {
+                position = nextLine(position);
+            }
+            if (position >= limit) return;
+            AuditCheckpoint start;
+            size_t end = nextLine(position);
+            if (!parseCheckpoint(data + position, end - position, start)) {
+                result.error = "检查点格式错误，偏移 " + std::to_string(position);
+                return;
+            }
+            head = start.head;
+            sequence = start.lastSequence;
+            position = end;
+        }
+
+        while (position < size) {
+            size_t segmentStart = position;
+            uint64_t entries = 0;
+            while (position < size && !isCheckpoint(position)) {
+                size_t entryEnd;
+                uint64_t entrySequence;
+                if (!parseEntry(position, entryEnd, entrySequence)) {
+                    // 最后一个检查点之后没写完的一批
+                    if (!hasCheckpointAfter(position)) {
+                        result.trailingBytes = size - segmentStart;
+                        return;
+                    }
+                    result.error = "记录格式错误，偏移 " + std::to_string(position);
+                    return;
+                }
+                if (entrySequence != sequence + 1) {
+                    result.error = "记录序号不连续，偏移 " + std::to_string(position);
+                    return;
+                }
+                Sha256 hash;
+                hash.update(head.bytes, sizeof(head.bytes));
+                hash.update(data + position, entryEnd - position);
+                head = hash.finish();
+                sequence = entrySequence;
+                entries++;
+                position = entryEnd;
+            }
+            if (position >= size) {
+                result.trailingBytes = size - segmentStart;
+                return;
+            }
+
+            size_t checkpointStart = position;
+            size_t end = nextLine(position);
+            SegmentResult segment;
+            segment.entries = entries;
+            if (end > size || data[end - 1] != '\n' || !parseCheckpoint(data + position, end - position, segment.checkpoint)) {
+                result.error = "检查点格式错误，偏移 " + std::to_string(position);
+                return;
+            }
+            if (segment.checkpoint.head != head || segment.checkpoint.lastSequence != sequence) {
+                result.error = "第 " + std::to_string(segment.checkpoint.segment) + " 段链头不符（偏移 " +
+                    std::to_string(segmentStart) + " 起的记录被改动）";
+                return;
+            }
+            result.segments.push_back(segment);
+            position = end;
+            if (checkpointStart >= limit) return;
+        }
+    }
+
+private:
+    size_t nextLine(size_t position) const {
+        const void* newline = std::memchr(data + position, '\n', size - position);
+        return newline ? (const char*)newline - data + 1 : size;
+    }
+
+    bool isCheckpoint(size_t position) const {
+        return position + 1 < size && data[position] == 'C' && data[position + 1] == ' ';
+    }
+
+    bool hasCheckpointAfter(size_t position) const {
+        while (position < size) {
+            if (isCheckpoint(position)) return true;
+            position = nextLine(position);
+        }
+        return false;
+    }
+
+    // E/S记录：首行第二个字段是序号、最后一个字段是修改条数，其后跟对应条数的行
+    bool parseEntry(size_t position, size_t& entryEnd, uint64_t& sequence) const {
+        if (position + 2 >= size || (data[position] != 'E' && data[position] != 'S') || data[position + 1] != ' ') {
+            return false;
+        }
+        size_t headerEnd = nextLine(position);
+        if (data[headerEnd - 1] != '\n') return false;
+        char* parsed = nullptr;
+        sequence = std::strtoull(data + position + 2, &parsed, 10);
+        if (parsed == data + position + 2) return false;
+        size_t countStart = headerEnd - 1;
+        while (countStart > position && data[countStart - 1] != ' ') countStart--;
+        uint64_t count = std::strtoull(data + countStart, &parsed, 10);
+        if (parsed != data + headerEnd - 1) return false;
+
+        entryEnd = headerEnd;
+        for (uint64_t i = 0; i < count; i++) {
+            if (entryEnd >= size) return false;
+            entryEnd = nextLine(entryEnd);
+            if (data[entryEnd - 1] != '\n') return false;
+        }
+        return true;
+    }
+
+    const char* data;
+    size_t size;
+};
+
+}
+
+bool verifyAuditLog(const std::string& path, unsigned threads, AuditVerifyReport& report, const Sha256Digest* anchor) {
+    report = AuditVerifyReport();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        report.error = "无法打开 " + path;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        report.error = "审计日志为空";
+        return false;
+    }
+    size_t size = info.st_size;
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        report.error = "无法映射 " + path;
+        return false;
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+    auto start = std::chrono::steady_clock::now();
+    if (threads == 0) threads = 1;
+    size_t rangeBytes = std::max<size_t>(1 << 20, size / (threads * 16) + 1);
+    size_t rangeCount = (size + rangeBytes - 1) / rangeBytes;
+    std::vector<RangeResult> ranges(rangeCount);
+    std::atomic<size_t> nextRange(0);
+    AuditVerifier verifier((const char*)mapped, size);
+    auto worker = [&] {
+        for (size_t range; (range = nextRange.fetch_add(1)) < rangeCount;) {
+            verifier.verifyRange(range * rangeBytes, std::min(size, (range + 1) * rangeBytes), ranges[range]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    ::munmap(mapped, size);
+
+    // 按文件顺序核对段号连续，并以各段链头重建Merkle树，核对每个检查点的根
+    std::vector<Sha256Digest> peaks;
+    report.bytes = size;
+    for (const auto& range : ranges) {
+        if (!range.error.empty()) {
+            report.error = range.error;
+            break;
+        }
+        for (const auto& segment : range.segments) {
+            if (segment.checkpoint.segment != report.segments) {
+                report.error = "检查点段号不连续: " + std::to_string(segment.checkpoint.segment);
+                break;
+            }
+            pushLeaf(peaks, report.segments, segment.checkpoint.head);
+            report.segments++;
+            if (bagPeaks(peaks, report.segments) != segment.checkpoint.root) {
+                report.error = "第 " + std::to_string(segment.checkpoint.segment) + " 段Merkle根不符";
+                break;
+            }
+            if (anchor && *anchor == segment.checkpoint.root) report.anchorFound = true;
+            report.entries += segment.entries;
+            report.head = segment.checkpoint.head;
+            report.root = segment.checkpoint.root;
+        }
+        report.trailingBytes += range.trailingBytes;
+        if (!report.error.empty()) break;
+    }
+    if (report.error.empty() && report.segments == 0) report.error = "没有完整的检查点";
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    report.ok = report.error.empty();
+    return report.ok;
+}
+
+size_t firstUnauditedRecord(const std::vector<TransactionRecord>& recent, const Sha256Digest& lastDigest) {
+    for (size_t i = recent.size(); i-- > 0;) {
+        std::string body = encodeBody(recent[i]);
+        if (sha256(body.data(), body.size()) == lastDigest) return i + 1;
+    }
+    return 0;
+}
+
+bool replayAuditLog(const std::string& path, std::function<void(const std::string&, const std::string&)> apply,
+    Sha256Digest* lastDigest) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    // 一段的修改攒到检查点才生效，末尾没写完的一批不重放
+    std::vector<std::pair<std::string, std::string>> segment;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 2, "C ") == 0) {
+            AuditCheckpoint checkpoint;
+            if (lastDigest && parseCheckpoint(line.data(), line.size(), checkpoint)) *lastDigest = checkpoint.lastDigest;
+            for (const auto& change : segment) {
+                apply(change.first, change.second);
+            }
+            segment.clear();
+            continue;
+        }
+        size_t tab = line.find('\t');
+        if (tab != std::string::npos) segment.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include "sha256.h"
+#include "transaction_log.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+// 防篡改审计日志：每次提交的全部修改追加一条记录，记录之间用哈希链串起
+//   链头[i] = SHA256(链头[i-1] || 记录i的全部字节)
+// 格式（文本，逐行）：
+//   S <序号> <时间> <条数>                                    基线：首次开启审计时的全部数据
+//   E <序号> <时间> <请求ID|-> <kind> <amount> <条数>          一次提交
+//   <key>\t<value> ...
+//   C <段号> <末条序号> <链头> <Merkle根> <末条摘要> <峰...>   检查点
+// 记录先攒在内存里，每批（默认256KB）一次算完哈希、连同检查点一次写入并fdatasync，成为一段。
+// 检查点记下该段结束时的链头，验证时各段从上一个检查点的链头出发独立重算，可以并行；
+// Merkle根是以各段链头为叶子的树根（峰为各满二叉子树的根，重开日志时据此接着建树），
+// 把最新的根交给外部留存后，任何改写历史的行为都会让根对不上。
+// 未落盘的记录对应的提交都还在事务日志里（单机存储压缩事务日志前先落盘审计日志），
+// 重启时按末条摘要找到最后一条已审计的提交，补记其后的提交。
+// 调用方负责互斥。
+class AuditLog {
+public:
+    AuditLog(const std::string& path, size_t batchBytes = 256 << 10);
+    ~AuditLog();
+
+    // 打开已有日志（截掉末尾没写完的一批）或新建并写入基线；recent为事务日志中仍带修改内容的提交
+    bool open(const std::map<std::string, std::string>& current, const std::vector<TransactionRecord>& recent);
+    void append(const TransactionRecord& record);
+    // 写入失败时文件截回原长度，记录留在内存中下次重试
+    bool flush();
+
+    bool isOpen() const { return fd >= 0; }
+    uint64_t entryCount() const { return nextSequence - 1; }
+    uint64_t sizeBytes() const { return fileBytes + pending.size(); }
+    const Sha256Digest& head() const { return chainHead; }
+
+private:
+    bool openFile(const std::map<std::string, std::string>& current, const std::vector<TransactionRecord>& recent);
+    void appendEntry(const std::string& body, char tag);
+    bool readLastCheckpoint(uint64_t fileSize, uint64_t& checkpointEnd);
+
+    std::string path;
+    int fd;
+    size_t batchBytes;
+    uint64_t fileBytes;
+    std::string pending;
+    std::vector<size_t> entryEnds;
+    size_t lastBodyStart;
+    char lastTag;
+
+    uint64_t nextSequence;
+    uint64_t segments;
+    Sha256Digest chainHead;
+    Sha256Digest lastDigest;
+    std::vector<Sha256Digest> peaks;    // peaks[level]，仅segments的二进制第level位为1时有效
+};
+
+struct AuditVerifyReport {
+    bool ok = false;
+    std::string error;
+    uint64_t bytes = 0;
+    uint64_t entries = 0;
+    uint64_t segments = 0;
+    uint64_t trailingBytes = 0;     // 最后一个检查点之后未写完的一批
+    Sha256Digest head = Sha256Digest();
+    Sha256Digest root = Sha256Digest();
+    bool anchorFound = false;       // 外部留存的根是否是某个检查点的根
+    double seconds = 0;
+};
+
+// 按字节区间分给threads个线程：每个线程从区间内第一个检查点之后开始，
+// 以该检查点的链头为起点重算其后各段，核对段末检查点；最后顺序核对Merkle根。
+// 日志只追加，之前任一时刻留存的根（anchor）都应出现在某个检查点上
+bool verifyAuditLog(const std::string& path, unsigned threads, AuditVerifyReport& report,
+    const Sha256Digest* anchor = nullptr);
+// 按顺序重放基线与各次提交（只到最后一个检查点为止）；lastDigest非空时取回最后一个检查点的末条摘要
+bool replayAuditLog(const std::string& path, std::function<void(const std::string&, const std::string&)> apply,
+    Sha256Digest* lastDigest = nullptr);
+// recent中第一条尚未审计的提交：按末条摘要从后往前找，找不到时整个recent都算未审计
+size_t firstUnauditedRecord(const std::vector<TransactionRecord>& recent, const Sha256Digest& lastDigest);
+
+#endif
@@ -0,0 +1,219 @@
+#include "audit_log.h"
+#include "account_store.h"
+#include "synthetic_accounts.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <thread>
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printReport(const AuditVerifyReport& report, unsigned threads) {
+    std::printf("%.1f MB，%" PRIu64 " 条记录，%" PRIu64 " 段，%u 线程，SHA-256: %s，耗时 %.3f s，%.2f GB/s\n",
+        report.bytes / 1e6, report.entries, report.segments, threads, sha256Backend(), report.seconds,
+        report.bytes / (report.seconds > 0 ? report.seconds : 1e-9) / 1e9);
+}
+
+// 按审计日志重放出的数据与数据文件逐键比对，不一致的键即未经提交被改动过。
+// 审计日志按批落盘，最后一批之后的提交只在事务日志里（存储下次打开时补记），
+// 这些提交单独列出并计入审计一侧，不算作篡改
+static int compareWithData(const std::string& auditFile, const std::string& dataFile) {
+    std::map<std::string, std::string> audited;
+    std::map<std::string, std::string> current;
+    Sha256Digest lastDigest = Sha256Digest();
+    replayAuditLog(auditFile, [&](const std::string& key, const std::string& value) {
+        audited[key] = value;
+    }, &lastDigest);
+    if (!loadAccountData(dataFile, current)) {
+        std::cerr << "无法读取数据文件: " << dataFile << std::endl;
+        return 1;
+    }
+    std::vector<TransactionRecord> recent;
+    for (const auto& log : { dataFile + ".txlog.checkpoint", dataFile + ".txlog" }) {
+        TransactionLog(log).replay([&](const TransactionRecord& record) {
+            if (!record.changes.empty()) recent.push_back(record);
+        });
+    }
+    size_t unaudited = firstUnauditedRecord(recent, lastDigest);
+    for (size_t i = unaudited; i < recent.size(); i++) {
+        for (const auto& change : recent[i].changes) {
+            audited[change.first] = change.second;
+        }
+    }
+    if (unaudited < recent.size()) {
+        std::printf("事务日志中有 %zu 条提交尚未落盘到审计日志（存储下次打开时补记），按事务日志计入\n",
+            recent.size() - unaudited);
+    }
+
+    size_t mismatched = 0;
+    auto report = [&](const std::string& key, const std::string& expected, const std::string& actual) {
+        if (++mismatched <= 20) {
+            std::printf("  %s  审计: %s  数据文件: %s\n", key.c_str(), expected.empty() ? "(无)" : expected.c_str(),
+                actual.empty() ? "(无)" : actual.c_str());
+        }
+    };
+    auto a = audited.begin();
+    auto c = current.begin();
+    while (a != audited.end() || c != current.end()) {
+        if (c == current.end() || (a != audited.end() && a->first < c->first)) {
+            report(a->first, a->second, "");
+            ++a;
+        }
+        else if (a == audited.end() || c->first < a->first) {
+            report(c->first, "", c->second);
+            ++c;
+        }
+        else {
+            if (a->second != c->second) report(a->first, a->second, c->second);
+            ++a;
+            ++c;
+        }
+    }
+    if (mismatched > 0) {
+        std::printf("数据文件与审计日志不一致的键 %zu 个\n", mismatched);
+        return 1;
+    }
+    std::printf("数据文件 %s 与审计日志一致（%zu 个键）\n", dataFile.c_str(), current.size());
+    return 0;
+}
+
+static int runVerify(const std::string& auditFile, unsigned threads, const std::string& dataFile, const std::string& expectRoot) {
+    Sha256Digest anchor;
+    if (!expectRoot.empty() && !parseDigestHex(expectRoot, anchor)) {
+        std::cerr << "留存的根应为64位十六进制: " << expectRoot << std::endl;
+        return 1;
+    }
+    AuditVerifyReport report;
+    bool ok = verifyAuditLog(auditFile, threads, report, expectRoot.empty() ? nullptr : &anchor);
+    printReport(report, threads);
+    if (!ok) {
+        std::printf("验证失败: %s\n", report.error.c_str());
+        return 1;
+    }
+    if (report.trailingBytes > 0) {
+        std::printf("末尾有 %" PRIu64 " 字节未写完的一批（下次打开时丢弃，对应提交从事务日志补记）\n", report.trailingBytes);
+    }
+    std::printf("链头 %s\nMerkle根 %s（交给外部留存，下次验证时用 --expect 核对）\n", digestHex(report.head).c_str(),
+        digestHex(report.root).c_str());
+    if (!expectRoot.empty() && !report.anchorFound) {
+        std::printf("留存的根 %s 不是任何检查点的根，历史记录被改写过\n", expectRoot.c_str());
+        return 1;
+    }
+    return dataFile.empty() ? 0 : compareWithData(auditFile, dataFile);
+}
+
+// 基准：合成转账提交写入审计日志（每条两个余额修改），测追加开销；再测各线程数下的验证速度，
+// 最后改动一个字节确认验证能发现
+static int runBench(size_t megabytes, unsigned threads) {
+    const std::string auditFile = "bench_audit.log";
+    std::remove(auditFile.c_str());
+
+    std::map<std::string, std::string> data;
+    generateAccounts(10000, data);
+    std::vector<std::string> accounts;
+    for (const auto& pair : data) {
+        if (pair.first.size() == 28 && pair.first.compare(19, 9, "_password") == 0) {
+            accounts.push_back(pair.first.substr(0, 19));
+        }
+    }
+
+    uint64_t committed = 0;
+    double appendSeconds;
+    {
+        AuditLog log(auditFile);
+        if (!log.open(data, {})) {
+            std::cerr << "无法创建: " << auditFile << std::endl;
+            return 1;
+        }
+        std::mt19937_64 rng(20240601);
+        int64_t now = unixTimeNow();
+        uint64_t target = (uint64_t)megabytes << 20;
+        auto start = std::chrono::steady_clock::now();
+        while (log.sizeBytes() < target) {
+            const std::string& from = accounts[rng() % accounts.size()];
+            const std::string& to = accounts[rng() % accounts.size()];
+            double amount = (double)(1 + rng() % 5000);
+            TransactionRecord record{ "T1234-" + std::to_string(now) + "-" + std::to_string(committed),
+                RequestResult{ REQUEST_TRANSFER, amount }, now,
+                ChangeBatch{ { from + "_balance", std::to_string(10000.0 - amount) },
+                    { to + "_balance", std::to_string(10000.0 + amount) } } };
+            log.append(record);
+            committed++;
+        }
+        log.flush();
+        appendSeconds = elapsedSeconds(start);
+    }
+    std::printf("追加 %" PRIu64 " 条提交，%.2f s，每条 %.2f µs（含每256KB一次fdatasync），%.0f 条/s\n", committed,
+        appendSeconds, appendSeconds * 1e6 / committed, committed / appendSeconds);
+
+    AuditVerifyReport report;
+    for (unsigned n = 1; n <= threads; n *= 2) {
+        if (!verifyAuditLog(auditFile, n, report)) {
+            std::printf("验证失败: %s\n", report.error.c_str());
+            return 1;
+        }
+        printReport(report, n);
+    }
+    sha256ForceSoftware(true);
+    verifyAuditLog(auditFile, threads, report);
+    printReport(report, threads);
+    sha256ForceSoftware(false);
+
+    FILE* file = std::fopen(auditFile.c_str(), "r+");
+    if (file) {
+        std::fseek(file, (long)(report.bytes / 2), SEEK_SET);
+        int c = std::fgetc(file);
+        while (c != EOF && (c < '0' || c > '8')) c = std::fgetc(file);
+        if (c != EOF) {
+            std::fseek(file, -1, SEEK_CUR);
+            std::fputc(c + 1, file);
+        }
+        std::fclose(file);
+    }
+    bool detected = !verifyAuditLog(auditFile, threads, report);
+    std::printf("改动文件中部的一个数字后: %s\n", detected ? report.error.c_str() : "未发现（异常）");
+    std::remove(auditFile.c_str());
+    return detected ? 0 : 1;
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " verify <审计日志> [--threads N] [--data 数据文件] [--expect 留存的Merkle根]\n"
+        << "  " << program << " bench [MB] [--threads N]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string dataFile;
+    std::string expectRoot;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) threads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--data" && i + 1 < argc) dataFile = argv[++i];
+        else if (arg == "--expect" && i + 1 < argc) expectRoot = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else args.push_back(arg);
+    }
+
+    if (command == "verify" && args.size() == 1) {
+        return runVerify(args[0], threads, dataFile, expectRoot);
+    }
+    if (command == "bench") {
+        return runBench(args.empty() ? 512 : std::stoul(args[0]), threads);
+    }
+    usage(argv[0]);
+    return 1;
+}
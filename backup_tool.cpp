@@ -0,0 +1,246 @@
+#include "online_backup.h"
+#include "account_store.h"
+#include "columnar_snapshot.h"
+#include "limit_rules.h"
+#include "synthetic_accounts.h"
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+static int runList(const std::string& directory) {
+    std::vector<BackupFileInfo> files;
+    std::string error;
+    if (!listBackups(directory, files, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    std::printf("%8s %6s %8s %-19s %10s %10s  %s\n", "序号", "类型", "上一个", "时间", "账号数", "键数", "文件");
+    for (const auto& info : files) {
+        char when[32];
+        time_t createdAt = (time_t)info.createdAt;
+        std::strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", std::localtime(&createdAt));
+        std::printf("%8" PRIu64 " %6s %8s %-19s %10zu %10zu  %s\n", info.sequence, info.base ? "基础" : "增量",
+            info.base ? "-" : std::to_string(info.parent).c_str(), when, info.accounts, info.keys, info.file.c_str());
+    }
+    return 0;
+}
+
+// 先写临时文件再rename；输出旁边留着旧的事务日志时拒绝，否则下次启动会把它重放到恢复出的数据上
+static int runRestore(const std::string& directory, const std::string& output, uint64_t until) {
+    for (const auto& log : { output + ".txlog", output + ".txlog.checkpoint" }) {
+        if (::access(log.c_str(), F_OK) == 0) {
+            std::cerr << "输出文件旁已有事务日志 " << log << "，请先移走再恢复" << std::endl;
+            return 1;
+        }
+    }
+    std::map<std::string, std::string> data;
+    RestoreReport report;
+    if (!restoreBackup(directory, until, data, report)) {
+        std::cerr << report.error << std::endl;
+        return 1;
+    }
+    std::string tmp = output + ".tmp";
+    bool ok;
+    if (isColumnarSnapshotFile(output)) {
+        ok = saveColumnarSnapshot(data, tmp, columnarCompressionAvailable());
+    }
+    else {
+        SimpleJson json;
+        for (const auto& entry : data) {
+            json.set(entry.first, entry.second);
+        }
+        ok = json.saveToFile(tmp);
+    }
+    if (!ok || std::rename(tmp.c_str(), output.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "无法写入: " << output << std::endl;
+        return 1;
+    }
+    std::printf("恢复到序号 %" PRIu64 "：合并 %zu 个文件（%.1f MB），%zu 个账号，%zu 个键，%.3f s -> %s\n", report.sequence,
+        report.files, report.bytes / 1e6, report.accounts, report.keys, report.seconds, output.c_str());
+    return 0;
+}
+
+static void printStats(const char* label, const BackupStats& stats) {
+    std::printf("  %-14s %10zu %10zu %12.1f %10.2f %12.3f\n", label, stats.accounts, stats.keys, stats.bytes / 1e3,
+        stats.seconds * 1e3, stats.maxLockSeconds * 1e3);
+}
+
+static int64_t totalBalance(const std::map<std::string, std::string>& data) {
+    int64_t total = 0;
+    for (const auto& entry : data) {
+        if (entry.first.size() > 8 && entry.first.compare(entry.first.size() - 8, 8, "_balance") == 0) {
+            total += toCents(std::stod(entry.second));
+        }
+    }
+    return total;
+}
+
+static void removeBackups(const std::string& directory) {
+    std::vector<BackupFileInfo> files;
+    std::string error;
+    listBackups(directory, files, error);
+    for (const auto& info : files) {
+        std::remove(info.file.c_str());
+    }
+}
+
+// 基准：合成账户。基础备份期间后台线程不停地转账（总余额守恒），检验分块复制得到的是一致映像；
+// 之后按不同的改动比例各改一批账号的当日取款额再做增量备份，大小与耗时应随改动量而不是账户数变化。
+// 最后把每个备份点都恢复出来核对总余额不变，并核对最新的恢复结果与存储逐键一致
+static int runBench(const std::vector<size_t>& sizes) {
+    const std::string dataFile = "bench_backup.json";
+    const std::string directory = "bench_backup";
+    std::printf("  %-14s %10s %10s %12s %10s %12s\n", "备份", "账号数", "键数", "大小KB", "耗时ms", "最长取数ms");
+    for (size_t accountCount : sizes) {
+        std::map<std::string, std::string> initial;
+        generateAccounts(accountCount, initial);
+        SimpleJson json;
+        for (const auto& entry : initial) {
+            json.set(entry.first, entry.second);
+        }
+        std::remove((dataFile + ".txlog").c_str());
+        std::remove((dataFile + ".txlog.checkpoint").c_str());
+        json.saveToFile(dataFile);
+        removeBackups(directory);
+
+        std::vector<std::string> accounts;
+        for (const auto& entry : initial) {
+            if (entry.first.size() == 28 && entry.first.compare(19, 9, "_password") == 0) {
+                accounts.push_back(entry.first.substr(0, 19));
+            }
+        }
+        int64_t expectedTotal = totalBalance(initial);
+        initial.clear();
+
+        LocalAccountStore store(dataFile);
+        store.load();
+        OnlineBackup backup(store, directory);
+        std::printf("%zu 个账户\n", accountCount);
+
+        std::atomic<bool> transferring(true);
+        std::atomic<uint64_t> transfers(0);
+        std::thread transferThread([&] {
+            std::mt19937_64 rng(20240601);
+            while (transferring.load()) {
+                const std::string& from = accounts[rng() % accounts.size()];
+                const std::string& to = accounts[rng() % accounts.size()];
+                if (from == to) continue;
+                int64_t fromCents = toCents(std::stod(store.get(from + "_balance")));
+                int64_t toBalance = toCents(std::stod(store.get(to + "_balance")));
+                int64_t amount = std::min<int64_t>(fromCents, 100 * (1 + rng() % 50));
+                ChangeBatch changes{ { from + "_balance", std::to_string((fromCents - amount) / 100.0) },
+                    { to + "_balance", std::to_string((toBalance + amount) / 100.0) } };
+                if (store.commit(changes, "", RequestResult{ REQUEST_NONE, 0 })) transfers++;
+            }
+        });
+
+        BackupStats stats;
+        bool ok = backup.takeBase(stats);
+        transferring = false;
+        transferThread.join();
+        if (ok) printStats("基础", stats);
+        // 基础备份之后的转账由收尾的增量带走，改动比例各行只含这一批
+        ok = ok && backup.takeIncremental(stats);
+        if (ok && !stats.file.empty()) printStats("增量 转账", stats);
+        std::mt19937_64 rng(7);
+        for (double churn : { 0.001, 0.01, 0.1 }) {
+            ChangeBatch changes;
+            size_t changed = std::max<size_t>(1, (size_t)(accounts.size() * churn));
+            for (size_t i = 0; i < changed; i++) {
+                changes.emplace_back(accounts[rng() % accounts.size()] + "_daily_withdrawal", std::to_string((double)(rng() % 50) * 100));
+            }
+            while (!store.commit(changes, "", RequestResult{ REQUEST_NONE, 0 })) {
+            }
+            ok = ok && backup.takeIncremental(stats);
+            char label[32];
+            std::snprintf(label, sizeof(label), "增量 %.1f%%", churn * 100);
+            if (ok) printStats(label, stats);
+        }
+        if (!ok) {
+            std::cerr << backup.lastError() << std::endl;
+            return 1;
+        }
+
+        // 每个备份点都应守恒；最新的备份点应与存储完全一致
+        std::vector<BackupFileInfo> files;
+        std::string error;
+        listBackups(directory, files, error);
+        std::map<std::string, std::string> restored;
+        RestoreReport report;
+        for (const auto& info : files) {
+            restored.clear();
+            report = RestoreReport();
+            if (!restoreBackup(directory, info.sequence, restored, report)) {
+                std::cerr << report.error << std::endl;
+                return 1;
+            }
+            if (totalBalance(restored) != expectedTotal) {
+                std::printf("备份点 %" PRIu64 " 的总余额不守恒，映像不一致\n", info.sequence);
+                return 1;
+            }
+        }
+        bool identical = restored == store.snapshot();
+        std::printf("  基础备份期间后台转账 %" PRIu64 " 笔；%zu 个备份点总余额都守恒；恢复最新备份合并 %zu 个文件 %.3f s，与存储%s\n",
+            transfers.load(), files.size(), report.files, report.seconds, identical ? "逐键一致" : "不一致（异常）");
+        if (!identical) return 1;
+    }
+    removeBackups(directory);
+    ::rmdir(directory.c_str());
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    return 0;
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " list <备份目录>                             列出备份\n"
+        << "  " << program << " restore <备份目录> <输出数据文件> [--until 序号]  合并基础备份与增量，恢复成数据文件（JSON或.snap）\n"
+        << "  " << program << " bench [账户数,...]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    uint64_t until = 0;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--until" && i + 1 < argc) until = std::stoull(argv[++i]);
+        else if (arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else args.push_back(arg);
+    }
+
+    if (command == "list" && args.size() == 1) {
+        return runList(args[0]);
+    }
+    if (command == "restore" && args.size() == 2) {
+        return runRestore(args[0], args[1], until);
+    }
+    if (command == "bench" && args.size() <= 1) {
+        std::vector<size_t> sizes;
+        std::string list = args.empty() ? "20000,100000" : args[0];
+        for (size_t pos = 0; pos < list.size(); ) {
+            size_t comma = list.find(',', pos);
+            if (comma == std::string::npos) comma = list.size();
+            sizes.push_back(std::stoul(list.substr(pos, comma - pos)));
+            pos = comma + 1;
+        }
+        return runBench(sizes);
+    }
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,470 @@
+#include "columnar_snapshot.h"
+#include "durable_file.h"
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <string_view>
+#ifdef ATM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const char SNAPSHOT_MAGIC[4] = { 'A', 'T', 'M', 'C' };
+static const unsigned char SNAPSHOT_VERSION = 1;
+static const unsigned char FLAG_ZLIB = 1;
+
+enum SnapshotField {
+    FIELD_PASSWORD,
+    FIELD_BALANCE,
+    FIELD_DAILY_WITHDRAWAL,
+    FIELD_LOCKED,
+    FIELD_IDCARD,
+    FIELD_NAME,
+    FIELD_LOCKED_UNTIL,
+    FIELD_COUNT
+};
+
+static const char* FIELD_SUFFIX[FIELD_COUNT] = {
+    "_password", "_balance", "_daily_withdrawal", "_locked", "_idcard", "_name", "_locked_until"
+};
+
+// 解码后按键的字典序写回各字段，配合emplace_hint顺序插入
+static const int FIELD_KEY_ORDER[FIELD_COUNT] = {
+    FIELD_BALANCE, FIELD_DAILY_WITHDRAWAL, FIELD_IDCARD, FIELD_LOCKED, FIELD_LOCKED_UNTIL, FIELD_NAME, FIELD_PASSWORD
+};
+
+struct AccountRow {
+    uint64_t account;
+    unsigned char mask;
+    const std::string* values[FIELD_COUNT];
+};
+
+// ---------------- 编码工具 ----------------
+
+static void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static void putString(std::string& out, const std::string& value) {
+    putVarint(out, value.size());
+    out += value;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+struct SnapshotReader {
+    const std::string& bytes;
+    size_t pos;
+    bool ok;
+
+    SnapshotReader(const std::string& bytes, size_t pos) : bytes(bytes), pos(pos), ok(true) {}
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= bytes.size()) break;
+            unsigned char c = bytes[pos++];
+            value |= (uint64_t)(c & 0x7f) << shift;
+            if (!(c & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    unsigned char byte() {
+        if (pos >= bytes.size()) {
+            ok = false;
+            return 0;
+        }
+        return bytes[pos++];
+    }
+
+    std::string string() {
+        uint64_t length = varint();
+        if (!ok || length > bytes.size() - pos) {
+            ok = false;
+            return "";
+        }
+        std::string value = bytes.substr(pos, length);
+        pos += length;
+        return value;
+    }
+};
+
+static bool isDigits(const std::string& value, size_t begin, size_t end) {
+    if (begin >= end || end > value.size()) return false;
+    for (size_t i = begin; i < end; i++) {
+        if (value[i] < '0' || value[i] > '9') return false;
+    }
+    return true;
+}
+
+static std::string formatAccount(uint64_t account) {
+    char buffer[24];
+    std::snprintf(buffer, sizeof(buffer), "%019llu", (unsigned long long)account);
+    return buffer;
+}
+
+// 金额编码：以分为单位，最低位区分两种文本格式：
+//   0: std::to_string(double) 的 "123.450000"（小数点后只有前两位可以非零）
+//   1: 整数 "5000"
+// 直接按文本解析，保证解码后逐字节一致
+static bool encodeAmount(const std::string& value, uint64_t& encoded) {
+    size_t i = 0;
+    bool negative = !value.empty() && value[0] == '-';
+    if (negative) i++;
+
+    size_t digitsBegin = i;
+    int64_t whole = 0;
+    while (i < value.size() && value[i] >= '0' && value[i] <= '9') {
+        if (i - digitsBegin >= 15) return false;
+        whole = whole * 10 + (value[i++] - '0');
+    }
+    size_t digits = i - digitsBegin;
+    if (digits == 0 || (digits > 1 && value[digitsBegin] == '0')) return false;
+
+    int64_t cents = whole * 100;
+    uint64_t format = 1;
+    if (i < value.size()) {
+        if (value.size() - i != 7 || value[i] != '.' || value.compare(i + 3, 4, "0000") != 0 ||
+            !isDigits(value, i + 1, i + 3)) {
+            return false;
+        }
+        cents += (value[i + 1] - '0') * 10 + (value[i + 2] - '0');
+        format = 0;
+    }
+    if (negative && cents == 0) return false;
+
+    encoded = (zigzag(negative ? -cents : cents) << 1) | format;
+    return true;
+}
+
+static std::string decodeAmount(uint64_t encoded) {
+    int64_t cents = unzigzag(encoded >> 1);
+    uint64_t magnitude = cents < 0 ? -(uint64_t)cents : (uint64_t)cents;
+    char buffer[40];
+    if (encoded & 1) {
+        std::snprintf(buffer, sizeof(buffer), "%s%llu", cents < 0 ? "-" : "",
+            (unsigned long long)(magnitude / 100));
+    }
+    else {
+        std::snprintf(buffer, sizeof(buffer), "%s%llu.%02llu0000", cents < 0 ? "-" : "",
+            (unsigned long long)(magnitude / 100), (unsigned long long)(magnitude % 100));
+    }
+    return buffer;
+}
+
+// 判断字段值能否无损编码进对应列
+static bool fitsColumn(int field, const std::string& value) {
+    uint64_t unused;
+    switch (field) {
+    case FIELD_PASSWORD:
+        return value.size() == 6 && isDigits(value, 0, 6);
+    case FIELD_BALANCE:
+    case FIELD_DAILY_WITHDRAWAL:
+        return encodeAmount(value, unused);
+    case FIELD_LOCKED:
+        return value == "true" || value == "false";
+    case FIELD_IDCARD:
+        return value.size() == 18 && isDigits(value, 0, 17) &&
+            (isDigits(value, 17, 18) || value[17] == 'X' || value[17] == 'x');
+    case FIELD_NAME:
+        return true;
+    case FIELD_LOCKED_UNTIL:
+        return isDigits(value, 0, value.size()) && value.size() <= 19 &&
+            std::to_string(std::strtoull(value.c_str(), nullptr, 10)) == value;
+    }
+    return false;
+}
+
+// ---------------- 编码 ----------------
+
+std::string encodeColumnarSnapshot(const std::map<std::string, std::string>& data, bool compress) {
+    // 同一账户的键在有序map中是连续的，按顺序追加即可得到按账号排序的行
+    std::vector<AccountRow> rows;
+    std::vector<const std::pair<const std::string, std::string>*> extras;
+
+    for (const auto& pair : data) {
+        const std::string& key = pair.first;
+        int field = -1;
+        if (key.size() > 20 && key[19] == '_' && isDigits(key, 0, 19)) {
+            for (int f = 0; f < FIELD_COUNT; f++) {
+                if (key.compare(19, std::string::npos, FIELD_SUFFIX[f]) == 0) {
+                    field = f;
+                    break;
+                }
+            }
+        }
+        if (field < 0 || !fitsColumn(field, pair.second)) {
+            extras.push_back(&pair);
+            continue;
+        }
+        uint64_t account = std::strtoull(key.c_str(), nullptr, 10);
+        if (rows.empty() || rows.back().account != account) {
+            rows.push_back(AccountRow{ account, 0, {} });
+        }
+        rows.back().mask |= 1 << field;
+        rows.back().values[field] = &pair.second;
+    }
+
+    std::string body;
+    putVarint(body, rows.size());
+
+    uint64_t previous = 0;
+    for (const auto& row : rows) {
+        putVarint(body, row.account - previous);
+        previous = row.account;
+    }
+    for (const auto& row : rows) {
+        body.push_back((char)row.mask);
+    }
+
+    // 锁定标志按位打包
+    unsigned char bits = 0;
+    int bitCount = 0;
+    for (const auto& row : rows) {
+        if (!(row.mask & (1 << FIELD_LOCKED))) continue;
+        if (*row.values[FIELD_LOCKED] == "true") bits |= 1 << bitCount;
+        if (++bitCount == 8) {
+            body.push_back((char)bits);
+            bits = 0;
+            bitCount = 0;
+        }
+    }
+    if (bitCount > 0) body.push_back((char)bits);
+
+    for (int field : { FIELD_BALANCE, FIELD_DAILY_WITHDRAWAL }) {
+        for (const auto& row : rows) {
+            uint64_t encoded;
+            if ((row.mask & (1 << field)) && encodeAmount(*row.values[field], encoded)) {
+                putVarint(body, encoded);
+            }
+        }
+    }
+    for (const auto& row : rows) {
+        if (row.mask & (1 << FIELD_PASSWORD)) {
+            putVarint(body, std::strtoull(row.values[FIELD_PASSWORD]->c_str(), nullptr, 10));
+        }
+    }
+    for (const auto& row : rows) {
+        if (row.mask & (1 << FIELD_IDCARD)) {
+            const std::string& idCard = *row.values[FIELD_IDCARD];
+            putVarint(body, std::strtoull(idCard.substr(0, 17).c_str(), nullptr, 10));
+            body.push_back(idCard[17]);
+        }
+    }
+    for (const auto& row : rows) {
+        if (row.mask & (1 << FIELD_LOCKED_UNTIL)) {
+            putVarint(body, std::strtoull(row.values[FIELD_LOCKED_UNTIL]->c_str(), nullptr, 10));
+        }
+    }
+
+    // 姓名字典：按首次出现顺序编号
+    std::unordered_map<std::string_view, uint64_t> dictionary;
+    std::vector<const std::string*> names;
+    std::string nameIndexes;
+    for (const auto& row : rows) {
+        if (!(row.mask & (1 << FIELD_NAME))) continue;
+        const std::string& name = *row.values[FIELD_NAME];
+        auto inserted = dictionary.emplace(name, names.size());
+        if (inserted.second) names.push_back(&name);
+        putVarint(nameIndexes, inserted.first->second);
+    }
+    putVarint(body, names.size());
+    for (const std::string* name : names) {
+        putString(body, *name);
+    }
+    body += nameIndexes;
+
+    putVarint(body, extras.size());
+    for (const auto* pair : extras) {
+        putString(body, pair->first);
+        putString(body, pair->second);
+    }
+
+    unsigned char flags = 0;
+    std::string payload = body;
+#ifdef ATM_HAVE_ZLIB
+    if (compress) {
+        uLongf length = compressBound(body.size());
+        std::string compressed(length, '\0');
+        if (compress2((Bytef*)&compressed[0], &length, (const Bytef*)body.data(), body.size(), Z_BEST_SPEED) == Z_OK &&
+            length < body.size()) {
+            compressed.resize(length);
+            payload.swap(compressed);
+            flags |= FLAG_ZLIB;
+        }
+    }
+#else
+    (void)compress;
+#endif
+
+    std::string out(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    out.push_back((char)SNAPSHOT_VERSION);
+    out.push_back((char)flags);
+    putVarint(out, body.size());
+    out += payload;
+    return out;
+}
+
+// ---------------- 解码 ----------------
+
+bool decodeColumnarSnapshot(const std::string& bytes, std::map<std::string, std::string>& data) {
+    if (bytes.size() < 6 || bytes.compare(0, 4, SNAPSHOT_MAGIC, 4) != 0 ||
+        (unsigned char)bytes[4] != SNAPSHOT_VERSION) {
+        return false;
+    }
+    unsigned char flags = bytes[5];
+    SnapshotReader header(bytes, 6);
+    uint64_t rawLength = header.varint();
+    if (!header.ok) return false;
+
+    std::string body;
+    if (flags & FLAG_ZLIB) {
+#ifdef ATM_HAVE_ZLIB
+        body.resize(rawLength);
+        uLongf length = rawLength;
+        if (uncompress((Bytef*)&body[0], &length, (const Bytef*)bytes.data() + header.pos,
+            bytes.size() - header.pos) != Z_OK || length != rawLength) {
+            return false;
+        }
+#else
+        return false;
+#endif
+    }
+    else {
+        body = bytes.substr(header.pos);
+    }
+
+    SnapshotReader in(body, 0);
+    uint64_t count = in.varint();
+    if (!in.ok || count > body.size()) return false;
+
+    // 先把各列解码到按账户排列的数组，再按键的字典序整体写回
+    std::vector<uint64_t> accounts(count);
+    std::vector<unsigned char> masks(count);
+    std::vector<std::string> columns[FIELD_COUNT];
+    for (auto& column : columns) {
+        column.resize(count);
+    }
+
+    uint64_t account = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        account += in.varint();
+        accounts[i] = account;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        masks[i] = in.byte();
+    }
+    if (!in.ok) return false;
+
+    int bitCount = 8;
+    unsigned char bits = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        if (!(masks[i] & (1 << FIELD_LOCKED))) continue;
+        if (bitCount == 8) {
+            bits = in.byte();
+            bitCount = 0;
+        }
+        columns[FIELD_LOCKED][i] = (bits >> bitCount++) & 1 ? "true" : "false";
+    }
+    for (int field : { FIELD_BALANCE, FIELD_DAILY_WITHDRAWAL }) {
+        for (uint64_t i = 0; i < count; i++) {
+            if (masks[i] & (1 << field)) columns[field][i] = decodeAmount(in.varint());
+        }
+    }
+    char buffer[32];
+    for (uint64_t i = 0; i < count; i++) {
+        if (!(masks[i] & (1 << FIELD_PASSWORD))) continue;
+        std::snprintf(buffer, sizeof(buffer), "%06llu", (unsigned long long)in.varint());
+        columns[FIELD_PASSWORD][i] = buffer;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!(masks[i] & (1 << FIELD_IDCARD))) continue;
+        int length = std::snprintf(buffer, sizeof(buffer), "%017llu", (unsigned long long)in.varint());
+        buffer[length] = (char)in.byte();
+        columns[FIELD_IDCARD][i].assign(buffer, length + 1);
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (masks[i] & (1 << FIELD_LOCKED_UNTIL)) columns[FIELD_LOCKED_UNTIL][i] = std::to_string(in.varint());
+    }
+
+    uint64_t nameCount = in.varint();
+    if (!in.ok || nameCount > body.size()) return false;
+    std::vector<std::string> names(nameCount);
+    for (uint64_t i = 0; i < nameCount; i++) {
+        names[i] = in.string();
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        if (!(masks[i] & (1 << FIELD_NAME))) continue;
+        uint64_t index = in.varint();
+        if (index >= nameCount) return false;
+        columns[FIELD_NAME][i] = names[index];
+    }
+    if (!in.ok) return false;
+
+    data.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        std::string prefix = formatAccount(accounts[i]);
+        for (int field : FIELD_KEY_ORDER) {
+            if (masks[i] & (1 << field)) {
+                data.emplace_hint(data.end(), prefix + FIELD_SUFFIX[field], std::move(columns[field][i]));
+            }
+        }
+    }
+
+    uint64_t extraCount = in.varint();
+    for (uint64_t i = 0; i < extraCount && in.ok; i++) {
+        std::string key = in.string();
+        data[key] = in.string();
+    }
+    return in.ok;
+}
+
+bool saveColumnarSnapshot(const std::map<std::string, std::string>& data, const std::string& filename, bool compress) {
+    std::string tmp = filename + ".tmp";
+    std::ofstream file(tmp, std::ios::binary);
+    if (!file.is_open()) return false;
+    file << encodeColumnarSnapshot(data, compress);
+    file.close();
+    if (!file.good()) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return replaceFileDurably(tmp, filename);
+}
+
+bool loadColumnarSnapshot(const std::string& filename, std::map<std::string, std::string>& data) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return decodeColumnarSnapshot(buffer.str(), data);
+}
+
+bool isColumnarSnapshotFile(const std::string& filename) {
+    const std::string suffix = ".snap";
+    return filename.size() > suffix.size() &&
+        filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool columnarCompressionAvailable() {
+#ifdef ATM_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
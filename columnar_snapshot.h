@@ -0,0 +1,25 @@
+#ifndef COLUMNAR_SNAPSHOT_H
+#define COLUMNAR_SNAPSHOT_H
+
+#include <string>
+#include <map>
+
+// 列式账户快照。按账号排序后逐列编码：
+//   账号        与前一个账号的差值，varint
+//   字段掩码    每个账户1字节，标记哪些标准字段存在
+//   锁定标志    按位打包
+//   余额/当日取款  以分为单位的定点数，zigzag varint（最低位记录原文本格式）
+//   密码/身份证号  转成整数后varint
+//   姓名        字典编码：去重后的姓名表 + 每个账户的字典下标
+//   其他键值    无法按上述方式无损编码的条目原样保存
+// 可选用zlib对整个数据块压缩（编译时找到zlib才可用）。
+std::string encodeColumnarSnapshot(const std::map<std::string, std::string>& data, bool compress);
+bool decodeColumnarSnapshot(const std::string& bytes, std::map<std::string, std::string>& data);
+
+bool saveColumnarSnapshot(const std::map<std::string, std::string>& data, const std::string& filename, bool compress);
+bool loadColumnarSnapshot(const std::string& filename, std::map<std::string, std::string>& data);
+
+bool isColumnarSnapshotFile(const std::string& filename);
+bool columnarCompressionAvailable();
+
+#endif
@@ -0,0 +1,25 @@
+#include "durable_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+bool replaceFileDurably(const std::string& tmp, const std::string& path) {
+    int fd = ::open(tmp.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return syncParentDirectory(path);
+}
+
+bool syncParentDirectory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
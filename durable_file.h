@@ -0,0 +1,12 @@
+#ifndef DURABLE_FILE_H
+#define DURABLE_FILE_H
+
+#include <string>
+
+// 把已写完的临时文件替换为目标文件：fsync临时文件，rename，再fsync所在目录。
+// 返回true后即使掉电，目标也是完整的新内容；失败时删除临时文件，目标保持原样
+bool replaceFileDurably(const std::string& tmp, const std::string& path);
+// fsync文件所在的目录，使其中的rename、创建和删除落盘
+bool syncParentDirectory(const std::string& path);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef FAULT_INJECTION_H
+#define FAULT_INJECTION_H
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+// 故障注入：环境变量 ATM_FAULT 等于某个注入点名称时，进程在该点直接崩溃退出，
+// 用于在本机验证两阶段提交的崩溃恢复。
+inline void faultPoint(const char* name) {
+    const char* fault = std::getenv("ATM_FAULT");
+    if (fault && std::strcmp(fault, name) == 0) {
+        std::fprintf(stderr, "ATM_FAULT: crash at %s\n", name);
+        std::_Exit(86);
+    }
+}
+
+#endif
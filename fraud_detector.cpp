@@ -0,0 +1,265 @@
+#include "fraud_detector.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+int64_t fraudNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* fraudRuleName(FraudRule rule) {
+    switch (rule) {
+    case RULE_MAX_WITHDRAWALS: return "max_withdrawals";
+    case RULE_TRANSFER_FAN_OUT: return "transfer_fan_out";
+    case RULE_LOGIN_FAILURES: return "login_failures";
+    }
+    return "unknown";
+}
+
+std::string formatFraudAlert(const FraudAlert& alert) {
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%" PRId64 " %s account=%019" PRIu64 " count=%d",
+        alert.timeUs, fraudRuleName(alert.rule), alert.account, alert.count);
+    return buffer;
+}
+
+std::string formatTransactionEvent(const TransactionEvent& event) {
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "%" PRId64 " %u %019" PRIu64 " %019" PRIu64 " %" PRId64,
+        event.timeUs, event.kind, event.account, event.target, event.amountCents);
+    return buffer;
+}
+
+bool parseTransactionEvent(const std::string& line, TransactionEvent& event) {
+    std::memset(&event, 0, sizeof(event));
+    return std::sscanf(line.c_str(), "%" SCNd64 " %u %" SCNu64 " %" SCNu64 " %" SCNd64,
+        &event.timeUs, &event.kind, &event.account, &event.target, &event.amountCents) == 5;
+}
+
+FraudDetector::FraudDetector(const FraudRules& rules, size_t memoryBudgetBytes) :
+    rules(rules),
+    evicted(0),
+    loginHead(0),
+    loginAlertedAt(0) {
+    size_t count = 16;
+    while (count * 2 * sizeof(AccountWindow) <= memoryBudgetBytes) {
+        count *= 2;
+    }
+    slots.assign(count, AccountWindow());
+    mask = count - 1;
+    idleSeconds = (uint32_t)std::max(rules.maxWithdrawalWindowSeconds, rules.fanOutWindowSeconds);
+    std::memset(loginFailures, 0, sizeof(loginFailures));
+}
+
+// 账户号不会为0，0留给空槽；空槽一旦被占用就不再变回空槽，因此遇到空槽即可停止探测
+FraudDetector::AccountWindow& FraudDetector::windowFor(uint64_t account, uint32_t now) {
+    uint64_t hash = (account * 0x9E3779B97F4A7C15ULL) >> 17;
+    AccountWindow* victim = nullptr;
+    for (int i = 0; i < PROBE_LIMIT; i++) {
+        AccountWindow& slot = slots[(hash + i) & mask];
+        if (slot.account == account) return slot;
+        if (slot.account == 0) {
+            victim = &slot;
+            break;
+        }
+        if (!victim || slot.lastSeen < victim->lastSeen) {
+            victim = &slot;
+        }
+    }
+    if (victim->account != 0 && victim->lastSeen + idleSeconds >= now) {
+        evicted++;
+    }
+    std::memset(victim, 0, sizeof(AccountWindow));
+    victim->account = account;
+    return *victim;
+}
+
+bool FraudDetector::shouldAlert(uint32_t& alertedAt, uint32_t now, int windowSeconds) {
+    if (alertedAt != 0 && now < alertedAt + (uint32_t)windowSeconds) return false;
+    alertedAt = now;
+    return true;
+}
+
+// 在固定大小的时间数组里：替换最早的一项，返回窗口内的项数
+static int recordInWindow(uint32_t* times, int size, int index, uint32_t now, int windowSeconds) {
+    times[index] = now;
+    int count = 0;
+    for (int i = 0; i < size; i++) {
+        if (times[i] != 0 && times[i] + (uint32_t)windowSeconds > now) count++;
+    }
+    return count;
+}
+
+static int oldestIndex(const uint32_t* times, int size) {
+    int oldest = 0;
+    for (int i = 1; i < size; i++) {
+        if (times[i] < times[oldest]) oldest = i;
+    }
+    return oldest;
+}
+
+void FraudDetector::process(const TransactionEvent& event, std::vector<FraudAlert>& alerts) {
+    uint32_t now = (uint32_t)(event.timeUs / 1000000);
+
+    if (event.kind == EVENT_LOGIN_FAILURE) {
+        loginFailures[loginHead] = LoginFailure{ event.account, now };
+        loginHead = (loginHead + 1) % LOGIN_TRACKED;
+
+        uint64_t distinct[LOGIN_TRACKED];
+        int count = 0;
+        for (const auto& failure : loginFailures) {
+            if (failure.time == 0 || failure.time + (uint32_t)rules.loginFailureWindowSeconds <= now) continue;
+            if (std::find(distinct, distinct + count, failure.account) == distinct + count) {
+                distinct[count++] = failure.account;
+            }
+        }
+        if (count >= std::min(rules.loginFailureAccounts, LOGIN_TRACKED) &&
+            shouldAlert(loginAlertedAt, now, rules.loginFailureWindowSeconds)) {
+            alerts.push_back(FraudAlert{ RULE_LOGIN_FAILURES, event.account, count, event.timeUs });
+        }
+        return;
+    }
+
+    AccountWindow& window = windowFor(event.account, now);
+    window.lastSeen = now;
+
+    if (event.kind == EVENT_WITHDRAW && event.amountCents >= maxWithdrawalFor(event.account)) {
+        int count = recordInWindow(window.withdrawalTimes, TRACKED, oldestIndex(window.withdrawalTimes, TRACKED),
+            now, rules.maxWithdrawalWindowSeconds);
+        if (count >= std::min(rules.maxWithdrawalCount, TRACKED) &&
+            shouldAlert(window.alertedAt[RULE_MAX_WITHDRAWALS], now, rules.maxWithdrawalWindowSeconds)) {
+            alerts.push_back(FraudAlert{ RULE_MAX_WITHDRAWALS, event.account, count, event.timeUs });
+        }
+    }
+    else if (event.kind == EVENT_TRANSFER) {
+        // 同一对象只占一个位置，只更新时间；否则替换最久的对象
+        uint32_t target = (uint32_t)(event.target ^ (event.target >> 32)) | 1;
+        int index = std::find(window.targetHashes, window.targetHashes + TRACKED, target) - window.targetHashes;
+        if (index == TRACKED) {
+            index = oldestIndex(window.targetTimes, TRACKED);
+            window.targetHashes[index] = target;
+        }
+        int count = recordInWindow(window.targetTimes, TRACKED, index, now, rules.fanOutWindowSeconds);
+        if (count >= std::min(rules.fanOutTargets, TRACKED) &&
+            shouldAlert(window.alertedAt[RULE_TRANSFER_FAN_OUT], now, rules.fanOutWindowSeconds)) {
+            alerts.push_back(FraudAlert{ RULE_TRANSFER_FAN_OUT, event.account, count, event.timeUs });
+        }
+    }
+}
+
+FraudMonitor::FraudMonitor(const FraudRules& rules, const LimitRules& limits, const std::string& alertFile,
+    const std::string& recordFile) :
+    detector(rules),
+    limits(limits),
+    alertFile(alertFile),
+    recordFile(recordFile),
+    alertOut(nullptr),
+    recordOut(nullptr),
+    running(false),
+    published(0),
+    dropped(0),
+    processed(0),
+    alertsRaised(0),
+    stateEvictions(0),
+    maxLatencyUs(0) {
+    detector.setLimits(limits.table());
+}
+
+FraudMonitor::~FraudMonitor() {
+    stop();
+}
+
+bool FraudMonitor::start() {
+    alertOut = std::fopen(alertFile.c_str(), "a");
+    if (!alertOut) return false;
+    if (!recordFile.empty()) {
+        recordOut = std::fopen(recordFile.c_str(), "a");
+        if (!recordOut) {
+            std::fclose(alertOut);
+            alertOut = nullptr;
+            return false;
+        }
+    }
+    running = true;
+    worker = std::thread(&FraudMonitor::run, this);
+    return true;
+}
+
+void FraudMonitor::stop() {
+    if (!running.exchange(false)) return;
+    if (worker.joinable()) worker.join();
+    if (alertOut) std::fclose(alertOut);
+    if (recordOut) std::fclose(recordOut);
+    alertOut = nullptr;
+    recordOut = nullptr;
+}
+
+// 计数只有生产者写，用普通的load/store代替带锁的原子加
+void FraudMonitor::publish(const TransactionEvent& event) {
+    published.store(published.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (!ring.tryPush(event)) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+void FraudMonitor::publish(uint32_t kind, const std::string& account, const std::string& target, double amount) {
+    TransactionEvent event;
+    event.kind = kind;
+    event.reserved = 0;
+    event.account = std::strtoull(account.c_str(), nullptr, 10);
+    event.target = target.empty() ? 0 : std::strtoull(target.c_str(), nullptr, 10);
+    event.amountCents = (int64_t)(amount * 100 + (amount < 0 ? -0.5 : 0.5));
+    event.timeUs = fraudNowUs();
+    publish(event);
+}
+
+void FraudMonitor::drain(std::vector<FraudAlert>& alerts) {
+    TransactionEvent event;
+    while (ring.tryPop(event)) {
+        processed.store(processed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (recordOut) {
+            std::fprintf(recordOut, "%s\n", formatTransactionEvent(event).c_str());
+        }
+        alerts.clear();
+        detector.process(event, alerts);
+        for (const auto& alert : alerts) {
+            int64_t latency = fraudNowUs() - event.timeUs;
+            if (latency > maxLatencyUs.load(std::memory_order_relaxed)) {
+                maxLatencyUs.store(latency, std::memory_order_relaxed);
+            }
+            std::fprintf(alertOut, "%s latency_us=%" PRId64 "\n", formatFraudAlert(alert).c_str(), latency);
+            std::fflush(alertOut);
+            alertsRaised.store(alertsRaised.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+    stateEvictions.store(detector.evictions(), std::memory_order_relaxed);
+}
+
+// 队列空时休眠200微秒，告警延迟保持在毫秒以内，又不占满一个核
+void FraudMonitor::run() {
+    std::vector<FraudAlert> alerts;
+    while (running) {
+        if (limits.refresh()) detector.setLimits(limits.table());
+        drain(alerts);
+        if (recordOut) std::fflush(recordOut);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    drain(alerts);
+    if (recordOut) std::fflush(recordOut);
+}
+
+std::string FraudMonitor::metricsText() const {
+    std::ostringstream out;
+    out << "fraud_events_published " << published.load() << "\n"
+        << "fraud_events_dropped " << dropped.load() << "\n"
+        << "fraud_events_processed " << processed.load() << "\n"
+        << "fraud_alerts " << alertsRaised.load() << "\n"
+        << "fraud_alert_latency_max_us " << maxLatencyUs.load() << "\n"
+        << "fraud_state_bytes " << detector.memoryBytes() << "\n"
+        << "fraud_state_evictions " << stateEvictions.load() << "\n";
+    return out.str();
+}
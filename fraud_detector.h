@@ -0,0 +1,154 @@
+#ifndef FRAUD_DETECTOR_H
+#define FRAUD_DETECTOR_H
+
+#include "spsc_ring.h"
+#include "limit_rules.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+enum TransactionEventKind : uint32_t {
+    EVENT_WITHDRAW = 1,
+    EVENT_TRANSFER = 2,
+    EVENT_LOGIN_FAILURE = 3
+};
+
+// 处理线程发布的交易事件，定长40字节
+struct TransactionEvent {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t account;
+    uint64_t target;        // 转账对方账号，其他事件为0
+    int64_t amountCents;
+    int64_t timeUs;         // 系统时钟，微秒
+};
+
+enum FraudRule {
+    RULE_MAX_WITHDRAWALS = 0,   // 同一账户短时间内多次最大额（达到所属层级的单笔取款限额）取款
+    RULE_TRANSFER_FAN_OUT = 1,  // 同一账户短时间内转给多个不同账户
+    RULE_LOGIN_FAILURES = 2     // 短时间内多个不同账户登录失败
+};
+
+// 每条规则的计数上限受内部窗口大小限制（取款/转账8，登录失败64）
+struct FraudRules {
+    int64_t maxWithdrawalCents = 0;     // 大于0时对所有账户使用这个固定阈值，0为按账户层级的单笔取款限额
+    int maxWithdrawalCount = 3;
+    int maxWithdrawalWindowSeconds = 600;
+    int fanOutTargets = 5;
+    int fanOutWindowSeconds = 600;
+    int loginFailureAccounts = 5;
+    int loginFailureWindowSeconds = 60;
+};
+
+struct FraudAlert {
+    FraudRule rule;
+    uint64_t account;       // 登录失败规则为最近一次失败的账户
+    int count;
+    int64_t timeUs;         // 触发告警的事件时间
+};
+
+const char* fraudRuleName(FraudRule rule);
+std::string formatFraudAlert(const FraudAlert& alert);
+// 事件记录文件每行一个事件：<时间us> <类型> <账号> <对方账号> <金额分>
+std::string formatTransactionEvent(const TransactionEvent& event);
+bool parseTransactionEvent(const std::string& line, TransactionEvent& event);
+int64_t fraudNowUs();
+
+// 滑动窗口规则评估。单线程同步调用，在线监控与离线重放共用。
+// 每个账户的窗口状态是固定大小的槽位（最近8次最大额取款时间、最近8个转账对象），
+// 存在开放寻址表中；探测范围内没有空位时替换最久未活动的账户，内存不超过构造时的预算。
+// 同一账户同一规则告警后，在该规则的窗口期内不再重复告警。
+class FraudDetector {
+public:
+    FraudDetector(const FraudRules& rules, size_t memoryBudgetBytes = 4 << 20);
+
+    // 按层级取最大额取款阈值用的限额表，默认为内置限额
+    void setLimits(const LimitTable& table) { limits = table; }
+
+    // 本事件触发的告警追加到alerts
+    void process(const TransactionEvent& event, std::vector<FraudAlert>& alerts);
+
+    size_t memoryBytes() const { return slots.size() * sizeof(AccountWindow); }
+    uint64_t evictions() const { return evicted; }
+
+private:
+    static const int TRACKED = 8;
+    static const int PROBE_LIMIT = 8;
+    static const int LOGIN_TRACKED = 64;
+
+    struct AccountWindow {
+        uint64_t account;
+        uint32_t lastSeen;
+        uint32_t alertedAt[2];
+        uint32_t withdrawalTimes[TRACKED];
+        uint32_t targetHashes[TRACKED];
+        uint32_t targetTimes[TRACKED];
+    };
+
+    struct LoginFailure {
+        uint64_t account;
+        uint32_t time;
+    };
+
+    AccountWindow& windowFor(uint64_t account, uint32_t now);
+    bool shouldAlert(uint32_t& alertedAt, uint32_t now, int windowSeconds);
+    int64_t maxWithdrawalFor(uint64_t account) const {
+        return rules.maxWithdrawalCents > 0 ? rules.maxWithdrawalCents : limits.rowFor(account).withdrawSingle;
+    }
+
+    FraudRules rules;
+    LimitTable limits;
+    std::vector<AccountWindow> slots;
+    size_t mask;
+    uint32_t idleSeconds;
+    uint64_t evicted;
+
+    LoginFailure loginFailures[LOGIN_TRACKED];
+    size_t loginHead;
+    uint32_t loginAlertedAt;
+};
+
+// 在线监控：处理线程把事件写入无锁环形队列，检测线程消费并评估规则，
+// 告警逐行写入告警文件；可选把消费到的事件记录下来，供 atm_fraud replay 离线调参。
+// publish() 只有单个生产者（界面线程），队列满时丢弃事件并计数，从不阻塞。
+// 限额规则复制一份归检测线程所有，由它自己热加载，与终端的那份互不干扰。
+class FraudMonitor {
+public:
+    FraudMonitor(const FraudRules& rules, const LimitRules& limits, const std::string& alertFile,
+        const std::string& recordFile = "");
+    ~FraudMonitor();
+
+    bool start();
+    void stop();
+
+    void publish(const TransactionEvent& event);
+    void publish(uint32_t kind, const std::string& account, const std::string& target, double amount);
+
+    std::string metricsText() const;
+
+private:
+    void run();
+    void drain(std::vector<FraudAlert>& alerts);
+
+    FraudDetector detector;
+    LimitRules limits;
+    SpscRing<TransactionEvent, 4096> ring;
+    std::string alertFile;
+    std::string recordFile;
+    FILE* alertOut;
+    FILE* recordOut;
+    std::atomic<bool> running;
+    std::thread worker;
+
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> processed;
+    std::atomic<uint64_t> alertsRaised;
+    std::atomic<uint64_t> stateEvictions;
+    std::atomic<int64_t> maxLatencyUs;
+};
+
+#endif
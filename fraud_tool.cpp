@@ -0,0 +1,217 @@
+#include "fraud_detector.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 规则参数：命令行中出现的覆盖默认值，返回false表示参数无法识别
+static bool parseRuleFlag(const std::string& flag, const char* value, FraudRules& rules) {
+    if (flag == "--max-withdrawal-amount") rules.maxWithdrawalCents = (int64_t)(std::stod(value) * 100);
+    else if (flag == "--max-withdrawals") rules.maxWithdrawalCount = std::stoi(value);
+    else if (flag == "--withdraw-window") rules.maxWithdrawalWindowSeconds = std::stoi(value);
+    else if (flag == "--fan-out") rules.fanOutTargets = std::stoi(value);
+    else if (flag == "--fan-out-window") rules.fanOutWindowSeconds = std::stoi(value);
+    else if (flag == "--login-accounts") rules.loginFailureAccounts = std::stoi(value);
+    else if (flag == "--login-window") rules.loginFailureWindowSeconds = std::stoi(value);
+    else return false;
+    return true;
+}
+
+// limitsFile非空时最大额取款按其中各层级的单笔取款限额判断，否则按内置限额
+static int runReplay(const std::string& file, const FraudRules& rules, const std::string& limitsFile, bool quiet) {
+    std::ifstream in(file);
+    if (!in.is_open()) {
+        std::cerr << "无法读取: " << file << std::endl;
+        return 1;
+    }
+
+    FraudDetector detector(rules);
+    if (!limitsFile.empty()) {
+        LimitRules limits(limitsFile);
+        if (!limits.load()) {
+            std::cerr << limits.lastError() << std::endl;
+            return 1;
+        }
+        detector.setLimits(limits.table());
+    }
+    std::vector<FraudAlert> alerts;
+    uint64_t events = 0, malformed = 0;
+    uint64_t perRule[3] = { 0, 0, 0 };
+    auto start = std::chrono::steady_clock::now();
+    std::string line;
+    TransactionEvent event;
+    while (std::getline(in, line)) {
+        if (!parseTransactionEvent(line, event)) {
+            malformed++;
+            continue;
+        }
+        events++;
+        alerts.clear();
+        detector.process(event, alerts);
+        for (const auto& alert : alerts) {
+            perRule[alert.rule]++;
+            if (!quiet) std::cout << formatFraudAlert(alert) << "\n";
+        }
+    }
+    double seconds = elapsedSeconds(start);
+
+    std::printf("events: %llu  malformed: %llu  %.0f events/s\n", (unsigned long long)events,
+        (unsigned long long)malformed, events / (seconds > 0 ? seconds : 1e-9));
+    for (int rule = 0; rule < 3; rule++) {
+        std::printf("  %-18s %llu\n", fraudRuleName((FraudRule)rule), (unsigned long long)perRule[rule]);
+    }
+    std::printf("state: %zu bytes, %llu evictions\n", detector.memoryBytes(), (unsigned long long)detector.evictions());
+    return 0;
+}
+
+// 生成随机交易流，混入三类可疑模式，用于调试规则
+static int runSynthesize(const std::string& file, uint64_t count) {
+    std::ofstream out(file);
+    if (!out.is_open()) return 1;
+    std::mt19937_64 rng(20240601);
+    int64_t timeUs = 1700000000LL * 1000000;
+    TransactionEvent event;
+    std::memset(&event, 0, sizeof(event));
+    for (uint64_t i = 0; i < count; i++) {
+        timeUs += rng() % 200000;
+        event.timeUs = timeUs;
+        event.account = 6222000000000000000ULL + rng() % 100000;
+        event.target = 0;
+        uint64_t pattern = rng() % 1000;
+        if (pattern == 0) {
+            // 同一账户连续最大额取款
+            for (int k = 0; k < 4; k++) {
+                event.kind = EVENT_WITHDRAW;
+                event.amountCents = 200000;
+                event.timeUs = (timeUs += 30000000);
+                out << formatTransactionEvent(event) << "\n";
+            }
+            continue;
+        }
+        if (pattern == 1) {
+            // 一个账户短时间内转给多个账户
+            for (int k = 0; k < 6; k++) {
+                event.kind = EVENT_TRANSFER;
+                event.target = 6222000000000000000ULL + rng() % 100000;
+                event.amountCents = 100 * (rng() % 5000 + 1);
+                event.timeUs = (timeUs += 20000000);
+                out << formatTransactionEvent(event) << "\n";
+            }
+            continue;
+        }
+        if (pattern == 2) {
+            // 同一终端逐个账户试密码
+            for (int k = 0; k < 6; k++) {
+                event.kind = EVENT_LOGIN_FAILURE;
+                event.account = 6222000000000000000ULL + rng() % 100000;
+                event.amountCents = 0;
+                event.timeUs = (timeUs += 2000000);
+                out << formatTransactionEvent(event) << "\n";
+            }
+            continue;
+        }
+        uint64_t kind = rng() % 1000;
+        event.kind = kind < 600 ? EVENT_WITHDRAW : (kind < 995 ? EVENT_TRANSFER : EVENT_LOGIN_FAILURE);
+        event.amountCents = event.kind == EVENT_LOGIN_FAILURE ? 0 : 10000 * (int64_t)(rng() % 20 + 1);
+        if (event.kind == EVENT_TRANSFER) event.target = 6222000000000000000ULL + rng() % 100000;
+        out << formatTransactionEvent(event) << "\n";
+    }
+    return 0;
+}
+
+// publish()是处理线程上唯一新增的开销，单独测量；同时给出检测线程的吞吐和告警延迟
+static int runBench(uint64_t count) {
+    FraudRules rules;
+    const char* alertFile = "bench_fraud_alerts.log";
+    std::vector<TransactionEvent> events(1 << 16);
+    std::mt19937_64 rng(7);
+    for (auto& event : events) {
+        std::memset(&event, 0, sizeof(event));
+        event.kind = rng() % 2 ? EVENT_WITHDRAW : EVENT_TRANSFER;
+        event.account = 6222000000000000000ULL + rng() % 1000000;
+        event.target = 6222000000000000000ULL + rng() % 1000000;
+        event.amountCents = rng() % 3 ? 10000 : 200000;
+    }
+
+    {
+        FraudDetector detector(rules);
+        std::vector<FraudAlert> alerts;
+        int64_t base = fraudNowUs();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < count; i++) {
+            TransactionEvent event = events[i & (events.size() - 1)];
+            event.timeUs = base + (int64_t)i * 10;
+            alerts.clear();
+            detector.process(event, alerts);
+        }
+        std::printf("detector:  %.1f ns/event (%.1fM events/s, single thread)\n",
+            elapsedSeconds(start) * 1e9 / count, count / elapsedSeconds(start) / 1e6);
+    }
+
+    // 按每20微秒一笔的节奏发布，接近终端的真实速率远低于此，仍可观察丢弃与延迟
+    FraudMonitor monitor(rules, LimitRules(), alertFile);
+    if (!monitor.start()) return 1;
+    uint64_t paced = count / 100;
+    double publishNs = 0;
+    for (uint64_t i = 0; i < paced; i++) {
+        TransactionEvent event = events[i & (events.size() - 1)];
+        event.timeUs = fraudNowUs();
+        auto start = std::chrono::steady_clock::now();
+        monitor.publish(event);
+        publishNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < until) {}
+    }
+    monitor.stop();
+    std::printf("publish:   %.1f ns/event over %llu paced events (includes two clock reads)\n",
+        publishNs / paced, (unsigned long long)paced);
+    std::cout << monitor.metricsText();
+    std::remove(alertFile);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+
+    if (command == "replay" && argc >= 3) {
+        FraudRules rules;
+        std::string limitsFile;
+        bool quiet = false;
+        for (int i = 3; i < argc; i++) {
+            std::string flag = argv[i];
+            if (flag == "--quiet") {
+                quiet = true;
+            }
+            else if (flag == "--limits" && i + 1 < argc) {
+                limitsFile = argv[++i];
+            }
+            else if (i + 1 >= argc || !parseRuleFlag(flag, argv[i + 1], rules)) {
+                std::cerr << "未知参数: " << flag << std::endl;
+                return 1;
+            }
+            else {
+                i++;
+            }
+        }
+        return runReplay(argv[2], rules, limitsFile, quiet);
+    }
+    if (command == "synthesize" && argc >= 3) {
+        return runSynthesize(argv[2], argc > 3 ? std::stoull(argv[3]) : 1000000);
+    }
+    if (command == "bench") {
+        return runBench(argc > 2 ? std::stoull(argv[2]) : 10000000);
+    }
+
+    std::cerr << "用法:\n"
+        << "  " << argv[0] << " replay events.log [--quiet] [--limits 限额配置] [规则参数]\n"
+        << "  " << argv[0] << " synthesize events.log [事件数]\n"
+        << "  " << argv[0] << " bench [事件数]\n"
+        << "规则参数: --max-withdrawal-amount 元（固定阈值，不设时按层级的单笔取款限额） --max-withdrawals N --withdraw-window 秒\n"
+        << "          --fan-out N --fan-out-window 秒 --login-accounts N --login-window 秒" << std::endl;
+    return 1;
+}
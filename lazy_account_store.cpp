@@ -0,0 +1,430 @@
+#include "lazy_account_store.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+
+static const char INDEX_MAGIC[4] = { 'A', 'T', 'M', 'I' };
+static const uint32_t INDEX_VERSION = 1;
+static const uint64_t HEADER_BYTES = 64;
+static const size_t TX_LOG_CHECKPOINT_BYTES = 1 << 20;
+
+static_assert(sizeof(AccountRecord) == 128, "AccountRecord must stay 128 bytes");
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sortedCount;
+    uint64_t totalCount;
+    char reserved[40];
+};
+
+static_assert(sizeof(IndexHeader) == HEADER_BYTES, "IndexHeader must stay 64 bytes");
+
+static uint64_t recordOffset(uint64_t position) {
+    return HEADER_BYTES + position * sizeof(AccountRecord);
+}
+
+// 拆分 "<19位账号>_<字段>"
+bool splitAccountKey(const std::string& key, uint64_t& account, std::string& field) {
+    if (key.size() <= 20 || key[19] != '_') return false;
+    for (int i = 0; i < 19; i++) {
+        if (key[i] < '0' || key[i] > '9') return false;
+    }
+    account = std::strtoull(key.c_str(), nullptr, 10);
+    field = key.substr(19);
+    return true;
+}
+
+static bool copyText(char* target, size_t capacity, const std::string& value) {
+    if (value.size() >= capacity) return false;
+    std::memset(target, 0, capacity);
+    std::memcpy(target, value.data(), value.size());
+    return true;
+}
+
+static bool parseCents(const std::string& value, int64_t& cents) {
+    char* end = nullptr;
+    double parsed = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0' || !std::isfinite(parsed)) return false;
+    cents = std::llround(parsed * 100);
+    return true;
+}
+
+// 把一个字段的文本值写进记录；字段未知或超长时返回false
+bool setAccountField(AccountRecord& record, const std::string& field, const std::string& value) {
+    if (field == "_password") return copyText(record.password, sizeof(record.password), value);
+    if (field == "_balance") return parseCents(value, record.balanceCents);
+    if (field == "_daily_withdrawal") return parseCents(value, record.dailyWithdrawalCents);
+    if (field == "_idcard") return copyText(record.idCard, sizeof(record.idCard), value);
+    if (field == "_locked") {
+        record.locked = value == "true";
+        return true;
+    }
+    if (field == "_locked_until") {
+        record.lockedUntil = std::strtoll(value.c_str(), nullptr, 10);
+        return true;
+    }
+    if (field == "_name") {
+        if (!copyText(record.name, sizeof(record.name), value)) return false;
+        record.nameLength = (uint8_t)value.size();
+        return true;
+    }
+    return false;
+}
+
+std::string getAccountField(const AccountRecord& record, const std::string& field) {
+    if (field == "_password") return record.password;
+    if (field == "_balance") return std::to_string(record.balanceCents / 100.0);
+    if (field == "_daily_withdrawal") return std::to_string(record.dailyWithdrawalCents / 100.0);
+    if (field == "_idcard") return record.idCard;
+    if (field == "_locked") return record.locked ? "true" : "false";
+    if (field == "_locked_until") return record.lockedUntil ? std::to_string(record.lockedUntil) : "";
+    if (field == "_name") return std::string(record.name, record.nameLength);
+    return "";
+}
+
+bool hasAccountField(const AccountRecord& record, const std::string& field) {
+    if (field == "_locked_until") return record.lockedUntil != 0;
+    return field == "_password" || field == "_balance" || field == "_daily_withdrawal" || field == "_idcard" ||
+        field == "_locked" || field == "_name";
+}
+
+LazyAccountStore::LazyAccountStore(const std::string& indexFile, size_t cacheBytes) :
+    indexFile(indexFile),
+    fd(-1),
+    sortedCount(0),
+    totalCount(0),
+    hand(0),
+    hits(0),
+    misses(0),
+    txLog(indexFile + ".txlog"),
+    dedup(1 << 20, 3600) {
+    slots.reserve(std::max<size_t>(16, cacheBytes / sizeof(CacheSlot)));
+}
+
+LazyAccountStore::~LazyAccountStore() {
+    if (fd >= 0) ::close(fd);
+}
+
+bool LazyAccountStore::load() {
+    std::lock_guard<std::mutex> lock(mutex);
+    fd = ::open(indexFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+
+    IndexHeader header;
+    ssize_t n = ::pread(fd, &header, sizeof(header), 0);
+    bool exists = n == (ssize_t)sizeof(header);
+    if (!exists) {
+        if (!writeHeader()) return false;
+    }
+    else if (std::memcmp(header.magic, INDEX_MAGIC, 4) != 0 || header.version != INDEX_VERSION) {
+        return false;
+    }
+    else {
+        sortedCount = header.sortedCount;
+        totalCount = header.totalCount;
+    }
+
+    // 只有追加区需要在启动时读一遍，排序区按需二分查找；旧版本崩溃留下的全零记录跳过
+    AccountRecord record;
+    for (uint64_t position = sortedCount; position < totalCount; position++) {
+        if (readRecord(position, record) && record.account != 0) appended[record.account] = position;
+    }
+
+    int64_t now = unixTimeNow();
+    bool replayed = false;
+    txLog.replay([&](const TransactionRecord& entry) {
+        applyChangesLocked(entry.changes);
+        if (!entry.requestId.empty() && entry.committedAt + dedup.window() > now) {
+            dedup.insert(entry.requestId, entry.committedAt, entry.result);
+        }
+        replayed = true;
+    });
+    txLog.open();
+    if (replayed) checkpointLocked(now);
+    return exists || replayed;
+}
+
+bool LazyAccountStore::writeHeader() {
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.sortedCount = sortedCount;
+    header.totalCount = totalCount;
+    return ::pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header);
+}
+
+bool LazyAccountStore::readRecord(uint64_t position, AccountRecord& record) const {
+    return ::pread(fd, &record, sizeof(record), recordOffset(position)) == (ssize_t)sizeof(record);
+}
+
+bool LazyAccountStore::writeRecord(uint64_t position, const AccountRecord& record) {
+    return ::pwrite(fd, &record, sizeof(record), recordOffset(position)) == (ssize_t)sizeof(record);
+}
+
+// 排序区中第一个不小于account的记录位置
+bool LazyAccountStore::sortedLowerBound(uint64_t account, uint64_t& position) const {
+    uint64_t low = 0, high = sortedCount;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        uint64_t value;
+        if (::pread(fd, &value, sizeof(value), recordOffset(middle)) != (ssize_t)sizeof(value)) return false;
+        if (value < account) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    position = low;
+    return true;
+}
+
+bool LazyAccountStore::locate(uint64_t account, uint64_t& position) const {
+    auto it = appended.find(account);
+    if (it != appended.end()) {
+        position = it->second;
+        return true;
+    }
+
+    uint64_t low = 0, high = sortedCount;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        uint64_t value;
+        if (::pread(fd, &value, sizeof(value), recordOffset(middle)) != (ssize_t)sizeof(value)) return false;
+        if (value == account) {
+            position = middle;
+            return true;
+        }
+        if (value < account) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+// CLOCK淘汰：指针扫过的有引用位的槽位清除引用位，遇到没有引用位的槽位即替换
+size_t LazyAccountStore::admit(uint64_t account, const AccountRecord& record, uint64_t position) {
+    size_t index;
+    if (slots.size() < slots.capacity()) {
+        index = slots.size();
+        slots.push_back(CacheSlot{ record, position, true });
+    }
+    else {
+        while (slots[hand].referenced) {
+            slots[hand].referenced = false;
+            hand = (hand + 1) % slots.size();
+        }
+        index = hand;
+        hand = (hand + 1) % slots.size();
+        cacheIndex.erase(slots[index].record.account);
+        slots[index] = CacheSlot{ record, position, true };
+    }
+    cacheIndex[account] = index;
+    return index;
+}
+
+const AccountRecord* LazyAccountStore::fetch(uint64_t account) {
+    auto it = cacheIndex.find(account);
+    if (it != cacheIndex.end()) {
+        hits++;
+        slots[it->second].referenced = true;
+        return &slots[it->second].record;
+    }
+
+    misses++;
+    uint64_t position;
+    AccountRecord record;
+    if (!locate(account, position) || !readRecord(position, record)) return nullptr;
+    return &slots[admit(account, record, position)].record;
+}
+
+std::string LazyAccountStore::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t account;
+    std::string field;
+    if (!splitAccountKey(key, account, field)) return "";
+    const AccountRecord* record = fetch(account);
+    return record ? getAccountField(*record, field) : "";
+}
+
+bool LazyAccountStore::hasKey(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t account;
+    std::string field;
+    if (!splitAccountKey(key, account, field)) return false;
+    const AccountRecord* record = fetch(account);
+    return record && hasAccountField(*record, field);
+}
+
+// 仅注册时查重使用：顺序扫描整个文件，读到的记录不进入缓存
+std::string LazyAccountStore::findAccountByIdCard(const std::string& idCard) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<AccountRecord> chunk(512);
+    for (uint64_t position = 0; position < totalCount; position += chunk.size()) {
+        size_t count = std::min<uint64_t>(chunk.size(), totalCount - position);
+        ssize_t n = ::pread(fd, chunk.data(), count * sizeof(AccountRecord), recordOffset(position));
+        if (n < 0) break;
+        for (size_t i = 0; i < (size_t)n / sizeof(AccountRecord); i++) {
+            if (idCard == chunk[i].idCard) {
+                char buffer[24];
+                std::snprintf(buffer, sizeof(buffer), "%019llu", (unsigned long long)chunk[i].account);
+                return buffer;
+            }
+        }
+    }
+    return "";
+}
+
+// 排序区里两次pread二分得出区间内的记录数，追加区只有自上次重建以来新开的户，逐个比较
+bool LazyAccountStore::countAccountPrefix(const std::string& prefix, size_t& count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t low, high, first, last;
+    if (!accountPrefixRange(prefix, low, high)) {
+        count = 0;
+        return true;
+    }
+    if (!sortedLowerBound(low, first) || !sortedLowerBound(high + 1, last)) return false;
+    count = last - first;
+    for (const auto& entry : appended) {
+        count += entry.first >= low && entry.first <= high;
+    }
+    return true;
+}
+
+// 先在副本上应用整批修改，全部合法后才写回文件与缓存
+bool LazyAccountStore::applyChangesLocked(const ChangeBatch& changes) {
+    std::map<uint64_t, std::pair<AccountRecord, bool>> updated;
+    for (const auto& change : changes) {
+        uint64_t account;
+        std::string field;
+        if (!splitAccountKey(change.first, account, field)) return false;
+
+        auto it = updated.find(account);
+        if (it == updated.end()) {
+            const AccountRecord* existing = fetch(account);
+            AccountRecord record;
+            std::memset(&record, 0, sizeof(record));
+            record.account = account;
+            if (existing) record = *existing;
+            it = updated.emplace(account, std::make_pair(record, existing != nullptr)).first;
+        }
+        if (!setAccountField(it->second.first, field, change.second)) return false;
+    }
+
+    for (auto& entry : updated) {
+        uint64_t position;
+        if (!entry.second.second) {
+            // 新记录先写入并落盘，再让文件头计入它；否则中途崩溃会留下一条全零记录，打开时被当成账号0
+            position = totalCount;
+            if (!writeRecord(position, entry.second.first) || ::fdatasync(fd) != 0) return false;
+            totalCount++;
+            appended[entry.first] = position;
+            if (!writeHeader()) return false;
+        }
+        else if (!locate(entry.first, position) || !writeRecord(position, entry.second.first)) {
+            return false;
+        }
+
+        auto cached = cacheIndex.find(entry.first);
+        if (cached != cacheIndex.end()) {
+            slots[cached->second].record = entry.second.first;
+        }
+        else {
+            admit(entry.first, entry.second.first, position);
+        }
+    }
+    return true;
+}
+
+bool LazyAccountStore::commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 先校验，避免把无法应用的批次写进日志
+    for (const auto& change : changes) {
+        uint64_t account;
+        std::string field;
+        AccountRecord probe;
+        std::memset(&probe, 0, sizeof(probe));
+        if (!splitAccountKey(change.first, account, field) || !setAccountField(probe, field, change.second)) return false;
+    }
+
+    TransactionRecord record{ requestId, result, unixTimeNow(), changes };
+    if (!txLog.append(record)) return false;
+    if (!applyChangesLocked(changes)) return false;
+    if (!requestId.empty()) {
+        dedup.insert(requestId, record.committedAt, result);
+    }
+    if (txLog.size() > TX_LOG_CHECKPOINT_BYTES) {
+        checkpointLocked(record.committedAt);
+    }
+    return true;
+}
+
+bool LazyAccountStore::lookupRequest(const std::string& requestId, RequestResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dedup.lookup(requestId, unixTimeNow(), result);
+}
+
+// 数据文件落盘后，事务日志里的修改内容不再需要
+void LazyAccountStore::checkpointLocked(int64_t now) {
+    if (::fdatasync(fd) == 0) {
+        txLog.compact(now - dedup.window());
+    }
+}
+
+bool buildAccountIndexFile(const std::map<std::string, std::string>& data, const std::string& indexFile) {
+    std::map<uint64_t, AccountRecord> records;
+    for (const auto& pair : data) {
+        uint64_t account;
+        std::string field;
+        if (!splitAccountKey(pair.first, account, field)) continue;
+        auto inserted = records.emplace(account, AccountRecord());
+        if (inserted.second) {
+            std::memset(&inserted.first->second, 0, sizeof(AccountRecord));
+            inserted.first->second.account = account;
+        }
+        setAccountField(inserted.first->second, field, pair.second);
+    }
+
+    std::string tmp = indexFile + ".tmp";
+    int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) return false;
+
+    IndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, INDEX_MAGIC, 4);
+    header.version = INDEX_VERSION;
+    header.sortedCount = records.size();
+    header.totalCount = records.size();
+    bool ok = ::write(out, &header, sizeof(header)) == (ssize_t)sizeof(header);
+
+    std::vector<AccountRecord> buffer;
+    buffer.reserve(4096);
+    for (auto it = records.begin(); ok && it != records.end(); ++it) {
+        buffer.push_back(it->second);
+        if (buffer.size() == 4096 || std::next(it) == records.end()) {
+            size_t bytes = buffer.size() * sizeof(AccountRecord);
+            ok = ::write(out, buffer.data(), bytes) == (ssize_t)bytes;
+            buffer.clear();
+        }
+    }
+    ok = ok && ::fsync(out) == 0;
+    ::close(out);
+    return ok && std::rename(tmp.c_str(), indexFile.c_str()) == 0;
+}
+
+bool isAccountIndexFile(const std::string& filename) {
+    const std::string suffix = ".idx";
+    return filename.size() > suffix.size() &&
+        filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
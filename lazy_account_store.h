@@ -0,0 +1,94 @@
+#ifndef LAZY_ACCOUNT_STORE_H
+#define LAZY_ACCOUNT_STORE_H
+
+#include "account_store.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+// 索引文件中的一条定长账户记录（128字节），金额以分为单位
+struct AccountRecord {
+    uint64_t account;
+    int64_t balanceCents;
+    int64_t dailyWithdrawalCents;
+    int64_t lockedUntil;
+    char password[8];
+    char idCard[24];
+    char name[62];
+    uint8_t locked;
+    uint8_t nameLength;
+};
+
+// 按需加载的存储：打开 .idx 索引文件时只读文件头，账户在第一次被访问时才读入，
+// 常驻内存的记录由CLOCK算法淘汰，总量不超过cacheBytes。
+// 文件布局：64字节文件头 + 按账号排序的记录区 + 新注册账户的追加区。
+// 排序区用pread二分查找（账号查找和转账联想的前缀计数都是如此，不枚举全部账户）；
+// 追加区在打开时建立账号到位置的映射，可用 atm_snapshot index 重建排序。
+// 修改先写事务日志再原地覆盖记录，日志超过阈值时fdatasync数据文件后截断。
+class LazyAccountStore : public AccountStore {
+public:
+    LazyAccountStore(const std::string& indexFile, size_t cacheBytes = 8 << 20);
+    ~LazyAccountStore();
+
+    bool load() override;
+    std::string get(const std::string& key) override;
+    bool hasKey(const std::string& key) override;
+    std::string findAccountByIdCard(const std::string& idCard) override;
+    bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) override;
+    bool lookupRequest(const std::string& requestId, RequestResult& result) override;
+    bool countAccountPrefix(const std::string& prefix, size_t& count) override;
+
+    size_t residentBytes() const { return slots.size() * sizeof(CacheSlot); }
+    uint64_t cacheHits() const { return hits; }
+    uint64_t cacheMisses() const { return misses; }
+
+private:
+    struct CacheSlot {
+        AccountRecord record;
+        uint64_t position;
+        bool referenced;
+    };
+
+    const AccountRecord* fetch(uint64_t account);
+    bool readRecord(uint64_t position, AccountRecord& record) const;
+    bool writeRecord(uint64_t position, const AccountRecord& record);
+    bool locate(uint64_t account, uint64_t& position) const;
+    bool sortedLowerBound(uint64_t account, uint64_t& position) const;
+    size_t admit(uint64_t account, const AccountRecord& record, uint64_t position);
+    bool applyChangesLocked(const ChangeBatch& changes);
+    bool writeHeader();
+    void checkpointLocked(int64_t now);
+
+    std::string indexFile;
+    int fd;
+    uint64_t sortedCount;
+    uint64_t totalCount;
+    std::unordered_map<uint64_t, uint64_t> appended;
+
+    std::vector<CacheSlot> slots;
+    std::unordered_map<uint64_t, size_t> cacheIndex;
+    size_t hand;
+    uint64_t hits;
+    uint64_t misses;
+
+    std::mutex mutex;
+    TransactionLog txLog;
+    DedupCache dedup;
+};
+
+// AccountRecord与 "<账号>_<字段>" 键值之间的转换，共享内存存储共用
+bool splitAccountKey(const std::string& key, uint64_t& account, std::string& field);
+// 字段未知或超长时返回false
+bool setAccountField(AccountRecord& record, const std::string& field, const std::string& value);
+std::string getAccountField(const AccountRecord& record, const std::string& field);
+// 与导出成键值时一致：已知字段都存在，_locked_until 仅在有锁定期时存在
+bool hasAccountField(const AccountRecord& record, const std::string& field);
+
+// 把全部账户数据写成按账号排序的索引文件（供 atm_snapshot index 使用）
+bool buildAccountIndexFile(const std::map<std::string, std::string>& data, const std::string& indexFile);
+bool isAccountIndexFile(const std::string& filename);
+
+#endif
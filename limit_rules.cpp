@@ -0,0 +1,350 @@
+#include "limit_rules.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <sys/stat.h>
+
+// 与单一限额时期的行为一致：单笔转账不设上限
+static const LimitRow DEFAULT_ROW = { 200000, 500000, NO_LIMIT_CENTS, 1000000 };
+static const int64_t DEFAULT_DENOMINATION = 10000;
+static const uint64_t ACCOUNT_SPACE = 10000000000000000000ULL;     // 10^19
+// 面额小额表的上限（以最大公约数计），超过说明面额配置不合理
+static const int64_t MAX_SMALL_UNITS = 1 << 20;
+
+const char* defaultLimitsConfig() {
+    return
+        "# ATM限额配置，修改后约两秒内生效，无需重启\n"
+        "# 层级：tier <层级> <账号前缀>...（最长前缀优先，未匹配的账户属于standard）\n"
+        "# tier gold 622202 622203\n"
+        "# 限额：limit <层级|*> <项目> <金额元>，* 为各层级的默认值\n"
+        "limit * withdraw_single 2000\n"
+        "limit * withdraw_daily 5000\n"
+        "# 单笔转账默认不限\n"
+        "# limit * transfer_single 50000\n"
+        "limit * initial_balance 10000\n"
+        "# limit gold withdraw_single 5000\n"
+        "# 钞箱面额：取款金额须能由这些面额的钞票凑出\n"
+        "denominations 100\n";
+}
+
+uint64_t accountNumber(const std::string& account) {
+    if (account.size() != 19) return 0;
+    uint64_t value = 0;
+    for (char c : account) {
+        if (c < '0' || c > '9') return 0;
+        value = value * 10 + (uint64_t)(c - '0');
+    }
+    return value;
+}
+
+// 超出范围（含inf）按极大值处理，NaN按0处理，都会被规则拒绝
+int64_t toCents(double amount) {
+    if (!(amount > -1e15 && amount < 1e15)) return amount > 0 ? (int64_t)1 << 60 : 0;
+    return std::llround(amount * 100);
+}
+
+static bool parseYuan(const std::string& text, int64_t& cents) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0' || !(value > 0 && value < 1e13)) return false;
+    cents = std::llround(value * 100);
+    return cents > 0;
+}
+
+static bool parsePrefix(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.size() > 19) return false;
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (uint64_t)(c - '0');
+    }
+    return true;
+}
+
+static std::string yuanText(int64_t cents) {
+    std::string text = std::to_string(cents / 100);
+    if (cents % 100 != 0) {
+        text += '.';
+        text += (char)('0' + cents % 100 / 10);
+        if (cents % 10 != 0) text += (char)('0' + cents % 10);
+    }
+    return text;
+}
+
+LimitTable::LimitTable() :
+    starts{ 0 },
+    intervalTier{ 0 },
+    rows{ DEFAULT_ROW },
+    tierNames{ "standard" },
+    denominationUnit(DEFAULT_DENOMINATION),
+    smallLimitUnits(1),
+    smallRepresentable{ 1, 1 },
+    denominations(yuanText(DEFAULT_DENOMINATION)),
+    rules(0) {
+}
+
+bool LimitTable::compile(const std::string& text, std::string& error) {
+    struct Prefix {
+        uint64_t start;
+        uint64_t end;
+        size_t length;
+        uint32_t tier;
+        int line;
+    };
+    struct Setting {
+        std::string tier;
+        int field;
+        int64_t cents;
+        int line;
+    };
+    static const char* const FIELDS[] = { "withdraw_single", "withdraw_daily", "transfer_single", "initial_balance" };
+
+    LimitTable table;
+    std::map<std::string, uint32_t> tierIds{ { "standard", 0 } };
+    std::vector<Prefix> prefixes;
+    std::vector<Setting> settings;
+    std::vector<int64_t> notes;
+
+    std::istringstream input(text);
+    std::string line;
+    int lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        error = "第" + std::to_string(lineNumber) + "行: " + message;
+        return false;
+    };
+    while (std::getline(input, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::vector<std::string> words;
+        std::string word;
+        while (tokens >> word) words.push_back(word);
+        if (words.empty()) continue;
+
+        if (words[0] == "tier") {
+            if (words.size() < 3 || words[1] == "*") return fail("应为 tier <层级> <账号前缀>...");
+            auto inserted = tierIds.emplace(words[1], (uint32_t)tierIds.size());
+            for (size_t i = 2; i < words.size(); i++) {
+                uint64_t value;
+                if (!parsePrefix(words[i], value)) return fail("账号前缀应为1-19位数字: " + words[i]);
+                uint64_t scale = 1;
+                for (size_t digits = words[i].size(); digits < 19; digits++) scale *= 10;
+                prefixes.push_back({ value * scale, (value + 1) * scale, words[i].size(), inserted.first->second, lineNumber });
+            }
+        }
+        else if (words[0] == "limit") {
+            if (words.size() != 4) return fail("应为 limit <层级|*> <项目> <金额元>");
+            int field = -1;
+            for (int i = 0; i < 4; i++) {
+                if (words[2] == FIELDS[i]) field = i;
+            }
+            if (field < 0) return fail("未知的限额项目: " + words[2]);
+            int64_t cents;
+            if (!parseYuan(words[3], cents)) return fail("金额应为正数: " + words[3]);
+            settings.push_back({ words[1], field, cents, lineNumber });
+        }
+        else if (words[0] == "denominations") {
+            if (words.size() < 2 || words.size() > 9) return fail("应为 denominations <面额元>...（1-8种）");
+            notes.clear();
+            for (size_t i = 1; i < words.size(); i++) {
+                int64_t cents;
+                if (!parseYuan(words[i], cents)) return fail("面额应为正数: " + words[i]);
+                notes.push_back(cents);
+            }
+        }
+        else {
+            return fail("未知的规则: " + words[0]);
+        }
+        table.rules++;
+    }
+
+    // 各层级一行：内置默认值，再套用 * 的设置，最后套用本层级的设置
+    table.rows.assign(tierIds.size(), DEFAULT_ROW);
+    table.tierNames.assign(tierIds.size(), "");
+    for (const auto& tier : tierIds) {
+        table.tierNames[tier.second] = tier.first;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (const auto& setting : settings) {
+            if ((setting.tier == "*") != (pass == 0)) continue;
+            size_t only = table.rows.size();
+            if (pass == 1) {
+                auto tier = tierIds.find(setting.tier);
+                if (tier == tierIds.end()) {
+                    lineNumber = setting.line;
+                    return fail("层级未定义: " + setting.tier);
+                }
+                only = tier->second;
+            }
+            for (size_t row = 0; row < table.rows.size(); row++) {
+                if (only != table.rows.size() && row != only) continue;
+                int64_t* values[] = { &table.rows[row].withdrawSingle, &table.rows[row].withdrawDaily,
+                    &table.rows[row].transferSingle, &table.rows[row].initialBalance };
+                *values[setting.field] = setting.cents;
+            }
+        }
+    }
+
+    // 前缀区间之间只有包含或不相交两种关系：按起点、再按长度排序后扫描，
+    // 栈顶即覆盖当前位置的最长前缀
+    std::sort(prefixes.begin(), prefixes.end(), [](const Prefix& a, const Prefix& b) {
+        return a.start != b.start ? a.start < b.start : a.length < b.length;
+    });
+    for (size_t i = 1; i < prefixes.size(); i++) {
+        if (prefixes[i].start == prefixes[i - 1].start && prefixes[i].length == prefixes[i - 1].length) {
+            lineNumber = prefixes[i].line;
+            return fail("账号前缀重复划分层级");
+        }
+    }
+    std::vector<uint64_t> boundaries{ 0 };
+    for (const auto& prefix : prefixes) {
+        boundaries.push_back(prefix.start);
+        if (prefix.end < ACCOUNT_SPACE) boundaries.push_back(prefix.end);
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+    table.starts.clear();
+    table.intervalTier.clear();
+    std::vector<const Prefix*> open;
+    size_t next = 0;
+    for (uint64_t boundary : boundaries) {
+        while (!open.empty() && open.back()->end <= boundary) open.pop_back();
+        while (next < prefixes.size() && prefixes[next].start == boundary) open.push_back(&prefixes[next++]);
+        uint32_t tier = open.empty() ? 0 : open.back()->tier;
+        if (table.starts.empty() || table.intervalTier.back() != tier) {
+            table.starts.push_back(boundary);
+            table.intervalTier.push_back(tier);
+        }
+    }
+
+    // 面额：以最大公约数为单位，超过 最小面额×最大面额 的倍数一定凑得出，以内的查表
+    if (notes.empty()) notes.push_back(DEFAULT_DENOMINATION);
+    std::sort(notes.begin(), notes.end());
+    notes.erase(std::unique(notes.begin(), notes.end()), notes.end());
+    int64_t unit = 0;
+    for (int64_t note : notes) unit = std::gcd(unit, note);
+    int64_t limitUnits = notes.front() / unit * (notes.back() / unit);
+    if (limitUnits > MAX_SMALL_UNITS) {
+        lineNumber = 0;
+        error = "面额组合过于零碎，无法编译";
+        return false;
+    }
+    table.denominationUnit = unit;
+    table.smallLimitUnits = limitUnits;
+    table.smallRepresentable.assign(limitUnits + 1, 0);
+    table.smallRepresentable[0] = 1;
+    for (int64_t units = 1; units <= limitUnits; units++) {
+        for (int64_t note : notes) {
+            int64_t noteUnits = note / unit;
+            if (noteUnits <= units && table.smallRepresentable[units - noteUnits]) {
+                table.smallRepresentable[units] = 1;
+                break;
+            }
+        }
+    }
+    table.denominations.clear();
+    for (auto note = notes.rbegin(); note != notes.rend(); ++note) {
+        if (!table.denominations.empty()) table.denominations += '/';
+        table.denominations += yuanText(*note);
+    }
+
+    *this = std::move(table);
+    error.clear();
+    return true;
+}
+
+// 无分支二分：每步用条件传送收窄，循环次数只取决于区间数
+size_t LimitTable::tierOf(uint64_t account) const {
+    const uint64_t* base = starts.data();
+    size_t count = starts.size();
+    while (count > 1) {
+        size_t half = count / 2;
+        base = base[half] <= account ? base + half : base;
+        count -= half;
+    }
+    return intervalTier[base - starts.data()];
+}
+
+bool LimitTable::representable(int64_t cents) const {
+    int64_t units = cents / denominationUnit;
+    int64_t index = std::min(std::max(units, (int64_t)0), smallLimitUnits);
+    return (units * denominationUnit == cents) & ((units > smallLimitUnits) | (smallRepresentable[index] != 0));
+}
+
+OperationStatus LimitTable::checkWithdrawal(uint64_t account, int64_t amountCents, int64_t balanceCents,
+    int64_t dailyCents) const {
+    static const OperationStatus STATUSES[] = { OPERATION_NOT_POSITIVE, OPERATION_BAD_DENOMINATION,
+        OPERATION_OVER_SINGLE_LIMIT, OPERATION_INSUFFICIENT_BALANCE, OPERATION_OVER_DAILY_LIMIT, OPERATION_OK };
+    const LimitRow& row = rowFor(account);
+    uint32_t failed = (uint32_t)(amountCents <= 0) |
+        (uint32_t)!representable(amountCents) << 1 |
+        (uint32_t)(amountCents > row.withdrawSingle) << 2 |
+        (uint32_t)(amountCents > balanceCents) << 3 |
+        (uint32_t)(dailyCents + amountCents > row.withdrawDaily) << 4;
+    return STATUSES[__builtin_ctz(failed | 1u << 5)];
+}
+
+OperationStatus LimitTable::checkTransfer(uint64_t account, bool selfTransfer, bool targetExists, int64_t amountCents,
+    int64_t balanceCents) const {
+    static const OperationStatus STATUSES[] = { OPERATION_SELF_TRANSFER, OPERATION_TARGET_MISSING,
+        OPERATION_NOT_POSITIVE, OPERATION_OVER_TRANSFER_LIMIT, OPERATION_INSUFFICIENT_BALANCE, OPERATION_OK };
+    const LimitRow& row = rowFor(account);
+    uint32_t failed = (uint32_t)selfTransfer |
+        (uint32_t)!targetExists << 1 |
+        (uint32_t)(amountCents <= 0) << 2 |
+        (uint32_t)(amountCents > row.transferSingle) << 3 |
+        (uint32_t)(amountCents > balanceCents) << 4;
+    return STATUSES[__builtin_ctz(failed | 1u << 5)];
+}
+
+LimitRules::LimitRules() :
+    reloads(0) {
+}
+
+LimitRules::LimitRules(const std::string& path) :
+    configPath(path),
+    reloads(0) {
+}
+
+bool LimitRules::load() {
+    struct stat info;
+    std::ifstream file(configPath);
+    if (configPath.empty() || !file || stat(configPath.c_str(), &info) != 0) {
+        error = "无法读取限额配置: " + configPath;
+        return false;
+    }
+    loaded = FileStamp{ info.st_mtim.tv_sec, info.st_mtim.tv_nsec, info.st_size };
+    changed = loaded;
+    std::stringstream text;
+    text << file.rdbuf();
+
+    LimitTable table;
+    if (!table.compile(text.str(), error)) {
+        error = configPath + " " + error;
+        return false;
+    }
+    current = std::move(table);
+    reloads++;
+    return true;
+}
+
+bool LimitRules::refresh() {
+    auto now = std::chrono::steady_clock::now();
+    if (configPath.empty() || now < nextCheck) return false;
+    nextCheck = now + std::chrono::seconds(1);
+
+    struct stat info;
+    if (stat(configPath.c_str(), &info) != 0) return false;
+    FileStamp stamp{ info.st_mtim.tv_sec, info.st_mtim.tv_nsec, info.st_size };
+    if (stamp == loaded) return false;
+    if (!(stamp == changed)) {
+        changed = stamp;
+        return false;
+    }
+    return load();
+}
@@ -0,0 +1,110 @@
+#ifndef LIMIT_RULES_H
+#define LIMIT_RULES_H
+
+#include "account_operations.h"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <sys/types.h>
+
+// 不设上限的限额项
+static const int64_t NO_LIMIT_CENTS = INT64_MAX;
+
+// 一个账户层级的全部限额，单位分
+struct LimitRow {
+    int64_t withdrawSingle;
+    int64_t withdrawDaily;
+    int64_t transferSingle;
+    int64_t initialBalance;
+};
+
+// 编译后的限额表。配置文件逐行（#之后为注释）：
+//   tier <层级> <账号前缀>...                 按账号前缀划分层级，最长前缀优先，未匹配的属于standard
+//   limit <层级|*> <项目> <金额元>             项目: withdraw_single withdraw_daily transfer_single initial_balance
+//   denominations <面额元>...                  钞箱面额，取款金额须能由这些面额的钞票凑出
+// * 为各层级的默认值，具体层级的设置不论先后都覆盖它；未出现的项目沿用内置默认值
+// （单笔取款2000、单日取款5000、单笔转账不限、初始余额10000、面额100）。
+// 编译时把前缀展开成19位账号空间上互不重叠的区间，每个层级一行阈值，
+// 面额规则展开成最大公约数加上小额可凑表；求值只有一次无分支的区间查找和几次比较，
+// 各项检查的结果按位拼成掩码，最低位的失败项即返回的状态，与原先if链的先后顺序一致。
+class LimitTable {
+public:
+    // 内置默认值
+    LimitTable();
+
+    bool compile(const std::string& text, std::string& error);
+
+    size_t tierOf(uint64_t account) const;
+    const LimitRow& rowFor(uint64_t account) const { return rows[tierOf(account)]; }
+    const LimitRow& defaultRow() const { return rows[0]; }
+    const LimitRow& row(size_t tier) const { return rows[tier]; }
+    const std::string& tierName(size_t tier) const { return tierNames[tier]; }
+    size_t tierCount() const { return rows.size(); }
+    size_t intervalCount() const { return starts.size(); }
+    size_t ruleCount() const { return rules; }
+    // 例如 "100/50"
+    const std::string& denominationText() const { return denominations; }
+
+    bool representable(int64_t cents) const;
+    OperationStatus checkWithdrawal(uint64_t account, int64_t amountCents, int64_t balanceCents, int64_t dailyCents) const;
+    OperationStatus checkTransfer(uint64_t account, bool selfTransfer, bool targetExists, int64_t amountCents,
+        int64_t balanceCents) const;
+
+private:
+    std::vector<uint64_t> starts;       // 各区间起点，starts[0] == 0
+    std::vector<uint32_t> intervalTier;
+    std::vector<LimitRow> rows;         // rows[0] 为standard
+    std::vector<std::string> tierNames;
+
+    int64_t denominationUnit;           // 各面额的最大公约数，分
+    int64_t smallLimitUnits;            // 超过此数（以unit计）的倍数都凑得出
+    std::vector<uint8_t> smallRepresentable;
+    std::string denominations;
+    size_t rules;
+};
+
+// 从配置文件加载限额表并热加载：refresh() 每秒最多检查一次文件的修改时间，
+// 发现变化后要等下一次检查时仍未再变（文件已写完）才重新编译，编译成功才替换，
+// 失败时保留原表并记下错误；文件被删除时也保留原表。单线程使用，每个终端各持一份。
+class LimitRules {
+public:
+    LimitRules();
+    explicit LimitRules(const std::string& path);
+
+    // 读取并编译；文件不存在或有错时保留当前表（初始为内置默认值）并返回false
+    bool load();
+    // 表被替换时返回true
+    bool refresh();
+
+    const LimitTable& table() const { return current; }
+    const std::string& path() const { return configPath; }
+    const std::string& lastError() const { return error; }
+    uint64_t reloadCount() const { return reloads; }
+
+private:
+    std::string configPath;
+    LimitTable current;
+    std::string error;
+    uint64_t reloads;
+    std::chrono::steady_clock::time_point nextCheck;
+    struct FileStamp {
+        time_t seconds = 0;
+        long nanoseconds = 0;
+        off_t size = -1;
+        bool operator==(const FileStamp& other) const {
+            return seconds == other.seconds && nanoseconds == other.nanoseconds && size == other.size;
+        }
+    };
+    FileStamp loaded;
+    FileStamp changed;
+};
+
+// 账号文本转数值，非19位数字时返回0（归入standard）
+uint64_t accountNumber(const std::string& account);
+int64_t toCents(double amount);
+// 内置默认值对应的配置文本，atm_limits defaults 输出它作为模板
+const char* defaultLimitsConfig();
+
+#endif
@@ -0,0 +1,226 @@
+#include "limit_rules.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int runCheck(const std::string& path, const std::vector<std::string>& accounts) {
+    LimitRules rules(path);
+    if (!rules.load()) {
+        std::cerr << rules.lastError() << std::endl;
+        return 1;
+    }
+    const LimitTable& table = rules.table();
+    std::printf("%zu 条规则，%zu 个层级，%zu 个账号区间，面额 %s 元\n", table.ruleCount(), table.tierCount(),
+        table.intervalCount(), table.denominationText().c_str());
+    std::printf("%-12s %10s %10s %10s %10s\n", "层级", "单笔取款", "单日取款", "单笔转账", "初始余额");
+    for (size_t tier = 0; tier < table.tierCount(); tier++) {
+        const LimitRow& row = table.row(tier);
+        char transfer[32] = "不限";
+        if (row.transferSingle != NO_LIMIT_CENTS) std::snprintf(transfer, sizeof(transfer), "%.2f", row.transferSingle / 100.0);
+        std::printf("%-12s %10.2f %10.2f %10s %10.2f\n", table.tierName(tier).c_str(), row.withdrawSingle / 100.0,
+            row.withdrawDaily / 100.0, transfer, row.initialBalance / 100.0);
+    }
+    for (const auto& account : accounts) {
+        uint64_t number = accountNumber(account);
+        if (number == 0) {
+            std::printf("%s: 不是19位账号\n", account.c_str());
+            continue;
+        }
+        std::printf("%s: %s\n", account.c_str(), table.tierName(table.tierOf(number)).c_str());
+    }
+    return 0;
+}
+
+// 合成配置：tiers个层级，其余规则都是随机长度的账号前缀（有包含关系），每个层级各4条限额
+static std::string syntheticConfig(size_t ruleCount, size_t tiers, std::mt19937_64& rng) {
+    std::ostringstream out;
+    for (size_t tier = 0; tier < tiers; tier++) {
+        out << "limit t" << tier << " withdraw_single " << 1000 + tier * 500 << "\n"
+            << "limit t" << tier << " withdraw_daily " << 3000 + tier * 1000 << "\n"
+            << "limit t" << tier << " transfer_single " << 20000 + tier * 10000 << "\n"
+            << "limit t" << tier << " initial_balance 10000\n";
+    }
+    out << "denominations 100 50\n";
+    size_t used = tiers * 4 + 1;
+    std::map<std::string, bool> seen;
+    for (size_t tier = 0; used < ruleCount || seen.size() < tiers; ) {
+        std::string prefix = "62";
+        size_t length = 3 + rng() % 6;
+        while (prefix.size() < length) prefix += (char)('0' + rng() % 10);
+        if (!seen.emplace(prefix, true).second) continue;
+        // 先保证每个层级至少有一个前缀
+        out << "tier t" << (tier < tiers ? tier++ : rng() % tiers) << " " << prefix << "\n";
+        used++;
+    }
+    return out.str();
+}
+
+struct BenchRequest {
+    uint64_t account;
+    int64_t amount;
+    int64_t balance;
+    int64_t daily;
+};
+
+// 对照：逐条规则解释执行，最长前缀靠逐个比较账号文本，层级限额靠按名字查表
+struct InterpretedRules {
+    std::vector<std::pair<std::string, std::string>> prefixes;
+    std::map<std::string, LimitRow> rows;
+    std::vector<int64_t> notes;
+
+    OperationStatus checkWithdrawal(const std::string& account, int64_t amount, int64_t balance, int64_t daily) const {
+        const std::string* tier = nullptr;
+        size_t longest = 0;
+        for (const auto& prefix : prefixes) {
+            if (prefix.first.size() > longest && account.compare(0, prefix.first.size(), prefix.first) == 0) {
+                longest = prefix.first.size();
+                tier = &prefix.second;
+            }
+        }
+        const LimitRow& row = rows.at(tier ? *tier : "standard");
+        if (amount <= 0) return OPERATION_NOT_POSITIVE;
+        bool representable = false;
+        for (int64_t rest = amount; rest >= 0 && !representable; rest -= notes.back()) {
+            representable = rest % notes.front() == 0;
+        }
+        if (!representable) return OPERATION_BAD_DENOMINATION;
+        if (amount > row.withdrawSingle) return OPERATION_OVER_SINGLE_LIMIT;
+        if (amount > balance) return OPERATION_INSUFFICIENT_BALANCE;
+        if (daily + amount > row.withdrawDaily) return OPERATION_OVER_DAILY_LIMIT;
+        return OPERATION_OK;
+    }
+};
+
+static InterpretedRules interpret(const std::string& config) {
+    InterpretedRules rules;
+    rules.rows["standard"] = LimitTable().defaultRow();
+    std::istringstream in(config);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream words(line);
+        std::string kind, tier, item, value;
+        words >> kind;
+        if (kind == "tier") {
+            words >> tier >> value;
+            rules.prefixes.emplace_back(value, tier);
+        }
+        else if (kind == "limit") {
+            words >> tier >> item >> value;
+            auto inserted = rules.rows.emplace(tier, LimitTable().defaultRow());
+            int64_t cents = toCents(std::stod(value));
+            LimitRow& row = inserted.first->second;
+            if (item == "withdraw_single") row.withdrawSingle = cents;
+            else if (item == "withdraw_daily") row.withdrawDaily = cents;
+            else if (item == "transfer_single") row.transferSingle = cents;
+            else row.initialBalance = cents;
+        }
+        else if (kind == "denominations") {
+            while (words >> value) rules.notes.push_back(toCents(std::stod(value)));
+        }
+    }
+    // 基准里的面额为两种，小面额在前
+    std::sort(rules.notes.begin(), rules.notes.end());
+    return rules;
+}
+
+static std::string accountText(uint64_t account) {
+    char text[24];
+    std::snprintf(text, sizeof(text), "%019llu", (unsigned long long)account);
+    return text;
+}
+
+static int runBench(uint64_t evaluations) {
+    std::mt19937_64 rng(20240601);
+    const size_t requestCount = 1 << 16;
+    std::printf("%8s %8s %10s %12s %14s %14s\n", "规则数", "区间数", "编译ms", "编译表ns/次", "逐条解释ns/次", "加速");
+    for (size_t ruleCount : { 10, 100, 300, 1000, 3000 }) {
+        std::string config = syntheticConfig(ruleCount, ruleCount < 100 ? 1 : 16, rng);
+        LimitTable table;
+        std::string error;
+        auto start = std::chrono::steady_clock::now();
+        if (!table.compile(config, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        double compileMs = elapsedSeconds(start) * 1e3;
+        InterpretedRules interpreted = interpret(config);
+
+        // 账号集中在6200..6299开头，使大部分请求落在某个前缀内；金额混合合法与各类违规
+        std::vector<BenchRequest> requests(requestCount);
+        std::vector<std::string> texts(requestCount);
+        for (size_t i = 0; i < requestCount; i++) {
+            uint64_t account = 6200000000000000000ULL + rng() % 100000000000000000ULL;
+            requests[i] = { account, (int64_t)(rng() % 160) * 2500, (int64_t)(rng() % 1000000), (int64_t)(rng() % 400000) };
+            texts[i] = accountText(account);
+        }
+
+        uint64_t mismatches = 0;
+        for (size_t i = 0; i < requestCount; i++) {
+            const BenchRequest& r = requests[i];
+            mismatches += table.checkWithdrawal(r.account, r.amount, r.balance, r.daily) !=
+                interpreted.checkWithdrawal(texts[i], r.amount, r.balance, r.daily);
+        }
+        if (mismatches > 0) {
+            std::printf("编译表与逐条解释的结果不一致 %llu 次\n", (unsigned long long)mismatches);
+            return 1;
+        }
+
+        uint64_t statusSum = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < evaluations; i++) {
+            const BenchRequest& r = requests[i & (requestCount - 1)];
+            statusSum += table.checkWithdrawal(r.account, r.amount, r.balance, r.daily);
+        }
+        double compiledNs = elapsedSeconds(start) * 1e9 / evaluations;
+
+        uint64_t slowEvaluations = std::max<uint64_t>(evaluations / 100, requestCount);
+        start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < slowEvaluations; i++) {
+            const BenchRequest& r = requests[i & (requestCount - 1)];
+            statusSum += interpreted.checkWithdrawal(texts[i & (requestCount - 1)], r.amount, r.balance, r.daily);
+        }
+        double interpretedNs = elapsedSeconds(start) * 1e9 / slowEvaluations;
+
+        std::printf("%8zu %8zu %10.2f %12.1f %14.1f %13.0fx\n", table.ruleCount(), table.intervalCount(), compileMs,
+            compiledNs, interpretedNs, interpretedNs / compiledNs);
+        if (statusSum == 0) std::printf("\n");
+    }
+    return 0;
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " defaults                     输出内置默认值对应的配置\n"
+        << "  " << program << " check <配置文件> [账号...]   编译配置，列出各层级限额和账号所属层级\n"
+        << "  " << program << " bench [每组求值次数]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+    if (command == "defaults" && args.empty()) {
+        std::cout << defaultLimitsConfig();
+        return 0;
+    }
+    if (command == "check" && !args.empty()) {
+        return runCheck(args[0], std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+    if (command == "bench" && args.size() <= 1) {
+        return runBench(args.empty() ? 20000000 : std::stoull(args[0]));
+    }
+    usage(argv[0]);
+    return 1;
+}
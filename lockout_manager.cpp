@@ -0,0 +1,139 @@
+#include "lockout_manager.h"
+#include <algorithm>
+
+// ---------------- TimingWheel ----------------
+
+TimingWheel::TimingWheel(int64_t start) :
+    current(start),
+    count(0) {
+}
+
+void TimingWheel::schedule(uint64_t id, int64_t deadline) {
+    place(Timer{ id, std::max(deadline, current) });
+    count++;
+}
+
+void TimingWheel::place(const Timer& timer) {
+    for (int level = 0; level < LEVELS; level++) {
+        int shift = SLOT_BITS * (level + 1);
+        if ((timer.deadline >> shift) == (current >> shift)) {
+            slots[level][(timer.deadline >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(timer);
+            return;
+        }
+    }
+    overflow.push_back(timer);
+}
+
+void TimingWheel::advance(int64_t now, std::vector<uint64_t>& expired) {
+    while (current <= now) {
+        if (count == 0) {
+            current = now + 1;
+            return;
+        }
+
+        // 低位归零时把高层对应格子里的定时器下放，先高层后低层
+        if ((current & ((int64_t(1) << (SLOT_BITS * LEVELS)) - 1)) == 0) {
+            std::vector<Timer> pendingOverflow;
+            pendingOverflow.swap(overflow);
+            for (const auto& timer : pendingOverflow) place(timer);
+        }
+        for (int level = LEVELS - 1; level > 0; level--) {
+            if ((current & ((int64_t(1) << (SLOT_BITS * level)) - 1)) != 0) continue;
+            std::vector<Timer> cascade;
+            cascade.swap(slots[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+            for (const auto& timer : cascade) place(timer);
+        }
+
+        std::vector<Timer>& slot = slots[0][current & (SLOTS - 1)];
+        for (const auto& timer : slot) {
+            expired.push_back(timer.id);
+        }
+        count -= slot.size();
+        slot.clear();
+        current++;
+    }
+}
+
+// ---------------- LockoutManager ----------------
+
+LockoutManager::LockoutManager(int maxFailures, int failureWindowSeconds, int lockoutSeconds,
+    double burst, double refillPerSecond) :
+    maxFailures(maxFailures),
+    failureWindowSeconds(failureWindowSeconds),
+    lockoutSeconds(lockoutSeconds),
+    burst(burst),
+    refillPerSecond(refillPerSecond),
+    wheel(0) {
+}
+
+void LockoutManager::advance(int64_t now) {
+    expired.clear();
+    wheel.advance(now, expired);
+    for (uint64_t account : expired) {
+        auto it = accounts.find(account);
+        if (it != accounts.end() && it->second.deadline <= now) {
+            accounts.erase(it);
+        }
+    }
+}
+
+LockoutManager::Status LockoutManager::status(uint64_t account, int64_t now) const {
+    auto it = accounts.find(account);
+    if (it == accounts.end()) {
+        return Status{ false, maxFailures, 0 };
+    }
+    bool locked = it->second.lockedUntil > now;
+    return Status{ locked, locked ? 0 : maxFailures - it->second.failures, it->second.lockedUntil };
+}
+
+LockoutManager::Status LockoutManager::recordFailure(uint64_t account, int64_t now) {
+    advance(now);
+    auto inserted = accounts.emplace(account, AccountState{ 0, 0, 0 });
+    AccountState& state = inserted.first->second;
+
+    // 第一次失败开启计数窗口，窗口到期后计数清零
+    if (state.failures == 0) {
+        state.deadline = (uint32_t)(now + failureWindowSeconds);
+        wheel.schedule(account, state.deadline);
+    }
+    state.failures++;
+
+    if (state.failures >= maxFailures) {
+        state.lockedUntil = (uint32_t)(now + lockoutSeconds);
+        state.deadline = state.lockedUntil;
+        wheel.schedule(account, state.deadline);
+        return Status{ true, 0, state.lockedUntil };
+    }
+    return Status{ false, maxFailures - state.failures, 0 };
+}
+
+void LockoutManager::recordSuccess(uint64_t account) {
+    accounts.erase(account);
+}
+
+void LockoutManager::restoreLock(uint64_t account, int64_t lockedUntil, int64_t now) {
+    advance(now);
+    AccountState& state = accounts[account];
+    state.failures = (uint16_t)maxFailures;
+    state.lockedUntil = (uint32_t)lockedUntil;
+    state.deadline = (uint32_t)lockedUntil;
+    wheel.schedule(account, lockedUntil);
+}
+
+bool LockoutManager::allowAttempt(const std::string& source, int64_t nowMs) {
+    // 来源过多时丢弃已经回满的桶，它们与新建的桶没有区别
+    if (buckets.size() > 4096) {
+        for (auto it = buckets.begin(); it != buckets.end();) {
+            double refilled = it->second.tokens + (nowMs - it->second.lastMs) / 1000.0 * refillPerSecond;
+            it = refilled >= burst ? buckets.erase(it) : std::next(it);
+        }
+    }
+
+    auto inserted = buckets.emplace(source, Bucket{ burst, nowMs });
+    Bucket& bucket = inserted.first->second;
+    bucket.tokens = std::min(burst, bucket.tokens + (nowMs - bucket.lastMs) / 1000.0 * refillPerSecond);
+    bucket.lastMs = nowMs;
+    if (bucket.tokens < 1.0) return false;
+    bucket.tokens -= 1.0;
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef LOCKOUT_MANAGER_H
+#define LOCKOUT_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// 分层时间轮：4层、每层64格、每格1秒，覆盖约194天。
+// 定时器按到期时间与当前时间的最高不同位决定所在层，
+// 每个tick只处理一格，高层格子在低位归零时逐级下放，从不扫描全部定时器。
+class TimingWheel {
+public:
+    TimingWheel(int64_t start);
+
+    void schedule(uint64_t id, int64_t deadline);
+    // 推进到now（含），到期的定时器ID追加到expired
+    void advance(int64_t now, std::vector<uint64_t>& expired);
+    size_t pending() const { return count; }
+
+private:
+    struct Timer {
+        uint64_t id;
+        int64_t deadline;
+    };
+
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    void place(const Timer& timer);
+
+    std::vector<Timer> slots[LEVELS][SLOTS];
+    std::vector<Timer> overflow;
+    int64_t current;
+    size_t count;
+};
+
+// 按账户的登录失败计数与定时锁定，以及按来源（终端）的令牌桶限流
+class LockoutManager {
+public:
+    struct Status {
+        bool locked;
+        int remainingAttempts;
+        int64_t lockedUntil;
+    };
+
+    LockoutManager(int maxFailures = 3, int failureWindowSeconds = 900, int lockoutSeconds = 900,
+        double burst = 5, double refillPerSecond = 0.5);
+
+    // 处理到期的锁定与失败计数，应在每次检查前调用
+    void advance(int64_t now);
+
+    Status status(uint64_t account, int64_t now) const;
+    Status recordFailure(uint64_t account, int64_t now);
+    void recordSuccess(uint64_t account);
+    // 恢复持久化的锁定（例如重启后从数据文件读到的锁定截止时间）
+    void restoreLock(uint64_t account, int64_t lockedUntil, int64_t now);
+
+    bool allowAttempt(const std::string& source, int64_t nowMs);
+
+    size_t trackedAccounts() const { return accounts.size(); }
+
+private:
+    // 每个账户12字节状态；deadline与时间轮里的定时器对应，不一致说明定时器已作废
+    struct AccountState {
+        uint16_t failures;
+        uint32_t lockedUntil;
+        uint32_t deadline;
+    };
+
+    struct Bucket {
+        double tokens;
+        int64_t lastMs;
+    };
+
+    int maxFailures;
+    int failureWindowSeconds;
+    int lockoutSeconds;
+    double burst;
+    double refillPerSecond;
+
+    std::unordered_map<uint64_t, AccountState> accounts;
+    std::unordered_map<std::string, Bucket> buckets;
+    TimingWheel wheel;
+    std::vector<uint64_t> expired;
+};
+
+#endif
@@ -1,9 +1,247 @@
 #include "atm_ui.h"
+#include "replication.h"
+#include "shard_store.h"
+#include "lazy_account_store.h"
+#include "shm_account_store.h"
+#include "audit_log.h"
+#include "limit_rules.h"
+#include "online_backup.h"
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 
-int main() {
-    ATMWithFTXUI atm;
+// 备机控制台：只读查询余额，可随时提升为主机
+static bool runStandby(const std::string& socketPath, const std::string& dataFile) {
+    ReplicationStandby standby(socketPath, dataFile);
+    standby.start();
+
+    std::cout << "热备模式，主机: " << socketPath << "，数据文件: " << dataFile << std::endl;
+    std::cout << "命令: balance <账号> | metrics | promote | quit" << std::endl;
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream in(line);
+        std::string command;
+        in >> command;
+
+        if (command == "balance") {
+            std::string account;
+            in >> account;
+            double balance = 0;
+            if (standby.queryBalance(account, balance)) {
+                std::cout << account << " 余额: " << (long long)balance << " 元" << std::endl;
+            }
+            else {
+                std::cout << "账号不存在: " << account << std::endl;
+            }
+        }
+        else if (command == "metrics") {
+            std::cout << standby.metricsText();
+        }
+        else if (command == "promote") {
+            if (standby.isConnected()) {
+                std::cout << "警告：主机仍在线，提升后将停止接收其修改" << std::endl;
+            }
+            std::cout << standby.metricsText();
+            return standby.promote();
+        }
+        else if (command == "quit") {
+            break;
+        }
+        else if (!command.empty()) {
+            std::cout << "未知命令: " << command << std::endl;
+        }
+    }
+    standby.stop();
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dataFile = "users.json";
+    std::string primarySocket;
+    std::string standbySocket;
+    std::string shardList;
+    std::string shmSegment;
+    std::string coordinatorLog = "coordinator.log";
+    uint64_t maxLag = 16;
+    size_t cacheMb = 8;
+    bool operatorMode = false;
+    std::string operatorKeyFile;
+    std::string fraudAlerts;
+    std::string fraudRecord;
+    std::string auditFile;
+    std::string limitsFile = "limits.conf";
+    bool limitsGiven = false;
+    std::string backupDir;
+    int backupInterval = 60;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        }
+        else if (arg == "--primary" && i + 1 < argc) {
+            primarySocket = argv[++i];
+        }
+        else if (arg == "--standby" && i + 1 < argc) {
+            standbySocket = argv[++i];
+        }
+        else if (arg == "--max-lag" && i + 1 < argc) {
+            maxLag = std::stoull(argv[++i]);
+        }
+        else if (arg == "--shards" && i + 1 < argc) {
+            shardList = argv[++i];
+        }
+        else if (arg == "--shm" && i + 1 < argc) {
+            shmSegment = argv[++i];
+        }
+        else if (arg == "--coordinator-log" && i + 1 < argc) {
+            coordinatorLog = argv[++i];
+        }
+        else if (arg == "--cache-mb" && i + 1 < argc) {
+            cacheMb = std::stoul(argv[++i]);
+        }
+        else if (arg == "--operator") {
+            operatorMode = true;
+        }
+        else if (arg == "--operator-key" && i + 1 < argc) {
+            operatorKeyFile = argv[++i];
+        }
+        else if (arg == "--fraud-alerts" && i + 1 < argc) {
+            fraudAlerts = argv[++i];
+        }
+        else if (arg == "--fraud-record" && i + 1 < argc) {
+            fraudRecord = argv[++i];
+        }
+        else if (arg == "--audit" && i + 1 < argc) {
+            auditFile = argv[++i];
+        }
+        else if (arg == "--limits" && i + 1 < argc) {
+            limitsFile = argv[++i];
+            limitsGiven = true;
+        }
+        else if (arg == "--backup" && i + 1 < argc) {
+            backupDir = argv[++i];
+        }
+        else if (arg == "--backup-interval" && i + 1 < argc) {
+            backupInterval = std::max(1, std::stoi(argv[++i]));
+        }
+        else {
+            std::cerr << "用法: " << argv[0]
+                << " [--data 文件] [--primary socket [--max-lag N]] [--standby socket]"
+                << " [--shards s1,s2,... [--coordinator-log 文件]] [--shm 名称] [--cache-mb N] [--operator --operator-key 文件]"
+                << " [--fraud-alerts 文件 [--fraud-record 文件]] [--audit 文件] [--limits 文件]"
+                << " [--backup 目录 [--backup-interval 秒]]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!standbySocket.empty() && !runStandby(standbySocket, dataFile)) {
+        return 0;
+    }
+
+    // 运维查询必须设口令：文件首行为口令的SHA-256十六进制（如 printf '%s' 口令 | sha256sum 的输出）
+    Sha256Digest operatorKey;
+    if (operatorMode) {
+        std::ifstream keyFile(operatorKeyFile);
+        std::string line;
+        if (operatorKeyFile.empty() || !std::getline(keyFile, line) || !parseDigestHex(line.substr(0, 64), operatorKey)) {
+            std::cerr << "--operator 需要 --operator-key 文件，内容为运维口令的SHA-256十六进制" << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<AccountStore> store;
+    ReplicationPrimary primary(primarySocket, maxLag);
+    AccountIndex accountIndex;
+    AccountIndex* operatorIndex = nullptr;
+    std::unique_ptr<AuditLog> auditLog;
+    std::unique_ptr<OnlineBackup> onlineBackup;
+    if (!shardList.empty()) {
+        std::vector<std::string> shardSockets;
+        std::istringstream list(shardList);
+        std::string shard;
+        while (std::getline(list, shard, ',')) {
+            shardSockets.push_back(shard);
+        }
+        store.reset(new ShardedAccountStore(shardSockets, coordinatorLog));
+    }
+    else if (!shmSegment.empty()) {
+        // 同机多个ATM进程共用一个段，数据文件由 atm_shm persist 定期写回
+        store.reset(new ShmAccountStore(shmSegment, dataFile));
+        if (!store->load()) {
+            std::cerr << "无法打开共享内存段: " << shmSegment << std::endl;
+            return 1;
+        }
+    }
+    else if (isAccountIndexFile(dataFile)) {
+        store.reset(new LazyAccountStore(dataFile, cacheMb << 20));
+    }
+    else {
+        LocalAccountStore* local = new LocalAccountStore(dataFile);
+        store.reset(local);
+        if (!primarySocket.empty()) {
+            if (!primary.start([local] { return local->snapshot(); })) {
+                std::cerr << "无法监听复制socket: " << primarySocket << std::endl;
+                return 1;
+            }
+            local->setReplication(&primary);
+        }
+        if (operatorMode) {
+            local->setIndex(&accountIndex);
+            operatorIndex = &accountIndex;
+        }
+        if (!auditFile.empty()) {
+            auditLog.reset(new AuditLog(auditFile));
+            local->setAudit(auditLog.get());
+            // 审计日志打不开时直接退出，不在没有审计的情况下受理交易
+            local->load();
+            if (!auditLog->isOpen()) {
+                std::cerr << "无法打开审计日志: " << auditFile << std::endl;
+                return 1;
+            }
+        }
+        if (!backupDir.empty()) {
+            onlineBackup.reset(new OnlineBackup(*local, backupDir));
+        }
+    }
+    if (operatorMode && !operatorIndex) {
+        std::cerr << "运维查询仅支持单机数据文件（JSON或.snap），已忽略 --operator" << std::endl;
+    }
+    if (!auditFile.empty() && !auditLog) {
+        std::cerr << "审计日志仅支持单机数据文件（JSON或.snap），已忽略 --audit" << std::endl;
+    }
+    if (!backupDir.empty() && !onlineBackup) {
+        std::cerr << "在线备份仅支持单机数据文件（JSON或.snap），已忽略 --backup" << std::endl;
+    }
+
+    // 默认的 limits.conf 不存在时使用内置限额，之后创建的文件也会被热加载；
+    // 配置有错或指定的文件不存在时不启动，免得按错误的限额受理交易
+    LimitRules limitRules(limitsFile);
+    if (!limitRules.load() && (limitsGiven || std::ifstream(limitsFile).good())) {
+        std::cerr << limitRules.lastError() << std::endl;
+        return 1;
+    }
+
+    // 检测规则使用默认值，最大额取款按账户所属层级的单笔取款限额（随限额配置热加载），离线调参见 atm_fraud replay
+    FraudMonitor fraudMonitor(FraudRules(), limitRules, fraudAlerts.empty() ? "fraud_alerts.log" : fraudAlerts, fraudRecord);
+    if (!fraudAlerts.empty() && !fraudMonitor.start()) {
+        std::cerr << "无法打开告警文件: " << fraudAlerts << std::endl;
+        return 1;
+    }
+
+    ATMWithFTXUI atm(std::move(store), limitRules, operatorIndex, operatorIndex ? &operatorKey : nullptr,
+        fraudAlerts.empty() ? nullptr : &fraudMonitor);
+    // 构造时已加载数据；后台线程先做一次基础备份，之后定期做增量，退出时再做一次增量
+    if (onlineBackup) {
+        onlineBackup->start(backupInterval);
+    }
     atm.run();
+    // 存储归atm所有，先于它停掉备份
+    onlineBackup.reset();
+    fraudMonitor.stop();
+    primary.stop();
     std::cout << "感谢使用ATM系统，再见！" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,339 @@
+#include "online_backup.h"
+#include "account_store.h"
+#include "sha256.h"
+#include "durable_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// 基础备份每次持锁复制的键数
+static const size_t BASE_CHUNK_KEYS = 4096;
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string backupFileName(uint64_t sequence, bool base) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "backup-%08llu-%s.bak", (unsigned long long)sequence, base ? "base" : "incr");
+    return name;
+}
+
+static size_t countAccounts(const std::map<std::string, std::string>& entries) {
+    size_t accounts = 0;
+    std::string previous;
+    for (const auto& entry : entries) {
+        std::string account = accountOfKey(entry.first);
+        if (account != previous) {
+            accounts++;
+            previous = account;
+        }
+    }
+    return accounts;
+}
+
+static bool parseHeader(const std::string& line, BackupFileInfo& info) {
+    std::istringstream in(line);
+    std::string magic, kind;
+    int version = 0;
+    in >> magic >> version >> kind >> info.sequence >> info.parent >> info.createdAt >> info.accounts >> info.keys;
+    if (in.fail() || magic != "ATMBACKUP" || version != 1 || (kind != "base" && kind != "incr")) return false;
+    info.base = kind == "base";
+    return true;
+}
+
+// 读入整个备份文件并核对末行摘要；entries为nullptr时只校验
+static bool readBackupFile(const std::string& path, BackupFileInfo& info,
+    std::vector<std::pair<std::string, std::string>>* entries, uint64_t& bytes, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = "无法读取备份文件: " + path;
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes = text.size();
+    size_t end = text.size() > 1 ? text.rfind('\n', text.size() - 2) : std::string::npos;
+    size_t headerEnd = text.find('\n');
+    Sha256Digest expected;
+    if (end == std::string::npos || text.back() != '\n' || text.compare(end + 1, 4, "END ") != 0 ||
+        !parseDigestHex(text.substr(end + 5, text.size() - end - 6), expected) ||
+        !(sha256(text.data(), end + 1) == expected)) {
+        error = "备份文件不完整或已损坏: " + path;
+        return false;
+    }
+    if (!parseHeader(text.substr(0, headerEnd), info)) {
+        error = "备份文件头格式错误: " + path;
+        return false;
+    }
+    if (!entries) return true;
+    entries->reserve(info.keys);
+    for (size_t pos = headerEnd + 1; pos <= end; ) {
+        size_t lineEnd = text.find('\n', pos);
+        size_t tab = text.find('\t', pos);
+        if (tab == std::string::npos || tab > lineEnd) {
+            error = "备份文件记录格式错误: " + path;
+            return false;
+        }
+        entries->emplace_back(text.substr(pos, tab - pos), text.substr(tab + 1, lineEnd - tab - 1));
+        pos = lineEnd + 1;
+    }
+    if (entries->size() != info.keys) {
+        error = "备份文件记录数与文件头不符: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool listBackups(const std::string& directory, std::vector<BackupFileInfo>& files, std::string& error) {
+    DIR* dir = ::opendir(directory.c_str());
+    if (!dir) {
+        error = "无法打开备份目录: " + directory;
+        return false;
+    }
+    while (dirent* item = ::readdir(dir)) {
+        std::string name = item->d_name;
+        if (name.compare(0, 7, "backup-") != 0 || name.size() < 4 || name.compare(name.size() - 4, 4, ".bak") != 0) {
+            continue;
+        }
+        BackupFileInfo info;
+        info.file = directory + "/" + name;
+        std::ifstream file(info.file);
+        std::string header;
+        if (std::getline(file, header) && parseHeader(header, info)) {
+            files.push_back(info);
+        }
+    }
+    ::closedir(dir);
+    std::sort(files.begin(), files.end(), [](const BackupFileInfo& a, const BackupFileInfo& b) {
+        return a.sequence < b.sequence;
+    });
+    return true;
+}
+
+OnlineBackup::OnlineBackup(LocalAccountStore& store, const std::string& directory) :
+    store(store),
+    directory(directory),
+    lastSequence(0),
+    haveBase(false),
+    baseBytes(0),
+    incrementalBytes(0),
+    running(false) {
+    ::mkdir(directory.c_str(), 0755);
+    std::vector<BackupFileInfo> files;
+    if (listBackups(directory, files, error) && !files.empty()) {
+        lastSequence = files.back().sequence;
+    }
+    store.trackChanges(true);
+}
+
+OnlineBackup::~OnlineBackup() {
+    stop();
+    store.trackChanges(false);
+}
+
+// 先写临时文件，fsync后rename并fsync目录，目录里只会出现完整的备份
+bool OnlineBackup::write(bool base, const std::map<std::string, std::string>& entries, size_t accounts,
+    BackupStats& stats) {
+    uint64_t sequence = lastSequence + 1;
+    std::string text = "ATMBACKUP 1 " + std::string(base ? "base " : "incr ") + std::to_string(sequence) + " " +
+        std::to_string(base ? 0 : lastSequence) + " " + std::to_string(unixTimeNow()) + " " +
+        std::to_string(accounts) + " " + std::to_string(entries.size()) + "\n";
+    for (const auto& entry : entries) {
+        text += entry.first;
+        text += '\t';
+        text += entry.second;
+        text += '\n';
+    }
+    text += "END " + digestHex(sha256(text.data(), text.size())) + "\n";
+
+    std::string path = directory + "/" + backupFileName(sequence, base);
+    std::string tmp = path + ".tmp";
+    FILE* file = std::fopen(tmp.c_str(), "wb");
+    if (!file) {
+        error = "无法写入备份文件: " + tmp;
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) std::remove(tmp.c_str());
+    if (!ok || !replaceFileDurably(tmp, path)) {
+        error = "无法写入备份文件: " + path;
+        return false;
+    }
+
+    lastSequence = sequence;
+    stats.file = path;
+    stats.sequence = sequence;
+    stats.base = base;
+    stats.accounts = accounts;
+    stats.keys = entries.size();
+    stats.bytes = text.size();
+    if (base) {
+        haveBase = true;
+        baseBytes = text.size();
+        incrementalBytes = 0;
+    }
+    else {
+        incrementalBytes += text.size();
+    }
+    return true;
+}
+
+bool OnlineBackup::takeBase(BackupStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    stats = BackupStats();
+    auto timed = [&](auto call) {
+        auto callStart = std::chrono::steady_clock::now();
+        bool result = call();
+        stats.maxLockSeconds = std::max(stats.maxLockSeconds, elapsedSeconds(callStart));
+        return result;
+    };
+
+    // 开启新一轮跟踪，之前记下的改动都会包含在这次复制里
+    std::map<std::string, std::string> changed;
+    timed([&] { store.takeChanges(changed); return true; });
+    changed.clear();
+
+    std::map<std::string, std::string> image;
+    std::vector<std::pair<std::string, std::string>> chunk;
+    std::string after;
+    for (bool more = true; more; ) {
+        chunk.clear();
+        more = timed([&] { return store.copyRange(after, BASE_CHUNK_KEYS, chunk); });
+        for (auto& entry : chunk) {
+            image.emplace_hint(image.end(), std::move(entry.first), std::move(entry.second));
+        }
+        if (!image.empty()) after = image.rbegin()->first;
+    }
+    // 复制期间被改动的账号换成取走时刻的值，整个映像即对应这一刻
+    timed([&] { store.takeChanges(changed); return true; });
+    for (auto& entry : changed) {
+        image[entry.first] = std::move(entry.second);
+    }
+
+    bool ok = write(true, image, countAccounts(image), stats);
+    if (!ok) haveBase = false;
+    stats.seconds = elapsedSeconds(start);
+    return ok;
+}
+
+// 写失败时取走的改动已不在跟踪集合里，下一次改做基础备份
+bool OnlineBackup::takeIncremental(BackupStats& stats) {
+    if (!haveBase) return takeBase(stats);
+    auto start = std::chrono::steady_clock::now();
+    stats = BackupStats();
+    std::map<std::string, std::string> changed;
+    size_t accounts = store.takeChanges(changed);
+    stats.maxLockSeconds = elapsedSeconds(start);
+    if (accounts == 0) {
+        stats.seconds = stats.maxLockSeconds;
+        return true;
+    }
+
+    bool ok = write(false, changed, accounts, stats);
+    if (!ok) haveBase = false;
+    stats.seconds = elapsedSeconds(start);
+    return ok;
+}
+
+bool OnlineBackup::start(int intervalSeconds) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (running) return false;
+    running = true;
+    worker = std::thread(&OnlineBackup::run, this, intervalSeconds);
+    return true;
+}
+
+void OnlineBackup::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!running) return;
+        running = false;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void OnlineBackup::run(int intervalSeconds) {
+    BackupStats stats;
+    takeBase(stats);
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (running) {
+        wakeup.wait_for(lock, std::chrono::seconds(intervalSeconds), [this] { return !running; });
+        lock.unlock();
+        if (haveBase && incrementalBytes > baseBytes / 2) {
+            takeBase(stats);
+        }
+        else {
+            takeIncremental(stats);
+        }
+        lock.lock();
+    }
+}
+
+bool restoreBackup(const std::string& directory, uint64_t untilSequence,
+    std::map<std::string, std::string>& data, RestoreReport& report) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BackupFileInfo> files;
+    if (!listBackups(directory, files, report.error)) return false;
+    if (files.empty()) {
+        report.error = "备份目录里没有备份: " + directory;
+        return false;
+    }
+    std::map<uint64_t, const BackupFileInfo*> bySequence;
+    for (const auto& info : files) {
+        bySequence[info.sequence] = &info;
+    }
+    uint64_t target = untilSequence == 0 ? files.back().sequence : untilSequence;
+    auto found = bySequence.find(target);
+    if (found == bySequence.end()) {
+        report.error = "没有序号为 " + std::to_string(target) + " 的备份";
+        return false;
+    }
+
+    // 从目标沿上一个序号往回找到基础备份，chain[0]为目标
+    std::vector<const BackupFileInfo*> chain{ found->second };
+    while (!chain.back()->base) {
+        auto parent = bySequence.find(chain.back()->parent);
+        if (parent == bySequence.end()) {
+            report.error = "备份链断开: 缺少序号 " + std::to_string(chain.back()->parent) + " 的备份";
+            return false;
+        }
+        chain.push_back(parent->second);
+    }
+
+    // 新的在前：账号在较新的文件里出现过，较旧文件里的版本就跳过
+    std::unordered_set<std::string> covered;
+    for (const BackupFileInfo* file : chain) {
+        BackupFileInfo info;
+        std::vector<std::pair<std::string, std::string>> entries;
+        uint64_t bytes = 0;
+        if (!readBackupFile(file->file, info, &entries, bytes, report.error)) return false;
+        report.bytes += bytes;
+
+        std::vector<std::string> accounts;
+        std::string account;
+        bool skip = false;
+        for (auto& entry : entries) {
+            if (entry.first.compare(0, account.size(), account) != 0 || account.empty() ||
+                (entry.first.size() > account.size() && entry.first[account.size()] != '_')) {
+                account = accountOfKey(entry.first);
+                skip = covered.count(account) > 0;
+                if (!skip) accounts.push_back(account);
+            }
+            if (!skip) data.emplace(std::move(entry.first), std::move(entry.second));
+        }
+        covered.insert(accounts.begin(), accounts.end());
+        report.files++;
+    }
+    report.sequence = target;
+    report.accounts = covered.size();
+    report.keys = data.size();
+    report.seconds = elapsedSeconds(start);
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef ONLINE_BACKUP_H
+#define ONLINE_BACKUP_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+class LocalAccountStore;
+
+// 一次备份的结果
+struct BackupStats {
+    std::string file;
+    uint64_t sequence = 0;
+    bool base = false;
+    size_t accounts = 0;
+    size_t keys = 0;
+    uint64_t bytes = 0;
+    double maxLockSeconds = 0;    // 单次向存储取数（持锁复制）的最长时间，含等待其他提交释放锁
+    double seconds = 0;
+};
+
+// 备份目录里的一个文件
+struct BackupFileInfo {
+    std::string file;
+    uint64_t sequence;
+    uint64_t parent;              // 增量的上一个备份，基础备份为0
+    bool base;
+    int64_t createdAt;
+    size_t accounts;
+    size_t keys;
+};
+
+// 单机存储的在线备份，不停止受理交易。备份目录下每个文件一行头：
+//   ATMBACKUP 1 <base|incr> <序号> <上一个序号> <时间> <账号数> <键数>
+// 随后每行 key\tvalue，末行 END <之前全部内容的SHA-256>；先写临时文件，fsync后rename并fsync目录，
+// 不会留下半个文件。
+// 基础备份：先开启新一轮变更跟踪，再按键序分块复制全部数据（每块单独持锁，块与块之间
+// 处理线程照常提交），最后取走复制期间改动过的账号的当前值覆盖上去。复制期间没改动的账号
+// 从开始到结束都没变，所以结果正好是最后那次持锁时刻的一致映像。
+// 增量备份：一次持锁取走上次备份以来改动过的账号并复制它们的全部字段，
+// 持锁时间和文件大小只与这期间的改动量有关，与账户总数无关（提交在锁内只写事务日志和内存，
+// 数据文件由锁外的检查点重写，取数时至多等一次提交）。
+// 变更跟踪只在内存里，进程重启后的第一次备份总是基础备份；序号在目录内递增，不覆盖旧文件。
+class OnlineBackup {
+public:
+    OnlineBackup(LocalAccountStore& store, const std::string& directory);
+    ~OnlineBackup();
+
+    bool takeBase(BackupStats& stats);
+    // 本进程还没有基础备份时先做基础备份；期间没有改动时不写文件（stats.file为空）
+    bool takeIncremental(BackupStats& stats);
+
+    // 后台线程每intervalSeconds秒做一次增量备份；自上次基础备份以来的增量累计超过
+    // 基础备份的一半时改做基础备份，使恢复时要合并的量有上限。stop()时再做一次增量
+    bool start(int intervalSeconds);
+    void stop();
+
+    const std::string& lastError() const { return error; }
+
+private:
+    bool write(bool base, const std::map<std::string, std::string>& entries, size_t accounts, BackupStats& stats);
+    void run(int intervalSeconds);
+
+    LocalAccountStore& store;
+    std::string directory;
+    std::string error;
+    uint64_t lastSequence;
+    bool haveBase;
+    uint64_t baseBytes;
+    uint64_t incrementalBytes;
+
+    std::thread worker;
+    std::mutex stateMutex;
+    std::condition_variable wakeup;
+    bool running;
+};
+
+// 列出目录里的备份文件（只读头部），按序号排序
+bool listBackups(const std::string& directory, std::vector<BackupFileInfo>& files, std::string& error);
+
+struct RestoreReport {
+    uint64_t sequence = 0;        // 恢复到的备份序号
+    size_t files = 0;
+    size_t accounts = 0;
+    size_t keys = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    std::string error;
+};
+
+// 从目录恢复到序号untilSequence（0为最新）：找到不晚于它的最近一次基础备份，
+// 校验其后的增量逐个相连且摘要正确，再从最新的增量往回合并，每个账号只取第一次出现的版本，
+// 基础备份里已被增量覆盖的账号直接跳过
+bool restoreBackup(const std::string& directory, uint64_t untilSequence,
+    std::map<std::string, std::string>& data, RestoreReport& report);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef OPERATION_ARENA_H
+#define OPERATION_ARENA_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include <cstddef>
+
+// 单次请求或单帧渲染用的临时内存。先从对象内的固定缓冲区顺序分配，
+// 用完才向上游申请；reset()后整块复用，稳定状态下不触发堆分配。
+template <size_t N>
+class OperationArena {
+public:
+    OperationArena() : resource(buffer, N, std::pmr::new_delete_resource()) {}
+    OperationArena(const OperationArena&) = delete;
+    OperationArena& operator=(const OperationArena&) = delete;
+
+    std::pmr::memory_resource* get() { return &resource; }
+    void reset() { resource.release(); }
+
+private:
+    alignas(std::max_align_t) char buffer[N];
+    std::pmr::monotonic_buffer_resource resource;
+};
+
+inline void appendText(std::pmr::string& out, std::string_view text) {
+    out.append(text.data(), text.size());
+}
+
+template <class T>
+inline std::enable_if_t<std::is_integral_v<T>> appendText(std::pmr::string& out, T value) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+// 在arena上拼接文本，例如 arenaText(arena, "余额: ", (int)balance, " 元")
+template <class... Parts>
+std::pmr::string arenaText(std::pmr::memory_resource* arena, const Parts&... parts) {
+    std::pmr::string out(arena);
+    (appendText(out, parts), ...);
+    return out;
+}
+
+#endif
@@ -0,0 +1,383 @@
+#include "replication.h"
+#include "account_store.h"
+#include "socket_util.h"
+#include "durable_file.h"
+#include "transaction_log.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+int64_t replicationNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// ---------------- ReplicationPrimary ----------------
+
+ReplicationPrimary::ReplicationPrimary(const std::string& socketPath, uint64_t maxLag, int ackTimeoutMs) :
+    socketPath(socketPath),
+    maxLag(maxLag),
+    ackTimeoutMs(ackTimeoutMs),
+    listenFd(-1),
+    standbyFd(-1),
+    seq(0),
+    ackedSeq(0),
+    throttledCommits(0),
+    snapshotPending(false),
+    running(false) {
+}
+
+ReplicationPrimary::~ReplicationPrimary() {
+    stop();
+}
+
+bool ReplicationPrimary::start(std::function<std::map<std::string, std::string>()> snapshot) {
+    snapshotProvider = snapshot;
+
+    listenFd = socketListen(socketPath, 1);
+    if (listenFd < 0) return false;
+
+    running = true;
+    acceptThread = std::thread(&ReplicationPrimary::acceptLoop, this);
+    heartbeatThread = std::thread(&ReplicationPrimary::heartbeatLoop, this);
+    return true;
+}
+
+void ReplicationPrimary::stop() {
+    if (!running.exchange(false)) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropStandbyLocked();
+    }
+    ::shutdown(listenFd, SHUT_RDWR);
+    ::close(listenFd);
+    listenFd = -1;
+    ackCond.notify_all();
+
+    if (acceptThread.joinable()) acceptThread.join();
+    if (heartbeatThread.joinable()) heartbeatThread.join();
+    ::unlink(socketPath.c_str());
+}
+
+void ReplicationPrimary::acceptLoop() {
+    while (running) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (!running) break;
+            continue;
+        }
+
+        uint64_t snapshotSeq;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            dropStandbyLocked();
+            standbyFd = fd;
+            snapshotPending = true;
+            pendingPayloads.clear();
+            snapshotSeq = seq;
+        }
+
+        // 快照在复制锁外取：提交是先持存储的锁再调publish()，这里反过来嵌套会互相等死。
+        // 从snapshotSeq起的提交都已缓存，快照之后补发即可衔接；修改都是整值覆盖，
+        // 快照里已包含的提交按顺序再应用一遍，结果不变
+        std::string payload;
+        for (const auto& pair : snapshotProvider()) {
+            payload += "S " + pair.first + "\t" + pair.second + "\n";
+        }
+        payload += "E " + std::to_string(snapshotSeq) + "\n";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            snapshotPending = false;
+            // 取快照期间备机被断开（stop()）时fd已关闭
+            if (standbyFd != fd) continue;
+            for (const auto& pending : pendingPayloads) {
+                payload += pending;
+            }
+            pendingPayloads.clear();
+            ackedSeq = snapshotSeq;
+            if (!sendLocked(payload)) continue;
+        }
+
+        std::string buffer, line;
+        while (running && socketReadLine(fd, buffer, line)) {
+            if (line.size() > 2 && line[0] == 'A') {
+                std::lock_guard<std::mutex> lock(mutex);
+                uint64_t acked = std::stoull(line.substr(2));
+                if (acked > ackedSeq) ackedSeq = acked;
+                ackCond.notify_all();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (standbyFd == fd) dropStandbyLocked();
+    }
+}
+
+void ReplicationPrimary::heartbeatLoop() {
+    while (running) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (standbyFd >= 0 && !snapshotPending) {
+                sendLocked("H " + std::to_string(seq) + " " + std::to_string(replicationNowMs()) + "\n");
+            }
+        }
+        writeMetricsFile();
+        for (int i = 0; i < 10 && running; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+bool ReplicationPrimary::sendLocked(const std::string& payload) {
+    if (standbyFd < 0) return false;
+    if (!socketWriteAll(standbyFd, payload)) {
+        dropStandbyLocked();
+        return false;
+    }
+    return true;
+}
+
+void ReplicationPrimary::dropStandbyLocked() {
+    if (standbyFd >= 0) {
+        ::shutdown(standbyFd, SHUT_RDWR);
+        ::close(standbyFd);
+        standbyFd = -1;
+    }
+    ackCond.notify_all();
+}
+
+void ReplicationPrimary::publish(const ChangeBatch& changes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    seq++;
+    if (standbyFd < 0) return;
+
+    std::string payload = "M " + std::to_string(seq) + " " + std::to_string(replicationNowMs()) +
+        " " + std::to_string(changes.size()) + "\n";
+    for (const auto& change : changes) {
+        payload += change.first + "\t" + change.second + "\n";
+    }
+    if (snapshotPending) {
+        pendingPayloads.push_back(std::move(payload));
+        return;
+    }
+    sendLocked(payload);
+}
+
+// 有界延迟：未确认的提交过多时阻塞当前提交，超时则断开落后的备机。
+// 只阻塞发起提交的线程，不持存储的锁，其他终端照常读取和提交
+void ReplicationPrimary::waitForStandby() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (standbyFd < 0 || snapshotPending || seq - ackedSeq <= maxLag) return;
+    throttledCommits++;
+    bool caughtUp = ackCond.wait_for(lock, std::chrono::milliseconds(ackTimeoutMs), [this] {
+        return standbyFd < 0 || seq - ackedSeq <= maxLag;
+    });
+    if (!caughtUp) {
+        dropStandbyLocked();
+    }
+}
+
+std::string ReplicationPrimary::metricsText() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << "atm_replication_role 1\n";
+    out << "atm_replication_commit_seq " << seq << "\n";
+    out << "atm_replication_acked_seq " << ackedSeq << "\n";
+    out << "atm_replication_lag_records " << (standbyFd >= 0 ? seq - ackedSeq : 0) << "\n";
+    out << "atm_replication_standby_connected " << (standbyFd >= 0 ? 1 : 0) << "\n";
+    out << "atm_replication_throttled_commits " << throttledCommits << "\n";
+    return out.str();
+}
+
+void ReplicationPrimary::writeMetricsFile() {
+    std::ofstream file(socketPath + ".metrics");
+    if (file.is_open()) {
+        file << metricsText();
+    }
+}
+
+// ---------------- ReplicationStandby ----------------
+
+// 备机日志超过该大小时做检查点
+static const size_t STANDBY_CHECKPOINT_BYTES = 4 << 20;
+
+ReplicationStandby::ReplicationStandby(const std::string& socketPath, const std::string& dataFile) :
+    socketPath(socketPath),
+    dataFile(dataFile),
+    appliedSeq(0),
+    primarySeq(0),
+    lastCommitTimeMs(0),
+    lastApplyLagMs(0),
+    lastContactMs(0),
+    connected(false),
+    running(false),
+    fd(-1) {
+    std::map<std::string, std::string> saved;
+    loadAccountData(dataFile, saved);
+    for (const auto& pair : saved) {
+        data.set(pair.first, pair.second);
+    }
+    txLog.reset(new TransactionLog(dataFile + ".txlog"));
+    txLog->open();
+}
+
+ReplicationStandby::~ReplicationStandby() {
+    stop();
+}
+
+void ReplicationStandby::start() {
+    running = true;
+    receiveThread = std::thread(&ReplicationStandby::receiveLoop, this);
+}
+
+void ReplicationStandby::stop() {
+    if (!running.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+    }
+    if (receiveThread.joinable()) receiveThread.join();
+}
+
+void ReplicationStandby::receiveLoop() {
+    while (running) {
+        int sock = socketConnect(socketPath);
+        if (sock < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fd = sock;
+        }
+        connected = true;
+
+        std::string buffer, line;
+        SimpleJson snapshot;
+        ChangeBatch batch;
+        int remaining = 0;
+        uint64_t batchSeq = 0;
+        int64_t batchTime = 0;
+
+        while (running && socketReadLine(sock, buffer, line)) {
+            if (remaining > 0) {
+                size_t tab = line.find('\t');
+                if (tab != std::string::npos) {
+                    batch.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+                }
+                if (--remaining == 0) {
+                    // 没能落盘的批次不确认，断开后重连取全量快照
+                    if (!applyBatch(batch, batchTime)) break;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    appliedSeq = batchSeq;
+                    lastCommitTimeMs = batchTime;
+                    lastApplyLagMs = replicationNowMs() - batchTime;
+                    socketWriteAll(sock, "A " + std::to_string(appliedSeq) + "\n");
+                }
+                continue;
+            }
+
+            std::istringstream in(line.size() > 2 ? line.substr(2) : "");
+            switch (line.empty() ? ' ' : line[0]) {
+            case 'S': {
+                size_t tab = line.find('\t');
+                if (tab != std::string::npos) {
+                    snapshot.set(line.substr(2, tab - 2), line.substr(tab + 1));
+                }
+                break;
+            }
+            case 'E': {
+                std::lock_guard<std::mutex> lock(mutex);
+                bool saved = applySnapshotLocked(snapshot);
+                snapshot.clear();
+                in >> appliedSeq;
+                primarySeq = appliedSeq;
+                lastContactMs = replicationNowMs();
+                if (saved) socketWriteAll(sock, "A " + std::to_string(appliedSeq) + "\n");
+                break;
+            }
+            case 'M': {
+                size_t count = 0;
+                in >> batchSeq >> batchTime >> count;
+                batch.clear();
+                remaining = (int)count;
+                std::lock_guard<std::mutex> lock(mutex);
+                primarySeq = batchSeq;
+                lastContactMs = replicationNowMs();
+                break;
+            }
+            case 'H': {
+                std::lock_guard<std::mutex> lock(mutex);
+                in >> primarySeq;
+                lastContactMs = replicationNowMs();
+                break;
+            }
+            }
+        }
+
+        connected = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        ::close(sock);
+        fd = -1;
+    }
+}
+
+bool ReplicationStandby::applyBatch(const ChangeBatch& batch, int64_t commitTimeMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!txLog->append(TransactionRecord{ "", RequestResult{ REQUEST_NONE, 0 }, commitTimeMs / 1000, batch })) {
+        return false;
+    }
+    for (const auto& change : batch) {
+        data.set(change.first, change.second);
+    }
+    return txLog->size() <= STANDBY_CHECKPOINT_BYTES || checkpointLocked();
+}
+
+// 全量快照先整体写成日志里唯一的一条记录（rewrite是临时文件+rename），再做检查点：
+// 任何一步中断，重放结果都是旧状态或新快照，不会把旧批次叠加到新快照上
+bool ReplicationStandby::applySnapshotLocked(SimpleJson& snapshot) {
+    data = snapshot;
+    const auto& all = data.getAll();
+    TransactionRecord record{ "", RequestResult{ REQUEST_NONE, 0 }, replicationNowMs() / 1000,
+        ChangeBatch(all.begin(), all.end()) };
+    return txLog->rewrite({ record }) && syncParentDirectory(dataFile) && checkpointLocked();
+}
+
+// 数据文件落盘后才清空日志
+bool ReplicationStandby::checkpointLocked() {
+    return saveAccountData(data, dataFile) && txLog->rewrite({}) && syncParentDirectory(dataFile);
+}
+
+bool ReplicationStandby::promote() {
+    stop();
+    std::lock_guard<std::mutex> lock(mutex);
+    return checkpointLocked();
+}
+
+bool ReplicationStandby::queryBalance(const std::string& account, double& balance) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!data.hasKey(account + "_password")) return false;
+    try {
+        balance = std::stod(data.get(account + "_balance"));
+    }
+    catch (...) {
+        return false;
+    }
+    return true;
+}
+
+std::string ReplicationStandby::metricsText() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << "atm_replication_role 0\n";
+    out << "atm_replication_applied_seq " << appliedSeq << "\n";
+    out << "atm_replication_primary_seq " << primarySeq << "\n";
+    out << "atm_replication_lag_records " << (primarySeq > appliedSeq ? primarySeq - appliedSeq : 0) << "\n";
+    out << "atm_replication_apply_lag_ms " << lastApplyLagMs << "\n";
+    out << "atm_replication_last_contact_age_ms " << (lastContactMs ? replicationNowMs() - lastContactMs : -1) << "\n";
+    out << "atm_replication_connected " << (connected ? 1 : 0) << "\n";
+    return out.str();
+}
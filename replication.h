@@ -0,0 +1,116 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "simple_json.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+class TransactionLog;
+
+// 一次提交中的全部字段修改（key -> value）
+using ChangeBatch = std::vector<std::pair<std::string, std::string>>;
+
+// 主机端：通过本地socket把已提交的账户修改推送给热备进程。
+// 协议为按行的文本：
+//   S key\tvalue        全量快照中的一项
+//   E seq               快照结束，快照对应的序号
+//   M seq time count    一次提交，后跟count行 key\tvalue
+//   H seq time          心跳
+// 备机回复 A seq 作为确认。
+class ReplicationPrimary {
+public:
+    ReplicationPrimary(const std::string& socketPath, uint64_t maxLag = 16, int ackTimeoutMs = 2000);
+    ~ReplicationPrimary();
+
+    // snapshot在新备机接入时调用，返回当前全部数据；调用时不持复制锁，可以去取存储的锁
+    bool start(std::function<std::map<std::string, std::string>()> snapshot);
+    void stop();
+
+    // 在存储的提交锁内调用，按提交顺序编号并发出，不等待确认
+    void publish(const ChangeBatch& changes);
+    // 在存储的锁外、publish()之后调用：未确认的提交超过maxLag时等待备机追上，超时则断开备机
+    void waitForStandby();
+
+    std::string metricsText();
+
+private:
+    void acceptLoop();
+    void heartbeatLoop();
+    bool sendLocked(const std::string& payload);
+    void dropStandbyLocked();
+    void writeMetricsFile();
+
+    std::string socketPath;
+    uint64_t maxLag;
+    int ackTimeoutMs;
+    std::function<std::map<std::string, std::string>()> snapshotProvider;
+
+    int listenFd;
+    int standbyFd;
+    uint64_t seq;
+    uint64_t ackedSeq;
+    uint64_t throttledCommits;
+    // 新备机接入、正在取快照时为true，这期间的提交先缓存在pendingPayloads里，随快照之后发出
+    bool snapshotPending;
+    std::vector<std::string> pendingPayloads;
+    std::atomic<bool> running;
+
+    std::mutex mutex;
+    std::condition_variable ackCond;
+    std::thread acceptThread;
+    std::thread heartbeatThread;
+};
+
+// 备机端：持续应用主机推送的修改，提供只读余额查询，可提升为主机。
+// 每个批次追加到 <数据文件>.txlog 并fsync后才确认；日志超过阈值、收到全量快照和提升时
+// 做检查点（写临时文件、fsync后rename），启动时与单机存储一样重放日志补齐数据文件
+class ReplicationStandby {
+public:
+    ReplicationStandby(const std::string& socketPath, const std::string& dataFile);
+    ~ReplicationStandby();
+
+    void start();
+    void stop();
+
+    // 提升为主机：停止复制并把已应用的数据落盘
+    bool promote();
+
+    bool queryBalance(const std::string& account, double& balance);
+    bool isConnected() const { return connected; }
+    std::string metricsText();
+
+private:
+    void receiveLoop();
+    bool applyBatch(const ChangeBatch& batch, int64_t commitTimeMs);
+    bool applySnapshotLocked(SimpleJson& snapshot);
+    bool checkpointLocked();
+
+    std::string socketPath;
+    std::string dataFile;
+    SimpleJson data;
+    std::unique_ptr<TransactionLog> txLog;
+
+    uint64_t appliedSeq;
+    uint64_t primarySeq;
+    int64_t lastCommitTimeMs;
+    int64_t lastApplyLagMs;
+    int64_t lastContactMs;
+    std::atomic<bool> connected;
+    std::atomic<bool> running;
+    int fd;
+
+    std::mutex mutex;
+    std::thread receiveThread;
+};
+
+int64_t replicationNowMs();
+
+#endif
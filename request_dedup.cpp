@@ -0,0 +1,49 @@
+#include "request_dedup.h"
+#include "account_store.h"
+
+DedupCache::DedupCache(size_t memoryBudgetBytes, int windowSeconds) :
+    windowSeconds(windowSeconds),
+    evicted(0) {
+    size_t count = 16;
+    while (count * 2 * sizeof(Entry) <= memoryBudgetBytes) {
+        count *= 2;
+    }
+    slots.assign(count, Entry{ 0, 0, 0, 0.0 });
+    mask = count - 1;
+}
+
+bool DedupCache::lookup(const std::string& requestId, int64_t now, RequestResult& result) const {
+    uint64_t hash = hashKey(requestId) | 1;
+    for (int i = 0; i < PROBE_LIMIT; i++) {
+        const Entry& entry = slots[(hash + i) & mask];
+        if (entry.hash == hash && entry.expiresAt > now) {
+            result.kind = entry.kind;
+            result.amount = entry.amount;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DedupCache::insert(const std::string& requestId, int64_t committedAt, const RequestResult& result) {
+    // 哈希最低位置1，0留给空槽
+    uint64_t hash = hashKey(requestId) | 1;
+    Entry* victim = nullptr;
+    for (int i = 0; i < PROBE_LIMIT; i++) {
+        Entry& entry = slots[(hash + i) & mask];
+        if (entry.hash == hash || entry.hash == 0) {
+            victim = &entry;
+            break;
+        }
+        if (!victim || entry.expiresAt < victim->expiresAt) {
+            victim = &entry;
+        }
+    }
+    if (victim->hash != 0 && victim->hash != hash) {
+        evicted++;
+    }
+    victim->hash = hash;
+    victim->expiresAt = (uint32_t)(committedAt + windowSeconds);
+    victim->kind = result.kind;
+    victim->amount = result.amount;
+}
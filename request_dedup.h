@@ -0,0 +1,51 @@
+#ifndef REQUEST_DEDUP_H
+#define REQUEST_DEDUP_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// 一次已提交请求的结果，重复请求直接返回它
+struct RequestResult {
+    int kind;
+    double amount;
+};
+
+enum RequestKind {
+    REQUEST_NONE = 0,
+    REQUEST_WITHDRAW = 1,
+    REQUEST_TRANSFER = 2
+};
+
+// 固定内存的请求去重表：开放寻址哈希，只保存请求ID的64位哈希。
+// 每个条目在window秒后过期；探测范围内没有空位时淘汰最早过期的条目，
+// 因此重试风暴下内存占用不会超过构造时给定的预算。
+class DedupCache {
+public:
+    DedupCache(size_t memoryBudgetBytes, int windowSeconds);
+
+    bool lookup(const std::string& requestId, int64_t now, RequestResult& result) const;
+    void insert(const std::string& requestId, int64_t committedAt, const RequestResult& result);
+
+    int window() const { return windowSeconds; }
+    size_t capacity() const { return slots.size(); }
+    size_t memoryBytes() const { return slots.size() * sizeof(Entry); }
+    uint64_t evictions() const { return evicted; }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t expiresAt;
+        int32_t kind;
+        double amount;
+    };
+
+    static const int PROBE_LIMIT = 8;
+
+    std::vector<Entry> slots;
+    size_t mask;
+    int windowSeconds;
+    uint64_t evicted;
+};
+
+#endif
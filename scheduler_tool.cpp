@@ -0,0 +1,292 @@
+#include "standing_orders.h"
+#include "audit_log.h"
+#include "columnar_snapshot.h"
+#include "lazy_account_store.h"
+#include "shard_store.h"
+#include "synthetic_accounts.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+struct SchedulerOptions {
+    std::string ordersFile = "standing_orders.txt";
+    std::string dataFile = "users.json";
+    std::string shardList;
+    std::string coordinatorLog = "coordinator.log";
+    std::string auditFile;
+    std::string reportFile = "standing_failures.log";
+    size_t batchSize = 65536;
+    int64_t now = 0;
+    ProgressResolution resolution = RESOLVE_BY_STORE;
+};
+
+// 与主程序相同的存储选择：分片 > 按需加载索引文件 > 单机数据文件。
+// 崩溃恢复向存储查询最后一批的请求ID，分片把请求结果随写入持久化，重启后也查得到。
+// 主程序开着审计时这里也要带上同一个审计日志，否则压缩事务日志会丢掉未审计的转账；
+// auditLog由调用方持有，须比存储活得久
+static std::unique_ptr<AccountStore> openStore(const SchedulerOptions& options, std::unique_ptr<AuditLog>& auditLog) {
+    std::unique_ptr<AccountStore> store;
+    if (!options.auditFile.empty() && (!options.shardList.empty() || isAccountIndexFile(options.dataFile))) {
+        std::cerr << "审计日志仅支持单机数据文件（JSON或.snap）" << std::endl;
+        return store;
+    }
+    if (!options.shardList.empty()) {
+        std::vector<std::string> shardSockets;
+        std::istringstream list(options.shardList);
+        std::string shard;
+        while (std::getline(list, shard, ',')) {
+            shardSockets.push_back(shard);
+        }
+        store.reset(new ShardedAccountStore(shardSockets, options.coordinatorLog));
+    }
+    else if (isAccountIndexFile(options.dataFile)) {
+        store.reset(new LazyAccountStore(options.dataFile, 64 << 20));
+    }
+    else {
+        LocalAccountStore* local = new LocalAccountStore(options.dataFile);
+        store.reset(local);
+        if (!options.auditFile.empty()) {
+            auditLog.reset(new AuditLog(options.auditFile));
+            local->setAudit(auditLog.get());
+        }
+    }
+    if (!store->load()) store.reset();
+    if (auditLog && !auditLog->isOpen()) {
+        std::cerr << "无法打开审计日志: " << options.auditFile << std::endl;
+        store.reset();
+    }
+    return store;
+}
+
+// 日期按本地时间 YYYY-MM-DD[ HH:MM] 解析
+static bool parseRunTime(const std::string& text, int64_t& runAt) {
+    struct tm local;
+    std::memset(&local, 0, sizeof(local));
+    int fields = std::sscanf(text.c_str(), "%d-%d-%d %d:%d", &local.tm_year, &local.tm_mon, &local.tm_mday,
+        &local.tm_hour, &local.tm_min);
+    if (fields != 3 && fields != 5) return false;
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_isdst = -1;
+    runAt = (int64_t)std::mktime(&local);
+    return runAt > 0;
+}
+
+static std::string formatRunTime(int64_t runAt) {
+    time_t time = (time_t)runAt;
+    struct tm local;
+    localtime_r(&time, &local);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", &local);
+    return buffer;
+}
+
+static bool isAccountNumber(const std::string& text) {
+    return text.size() == 19 && text.find_first_not_of("0123456789") == std::string::npos;
+}
+
+static int runAdd(StandingOrderBook& book, const std::vector<std::string>& args) {
+    StandingOrder order = StandingOrder();
+    order.period = PERIOD_MONTHLY;
+    if (args.size() < 4 || !isAccountNumber(args[0]) || !isAccountNumber(args[1]) ||
+        !parseRunTime(args[3], order.nextRunAt) || (args.size() > 4 && !parseStandingPeriod(args[4], order.period))) {
+        std::cerr << "用法: add <付款账号> <收款账号> <金额> <首次执行 YYYY-MM-DD> [once|daily|weekly|monthly]" << std::endl;
+        return 1;
+    }
+    order.from = std::stoull(args[0]);
+    order.to = std::stoull(args[1]);
+    order.amountCents = (int64_t)(std::stod(args[2]) * 100 + 0.5);
+    time_t first = (time_t)order.nextRunAt;
+    struct tm local;
+    localtime_r(&first, &local);
+    order.dayOfMonth = (uint32_t)local.tm_mday;
+
+    uint64_t id = book.add(order);
+    if (!book.save()) {
+        std::cerr << "无法写入委托文件" << std::endl;
+        return 1;
+    }
+    std::printf("已添加委托 %" PRIu64 "，首次执行 %s\n", id, formatRunTime(order.nextRunAt).c_str());
+    return 0;
+}
+
+static int runList(StandingOrderBook& book) {
+    for (const auto& order : book.orders()) {
+        std::printf("%6" PRIu64 "  %019" PRIu64 " -> %019" PRIu64 "  %12.2f  %-7s 下次 %s\n", order.id, order.from, order.to,
+            order.amountCents / 100.0, standingPeriodName(order.period), formatRunTime(order.nextRunAt).c_str());
+    }
+    std::printf("共 %zu 条委托\n", book.orders().size());
+    return 0;
+}
+
+static int runDue(StandingOrderBook& book, AccountStore& store, const SchedulerOptions& options) {
+    FILE* report = std::fopen(options.reportFile.c_str(), "a");
+    if (!report) {
+        std::cerr << "无法打开失败报告: " << options.reportFile << std::endl;
+        return 1;
+    }
+    TransferScheduler scheduler(store, book, options.batchSize);
+    StandingRunStats stats;
+    bool ok = scheduler.runDue(options.now ? options.now : unixTimeNow(), report, stats);
+    std::fclose(report);
+    ok = ok && book.save();
+
+    std::printf("成功 %" PRIu64 " 笔，失败 %" PRIu64 " 笔（见 %s），%" PRIu64 " 批，耗时 %.2f s，%.0f 笔/s\n",
+        stats.executed, stats.failed, options.reportFile.c_str(), stats.batches, stats.seconds,
+        (stats.executed + stats.failed) / (stats.seconds > 0 ? stats.seconds : 1e-9));
+    if (!ok) {
+        std::cerr << "提交失败，已停止；下次运行时按进度记录恢复" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// 停机积压：每个委托的首次执行时间落在过去30天内，按月委托只补一期，按日委托补若干期；
+// 约1%的委托金额超出余额、0.5%的收款账户不存在，用来检验失败报告
+static int runBench(size_t orderCount, size_t accountCount, size_t batchSize) {
+    const std::string dataFile = "bench_scheduler.snap";
+    const std::string ordersFile = "bench_standing_orders.txt";
+    const std::string reportFile = "bench_standing_failures.log";
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint", ordersFile, ordersFile + ".progress", reportFile }) {
+        std::remove(file.c_str());
+    }
+
+    std::vector<uint64_t> accounts;
+    {
+        std::map<std::string, std::string> data;
+        generateAccounts(accountCount, data);
+        for (const auto& pair : data) {
+            if (pair.first.size() == 28 && pair.first.compare(19, 9, "_password") == 0) {
+                accounts.push_back(std::stoull(pair.first.substr(0, 19)));
+            }
+        }
+        if (!saveColumnarSnapshot(data, dataFile, false)) {
+            std::cerr << "无法写入: " << dataFile << std::endl;
+            return 1;
+        }
+    }
+
+    int64_t now = unixTimeNow();
+    std::mt19937_64 rng(20240601);
+    StandingOrderBook book(ordersFile);
+    for (size_t i = 0; i < orderCount; i++) {
+        StandingOrder order = StandingOrder();
+        order.from = accounts[rng() % accounts.size()];
+        order.to = accounts[rng() % accounts.size()];
+        if (rng() % 200 == 0) order.to += 1;
+        order.amountCents = rng() % 100 == 0 ? 1000000000 : 100 + rng() % 5000;
+        order.nextRunAt = now - (int64_t)(rng() % (30 * 86400));
+        order.period = rng() % 50 == 0 ? PERIOD_DAILY : PERIOD_MONTHLY;
+        book.add(order);
+    }
+    if (!book.save()) return 1;
+
+    SchedulerOptions options;
+    options.dataFile = dataFile;
+    options.ordersFile = ordersFile;
+    options.reportFile = reportFile;
+    options.batchSize = batchSize;
+    options.now = now;
+    std::printf("账户 %zu 个，积压委托 %zu 条，每批 %zu 笔\n", accounts.size(), orderCount, batchSize);
+    std::unique_ptr<AuditLog> auditLog;
+    std::unique_ptr<AccountStore> store = openStore(options, auditLog);
+    if (!store) return 1;
+    int result = runDue(book, *store, options);
+
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint", ordersFile, ordersFile + ".progress", reportFile }) {
+        std::remove(file.c_str());
+    }
+    return result;
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " add <付款账号> <收款账号> <金额> <首次执行 YYYY-MM-DD> [once|daily|weekly|monthly]\n"
+        << "  " << program << " list\n"
+        << "  " << program << " cancel <编号>\n"
+        << "  " << program << " run [--data 文件 | --shards s1,s2,... [--coordinator-log 文件]] [--audit 审计日志] [--report 文件] [--batch N] [--now unix秒] [--resolve committed|not-committed]\n"
+        << "  " << program << " bench [委托数] [账户数] [--batch N]\n"
+        << "通用选项: --orders 委托文件（默认 standing_orders.txt）" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    SchedulerOptions options;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--orders" && i + 1 < argc) options.ordersFile = argv[++i];
+        else if (arg == "--data" && i + 1 < argc) options.dataFile = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc) options.shardList = argv[++i];
+        else if (arg == "--coordinator-log" && i + 1 < argc) options.coordinatorLog = argv[++i];
+        else if (arg == "--audit" && i + 1 < argc) options.auditFile = argv[++i];
+        else if (arg == "--report" && i + 1 < argc) options.reportFile = argv[++i];
+        else if (arg == "--batch" && i + 1 < argc) options.batchSize = std::stoul(argv[++i]);
+        else if (arg == "--now" && i + 1 < argc) options.now = std::stoll(argv[++i]);
+        else if (arg == "--resolve" && i + 1 < argc) {
+            std::string resolution = argv[++i];
+            if (resolution == "committed") options.resolution = RESOLVE_COMMITTED;
+            else if (resolution == "not-committed") options.resolution = RESOLVE_NOT_COMMITTED;
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else args.push_back(arg);
+    }
+
+    if (command == "bench") {
+        return runBench(args.size() > 0 ? std::stoul(args[0]) : 1000000, args.size() > 1 ? std::stoul(args[1]) : 100000,
+            options.batchSize);
+    }
+
+    StandingOrderBook book(options.ordersFile);
+    book.load();
+    if (command == "run") {
+        std::unique_ptr<AuditLog> auditLog;
+        std::unique_ptr<AccountStore> store = openStore(options, auditLog);
+        if (!store) {
+            std::cerr << "无法加载账户数据" << std::endl;
+            return 1;
+        }
+        if (!book.recover(*store, options.resolution)) {
+            std::cerr << book.lastError() << "\n"
+                << "请核对该批转账是否已记入账户后，用 run --resolve committed 或 --resolve not-committed 恢复" << std::endl;
+            return 1;
+        }
+        return runDue(book, *store, options);
+    }
+    if (book.hasPendingProgress()) {
+        std::cerr << "上次执行未正常结束，请先运行 run 完成恢复" << std::endl;
+        return 1;
+    }
+    if (command == "add") {
+        return runAdd(book, args);
+    }
+    if (command == "list") {
+        return runList(book);
+    }
+    if (command == "cancel" && args.size() == 1) {
+        if (!book.cancel(std::stoull(args[0])) || !book.save()) {
+            std::cerr << "委托不存在: " << args[0] << std::endl;
+            return 1;
+        }
+        std::printf("已取消委托 %s\n", args[0].c_str());
+        return 0;
+    }
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,233 @@
+#include "sha256.h"
+#include <atomic>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ATM_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotateRight(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static void compressSoftware(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    for (; blocks > 0; blocks--, data += 64) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)data[i * 4] << 24 | (uint32_t)data[i * 4 + 1] << 16 |
+                (uint32_t)data[i * 4 + 2] << 8 | (uint32_t)data[i * 4 + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            uint32_t choose = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + choose + ROUND_CONSTANTS[i] + w[i];
+            uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + s0 + majority;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef ATM_SHA_NI
+// SHA-NI：状态按指令要求排成ABEF/CDGH两个寄存器，每条sha256rnds2做两轮，
+// 消息扩展由sha256msg1/msg2每次产生4个字
+__attribute__((target("sha,sse4.1")))
+static void compressShaNi(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; blocks > 0; blocks--, data += 64) {
+        __m128i savedAbef = abef;
+        __m128i savedCdgh = cdgh;
+        __m128i w[4];
+#pragma GCC unroll 16
+        for (int group = 0; group < 16; group++) {
+            __m128i words;
+            if (group < 4) {
+                words = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + group * 16)), byteSwap);
+            }
+            else {
+                words = _mm_sha256msg1_epu32(w[group & 3], w[(group + 1) & 3]);
+                words = _mm_add_epi32(words, _mm_alignr_epi8(w[(group + 3) & 3], w[(group + 2) & 3], 4));
+                words = _mm_sha256msg2_epu32(words, w[(group + 3) & 3]);
+            }
+            w[group & 3] = words;
+            __m128i message = _mm_add_epi32(words, _mm_loadu_si128((const __m128i*)&ROUND_CONSTANTS[group * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, savedAbef);
+        cdgh = _mm_add_epi32(cdgh, savedCdgh);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+}
+
+static bool cpuHasShaNi() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) return false;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return (ebx & (1u << 29)) != 0;
+}
+#endif
+
+typedef void (*CompressFunction)(uint32_t*, const uint8_t*, size_t);
+
+static std::atomic<bool> forceSoftware(false);
+
+static bool hardwareAvailable() {
+#ifdef ATM_SHA_NI
+    static const bool available = cpuHasShaNi();
+    return available;
+#else
+    return false;
+#endif
+}
+
+static CompressFunction compressFunction() {
+#ifdef ATM_SHA_NI
+    if (hardwareAvailable() && !forceSoftware.load(std::memory_order_relaxed)) return compressShaNi;
+#endif
+    return compressSoftware;
+}
+
+const char* sha256Backend() {
+    return compressFunction() == compressSoftware ? "软件" : "SHA-NI";
+}
+
+void sha256ForceSoftware(bool force) {
+    forceSoftware.store(force, std::memory_order_relaxed);
+}
+
+bool Sha256Digest::operator==(const Sha256Digest& other) const {
+    return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+}
+
+Sha256::Sha256() :
+    compress(compressFunction()),
+    state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 },
+    buffered(0),
+    total(0) {
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    total += size;
+    if (buffered > 0) {
+        size_t take = size < 64 - buffered ? size : 64 - buffered;
+        std::memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes += take;
+        size -= take;
+        if (buffered < 64) return;
+        compress(state, buffer, 1);
+        buffered = 0;
+    }
+    if (size >= 64) {
+        compress(state, bytes, size / 64);
+        bytes += size / 64 * 64;
+        size %= 64;
+    }
+    std::memcpy(buffer, bytes, size);
+    buffered = size;
+}
+
+Sha256Digest Sha256::finish() {
+    uint64_t bits = total * 8;
+    buffer[buffered++] = 0x80;
+    if (buffered > 56) {
+        std::memset(buffer + buffered, 0, 64 - buffered);
+        compress(state, buffer, 1);
+        buffered = 0;
+    }
+    std::memset(buffer + buffered, 0, 56 - buffered);
+    for (int i = 0; i < 8; i++) {
+        buffer[56 + i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    compress(state, buffer, 1);
+
+    Sha256Digest digest;
+    for (int i = 0; i < 8; i++) {
+        digest.bytes[i * 4] = (uint8_t)(state[i] >> 24);
+        digest.bytes[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest.bytes[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest.bytes[i * 4 + 3] = (uint8_t)state[i];
+    }
+    return digest;
+}
+
+Sha256Digest sha256(const void* data, size_t size) {
+    Sha256 hash;
+    hash.update(data, size);
+    return hash.finish();
+}
+
+Sha256Digest sha256Pair(const Sha256Digest& left, const Sha256Digest& right) {
+    Sha256 hash;
+    hash.update(left.bytes, sizeof(left.bytes));
+    hash.update(right.bytes, sizeof(right.bytes));
+    return hash.finish();
+}
+
+std::string digestHex(const Sha256Digest& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(64, '0');
+    for (int i = 0; i < 32; i++) {
+        text[i * 2] = digits[digest.bytes[i] >> 4];
+        text[i * 2 + 1] = digits[digest.bytes[i] & 15];
+    }
+    return text;
+}
+
+bool parseDigestHex(const std::string& text, Sha256Digest& digest) {
+    if (text.size() != 64) return false;
+    for (int i = 0; i < 64; i++) {
+        char c = text[i];
+        int value = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (value < 0) return false;
+        if (i % 2 == 0) digest.bytes[i / 2] = (uint8_t)(value << 4);
+        else digest.bytes[i / 2] |= (uint8_t)value;
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+struct Sha256Digest {
+    uint8_t bytes[32];
+
+    bool operator==(const Sha256Digest& other) const;
+    bool operator!=(const Sha256Digest& other) const { return !(*this == other); }
+};
+
+// 增量SHA-256。x86 CPU支持SHA扩展（SHA-NI）时压缩函数用硬件指令，否则用软件实现，
+// 进程启动后第一次使用时按cpuid选定
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t size);
+    Sha256Digest finish();
+
+private:
+    void (*compress)(uint32_t*, const uint8_t*, size_t);
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered;
+    uint64_t total;
+};
+
+Sha256Digest sha256(const void* data, size_t size);
+// SHA256(left || right)，审计链与Merkle树的内部节点
+Sha256Digest sha256Pair(const Sha256Digest& left, const Sha256Digest& right);
+
+std::string digestHex(const Sha256Digest& digest);
+bool parseDigestHex(const std::string& text, Sha256Digest& digest);
+
+// 当前使用的实现："SHA-NI" 或 "软件"；forceSoftware用于基准对比
+const char* sha256Backend();
+void sha256ForceSoftware(bool force);
+
+#endif
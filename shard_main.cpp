@@ -0,0 +1,243 @@
+#include "shard_store.h"
+#include "limit_rules.h"
+#include "socket_util.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int CRASH_SHARDS = 2;
+static const int64_t CRASH_INITIAL_CENTS = 100000;
+
+static std::string crashAccount(int index) {
+    char account[32];
+    std::snprintf(account, sizeof(account), "62220000%011d", index);
+    return account;
+}
+
+// 在子进程里运行一个分片，fault非空时带着故障注入点启动；等到socket能连上再返回
+static pid_t startShard(const std::string& socketPath, const std::string& dataFile, const char* fault) {
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        if (fault) ::setenv("ATM_FAULT", fault, 1);
+        ShardServer server(socketPath, dataFile);
+        server.run();
+        std::_Exit(1);
+    }
+    for (int attempt = 0; attempt < 200; attempt++) {
+        int fd = socketConnect(socketPath);
+        if (fd >= 0) {
+            ::close(fd);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return pid;
+}
+
+// 协调者子进程：不停地做跨分片转账，直到注入点让它崩溃，或分片崩溃后请求失败
+static void runCrashCoordinator(const std::vector<std::string>& sockets, const std::string& log,
+    int accounts, const char* fault) {
+    if (fault) ::setenv("ATM_FAULT", fault, 1);
+    ShardedAccountStore store(sockets, log);
+    if (!store.load()) std::_Exit(1);
+    for (int i = 0; i < accounts * 4; i++) {
+        std::string from = crashAccount(i % accounts);
+        std::string to;
+        for (int step = 1; step < accounts && to.empty(); step++) {
+            std::string candidate = crashAccount((i + step) % accounts);
+            if (store.shardOf(candidate) != store.shardOf(from)) to = candidate;
+        }
+        std::string fromBalance = store.get(from + "_balance");
+        std::string toBalance = store.get(to + "_balance");
+        if (to.empty() || fromBalance.empty() || toBalance.empty()) break;
+        ChangeBatch changes{ { from + "_balance", std::to_string((toCents(std::stod(fromBalance)) - 100) / 100.0) },
+            { to + "_balance", std::to_string((toCents(std::stod(toBalance)) + 100) / 100.0) } };
+        if (!store.commit(changes, "", RequestResult{ REQUEST_NONE, 0 })) break;
+    }
+    std::_Exit(0);
+}
+
+static bool sumBalances(ShardedAccountStore& store, int accounts, int64_t& total) {
+    total = 0;
+    for (int i = 0; i < accounts; i++) {
+        std::string balance = store.get(crashAccount(i) + "_balance");
+        if (balance.empty()) return false;
+        total += toCents(std::stod(balance));
+    }
+    return true;
+}
+
+// 分片必须拒绝提交从未准备过的事务，否则协调者会把只生效了一半的转账当作已完成
+static bool rejectsUnknownCommit(const std::string& socketPath) {
+    int fd = socketConnect(socketPath);
+    std::string buffer, reply;
+    bool ok = fd >= 0 && socketWriteAll(fd, "COMMIT crashtest-unknown\n") && socketReadLine(fd, buffer, reply);
+    if (fd >= 0) ::close(fd);
+    return ok && reply == "ERROR";
+}
+
+static size_t countPrepared(const std::string& dataFile) {
+    std::ifstream file(dataFile + ".prepared");
+    std::string line;
+    size_t count = 0;
+    while (std::getline(file, line)) {
+        if (line.compare(0, 2, "T ") == 0) count++;
+    }
+    return count;
+}
+
+// 在每个故障注入点各崩溃一次：另一个协调者全程在线并持有0号日志槽位，
+// 崩溃的协调者用1号槽位；崩溃后重启出故障的分片，再启动一个协调者接手无主槽位做恢复。
+// 恢复后核对总余额守恒、分片上没有残留的准备记录，在线的协调者仍能正常转账
+static bool runCrashCase(const std::string& directory, int accounts, const char* fault) {
+    std::vector<std::string> sockets, dataFiles;
+    for (int shard = 0; shard < CRASH_SHARDS; shard++) {
+        sockets.push_back(directory + "/crashtest_shard" + std::to_string(shard) + ".sock");
+        dataFiles.push_back(directory + "/crashtest_shard" + std::to_string(shard) + ".json");
+    }
+    const std::string log = directory + "/crashtest_coordinator.log";
+    auto removeFiles = [&] {
+        for (int shard = 0; shard < CRASH_SHARDS; shard++) {
+            for (const char* suffix : { "", ".prepared", ".decided", ".tmp", ".txlog", ".txlog.tmp" }) {
+                std::remove((dataFiles[shard] + suffix).c_str());
+            }
+            std::remove(sockets[shard].c_str());
+        }
+        for (const auto& file : { log, log + ".1", log + ".2" }) {
+            std::remove(file.c_str());
+        }
+    };
+    removeFiles();
+    {
+        ShardedAccountStore router(sockets, "/dev/null");
+        std::vector<SimpleJson> shardData(CRASH_SHARDS);
+        for (int i = 0; i < accounts; i++) {
+            std::string key = crashAccount(i) + "_balance";
+            shardData[router.shardOf(key)].set(key, std::to_string(CRASH_INITIAL_CENTS / 100.0));
+        }
+        for (int shard = 0; shard < CRASH_SHARDS; shard++) {
+            shardData[shard].saveToFile(dataFiles[shard]);
+        }
+    }
+
+    bool shardFault = std::string(fault).compare(0, 6, "shard_") == 0;
+    std::vector<pid_t> shardPids;
+    for (int shard = 0; shard < CRASH_SHARDS; shard++) {
+        shardPids.push_back(startShard(sockets[shard], dataFiles[shard], shardFault && shard == 0 ? fault : nullptr));
+    }
+
+    ShardedAccountStore live(sockets, log);
+    bool ok = live.load();
+    pid_t coordinator = ::fork();
+    if (coordinator == 0) runCrashCoordinator(sockets, log, accounts, shardFault ? nullptr : fault);
+    int status = 0;
+    ::waitpid(coordinator, &status, 0);
+    bool crashed = !shardFault && WIFEXITED(status) && WEXITSTATUS(status) == 86;
+    if (shardFault) {
+        // 协调者是在分片崩溃、请求失败后才退出的，此时分片进程已经结束
+        for (int attempt = 0; attempt < 200 && !crashed; attempt++) {
+            int shardStatus = 0;
+            if (::waitpid(shardPids[0], &shardStatus, WNOHANG) == shardPids[0]) {
+                crashed = WIFEXITED(shardStatus) && WEXITSTATUS(shardStatus) == 86;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (crashed) shardPids[0] = startShard(sockets[0], dataFiles[0], nullptr);
+    }
+
+    int64_t total = 0;
+    size_t leftover = 0;
+    {
+        ShardedAccountStore recovery(sockets, log);
+        ok = ok && recovery.load() && sumBalances(recovery, accounts, total);
+    }
+    bool rejected = true;
+    for (int shard = 0; shard < CRASH_SHARDS; shard++) {
+        leftover += countPrepared(dataFiles[shard]);
+        rejected = rejectsUnknownCommit(sockets[shard]) && rejected;
+    }
+    std::string from = crashAccount(0), to = crashAccount(1);
+    for (int i = 2; live.shardOf(to) == live.shardOf(from) && i < accounts; i++) {
+        to = crashAccount(i);
+    }
+    std::string fromBalance = live.get(from + "_balance"), toBalance = live.get(to + "_balance");
+    bool liveOk = !fromBalance.empty() && !toBalance.empty() && live.commit(
+        { { from + "_balance", std::to_string((toCents(std::stod(fromBalance)) - 100) / 100.0) },
+          { to + "_balance", std::to_string((toCents(std::stod(toBalance)) + 100) / 100.0) } },
+        "", RequestResult{ REQUEST_NONE, 0 });
+
+    int64_t expected = CRASH_INITIAL_CENTS * accounts;
+    bool passed = ok && crashed && total == expected && leftover == 0 && rejected && liveOk;
+    std::printf("  %-28s %-6s 总余额%s（%+lld 分）  残留准备记录 %zu  未知事务COMMIT%s  在线协调者%s  %s\n", fault,
+        crashed ? "已崩溃" : "未触发", total == expected ? "守恒" : "不守恒", (long long)(total - expected),
+        leftover, rejected ? "被拒" : "被接受", liveOk ? "正常" : "受影响", passed ? "通过" : "失败");
+
+    for (pid_t pid : shardPids) {
+        ::kill(pid, SIGKILL);
+        ::waitpid(pid, nullptr, 0);
+    }
+    removeFiles();
+    return passed;
+}
+
+static int runCrashTest(const std::string& directory, int accounts) {
+    const char* faults[] = { "coordinator_after_prepare", "coordinator_after_decision", "coordinator_mid_finish",
+        "shard_after_prepare", "shard_before_commit_apply" };
+    std::printf("%d 个分片、%d 个账户，在每个故障注入点崩溃后恢复：\n", CRASH_SHARDS, accounts);
+    bool allPassed = true;
+    for (const char* fault : faults) {
+        allPassed = runCrashCase(directory, accounts, fault) && allPassed;
+    }
+    return allPassed ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string socketPath;
+    std::string dataFile;
+
+    if (argc >= 2 && std::string(argv[1]) == "crashtest") {
+        std::string directory = ".";
+        int accounts = 16;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--dir" && i + 1 < argc) directory = argv[++i];
+            else if (arg == "--accounts" && i + 1 < argc) accounts = std::max(2, std::stoi(argv[++i]));
+            else {
+                std::cerr << "用法: " << argv[0] << " crashtest [--dir 目录] [--accounts N]" << std::endl;
+                return 1;
+            }
+        }
+        return runCrashTest(directory, accounts);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        }
+    }
+
+    if (socketPath.empty() || dataFile.empty()) {
+        std::cerr << "用法: " << argv[0] << " --socket 路径 --data 分片数据文件\n"
+            << "       " << argv[0] << " crashtest [--dir 目录] [--accounts N]   在每个故障注入点崩溃并核对资金守恒"
+            << std::endl;
+        return 1;
+    }
+
+    ShardServer server(socketPath, dataFile);
+    if (!server.run()) {
+        std::cerr << "无法监听: " << socketPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,611 @@
+#include "shard_store.h"
+#include "socket_util.h"
+#include "fault_injection.h"
+#include "durable_file.h"
+#include <sys/socket.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+// 分片记住的已决定事务数。协调者只会为日志里没有END的事务重发决定，数量很少
+static const size_t SHARD_DECIDED_KEEP = 1 << 16;
+// 分片事务日志超过该大小时重写数据文件
+static const size_t SHARD_CHECKPOINT_BYTES = 4 << 20;
+
+// 先写临时文件，fsync后rename覆盖并fsync目录，避免崩溃时留下半个文件
+static bool writeFileDurably(const std::string& path, const std::string& content) {
+    std::string tmp = path + ".tmp";
+    FILE* file = std::fopen(tmp.c_str(), "w");
+    if (!file) return false;
+    bool ok = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return replaceFileDurably(tmp, path);
+}
+
+// 第slot个协调者日志槽位：0号是 --coordinator-log 本身，其余加 .1、.2 …… 后缀
+static std::string coordinatorLogSlot(const std::string& base, size_t slot) {
+    return slot == 0 ? base : base + "." + std::to_string(slot);
+}
+
+static bool parseShardWrite(const std::string& line, ShardWrite& write) {
+    size_t a = line.find('\t');
+    size_t b = a == std::string::npos ? a : line.find('\t', a + 1);
+    size_t c = b == std::string::npos ? b : line.find('\t', b + 1);
+    if (c == std::string::npos) return false;
+    write.key = line.substr(0, a);
+    write.checkExpected = line.substr(a + 1, b - a - 1) == "1";
+    write.expected = line.substr(b + 1, c - b - 1);
+    write.value = line.substr(c + 1);
+    return true;
+}
+
+// 请求ID及结果，附在APPLY/PREPARE行尾；没有请求ID时为空
+static std::string encodeShardRequest(const std::string& requestId, const RequestResult& result) {
+    if (requestId.empty()) return "";
+    return " " + requestId + " " + std::to_string(result.kind) + " " + std::to_string(result.amount);
+}
+
+std::string encodeShardWrites(const std::vector<ShardWrite>& writes) {
+    std::string payload;
+    for (const auto& write : writes) {
+        payload += write.key + "\t" + (write.checkExpected ? "1" : "0") + "\t" +
+            write.expected + "\t" + write.value + "\n";
+    }
+    return payload;
+}
+
+// ---------------- ShardServer ----------------
+
+ShardServer::ShardServer(const std::string& socketPath, const std::string& dataFile) :
+    socketPath(socketPath),
+    dataFile(dataFile),
+    txLog(dataFile + ".txlog"),
+    dedup(1 << 20, 3600),
+    decidedFd(-1),
+    listenFd(-1),
+    running(false) {
+}
+
+bool ShardServer::run() {
+    std::map<std::string, std::string> saved;
+    loadAccountData(dataFile, saved);
+    for (const auto& pair : saved) {
+        data.set(pair.first, pair.second);
+    }
+    int64_t now = unixTimeNow();
+    txLog.replay([&](const TransactionRecord& record) {
+        if (!record.requestId.empty() && record.committedAt + dedup.window() > now) {
+            dedup.insert(record.requestId, record.committedAt, record.result);
+        }
+    });
+    if (!txLog.open()) return false;
+    loadPrepared();
+    loadDecided();
+    decidedFd = ::open((dataFile + ".decided").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (decidedFd < 0) return false;
+
+    listenFd = socketListen(socketPath, 16);
+    if (listenFd < 0) return false;
+
+    running = true;
+    while (running) {
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::thread(&ShardServer::serveConnection, this, fd).detach();
+    }
+    return true;
+}
+
+void ShardServer::stop() {
+    running = false;
+    ::shutdown(listenFd, SHUT_RDWR);
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+}
+
+void ShardServer::serveConnection(int fd) {
+    std::string buffer, line;
+    while (socketReadLine(fd, buffer, line)) {
+        std::istringstream in(line);
+        std::string verb, arg, requestId;
+        size_t count = 0;
+        RequestResult result{ REQUEST_NONE, 0 };
+        in >> verb;
+        if (verb == "APPLY") {
+            in >> count;
+        }
+        else if (verb == "PREPARE") {
+            in >> arg >> count;
+        }
+        else {
+            in >> arg;
+        }
+        if ((verb == "APPLY" || verb == "PREPARE") && !(in >> requestId >> result.kind >> result.amount)) {
+            requestId.clear();
+        }
+
+        std::vector<ShardWrite> writes;
+        bool ok = true;
+        for (size_t i = 0; i < count && ok; i++) {
+            ShardWrite write;
+            ok = socketReadLine(fd, buffer, line) && parseShardWrite(line, write);
+            writes.push_back(write);
+        }
+        if (!ok) break;
+
+        std::string reply = handleCommand(verb, arg, writes, requestId, result);
+        if (!socketWriteAll(fd, reply + "\n")) break;
+    }
+    ::close(fd);
+}
+
+std::string ShardServer::handleCommand(const std::string& verb, const std::string& arg,
+    const std::vector<ShardWrite>& writes, const std::string& requestId, const RequestResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    RequestResult known;
+    bool duplicate = !requestId.empty() && dedup.lookup(requestId, unixTimeNow(), known);
+    if (verb == "GET") {
+        return data.hasKey(arg) ? "V " + data.get(arg) : "N";
+    }
+    if (verb == "FIND") {
+        std::string account = data.findAccountByIdCard(arg);
+        return account.empty() ? "N" : "V " + account;
+    }
+    if (verb == "REQUEST") {
+        if (!dedup.lookup(arg, unixTimeNow(), known)) return "N";
+        return "R " + std::to_string(known.kind) + " " + std::to_string(known.amount);
+    }
+    if (verb == "APPLY") {
+        if (duplicate) return "OK";
+        if (!validateLocked(writes)) return "CONFLICT";
+        return applyLocked(writes, requestId, result) ? "OK" : "ERROR";
+    }
+    if (verb == "PREPARE") {
+        if (prepared.count(arg)) return "OK";
+        if (duplicate) return "DUPLICATE";
+        if (decided.count(arg) || !validateLocked(writes)) return "CONFLICT";
+        prepared[arg] = PreparedTransaction{ writes, requestId, result };
+        for (const auto& write : writes) {
+            lockedKeys[write.key] = arg;
+        }
+        if (!savePreparedLocked()) {
+            for (const auto& write : writes) {
+                lockedKeys.erase(write.key);
+            }
+            prepared.erase(arg);
+            return "ERROR";
+        }
+        faultPoint("shard_after_prepare");
+        return "OK";
+    }
+    if (verb == "COMMIT" || verb == "ABORT") {
+        bool commitDecision = verb == "COMMIT";
+        auto it = prepared.find(arg);
+        if (it == prepared.end()) {
+            // 重发的决定：与已记下的一致才算成功；从未准备过的事务不能提交，只能按回滚记下
+            auto known = decided.find(arg);
+            if (known != decided.end()) return known->second == commitDecision ? "OK" : "ERROR";
+            if (commitDecision) return "ERROR";
+            return recordDecisionLocked(arg, false) ? "OK" : "ERROR";
+        }
+        if (commitDecision) {
+            faultPoint("shard_before_commit_apply");
+            if (!applyLocked(it->second.writes, it->second.requestId, it->second.result)) return "ERROR";
+        }
+        // 数据已落盘后才记下决定；记录失败时保留准备记录，协调者重发时再做一次
+        if (!recordDecisionLocked(arg, commitDecision)) return "ERROR";
+        for (const auto& write : it->second.writes) {
+            lockedKeys.erase(write.key);
+        }
+        prepared.erase(it);
+        savePreparedLocked();
+        return "OK";
+    }
+    return "ERROR";
+}
+
+// 键被其他未决事务锁住，或当前值与期望值不符，都视为冲突
+bool ShardServer::validateLocked(const std::vector<ShardWrite>& writes) {
+    for (const auto& write : writes) {
+        if (lockedKeys.count(write.key)) return false;
+        if (write.checkExpected && data.get(write.key) != write.expected) return false;
+    }
+    return true;
+}
+
+// 日志记录fsync后即已落盘（请求结果与修改在同一条记录里），之后才改内存；
+// 检查点失败不影响这次写入，日志留到下次再压缩
+bool ShardServer::applyLocked(const std::vector<ShardWrite>& writes, const std::string& requestId,
+    const RequestResult& result) {
+    TransactionRecord record{ requestId, result, unixTimeNow(), ChangeBatch() };
+    for (const auto& write : writes) {
+        record.changes.emplace_back(write.key, write.value);
+    }
+    if (!txLog.append(record)) return false;
+    for (const auto& write : writes) {
+        data.set(write.key, write.value);
+    }
+    if (!requestId.empty()) {
+        dedup.insert(requestId, record.committedAt, result);
+    }
+    if (txLog.size() > SHARD_CHECKPOINT_BYTES) {
+        checkpointLocked();
+    }
+    return true;
+}
+
+// 数据文件落盘后日志只留去重窗口内的请求结果；中途崩溃时按日志重放，修改都是整值覆盖，结果不变
+bool ShardServer::checkpointLocked() {
+    return saveAccountData(data, dataFile) && txLog.compact(unixTimeNow() - dedup.window()) &&
+        syncParentDirectory(dataFile);
+}
+
+bool ShardServer::savePreparedLocked() {
+    std::string content;
+    for (const auto& tx : prepared) {
+        content += "T " + tx.first + " " + std::to_string(tx.second.writes.size()) +
+            encodeShardRequest(tx.second.requestId, tx.second.result) + "\n";
+        content += encodeShardWrites(tx.second.writes);
+    }
+    return writeFileDurably(dataFile + ".prepared", content);
+}
+
+void ShardServer::loadPrepared() {
+    std::ifstream file(dataFile + ".prepared");
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string tag, txid;
+        size_t count = 0;
+        in >> tag >> txid >> count;
+        if (tag != "T") continue;
+        PreparedTransaction tx{ {}, "", RequestResult{ REQUEST_NONE, 0 } };
+        if (!(in >> tx.requestId >> tx.result.kind >> tx.result.amount)) tx.requestId.clear();
+        for (size_t i = 0; i < count && std::getline(file, line); i++) {
+            ShardWrite write;
+            if (parseShardWrite(line, write)) tx.writes.push_back(write);
+        }
+        for (const auto& write : tx.writes) {
+            lockedKeys[write.key] = txid;
+        }
+        prepared[txid] = tx;
+    }
+}
+
+// 追加一条决定并fsync；记录超过上限的两倍时只保留最近的一半重写文件
+bool ShardServer::recordDecisionLocked(const std::string& txid, bool commitDecision) {
+    std::string record = (commitDecision ? "C " : "A ") + txid + "\n";
+    if (::write(decidedFd, record.data(), record.size()) != (ssize_t)record.size() || ::fsync(decidedFd) != 0) {
+        return false;
+    }
+    decided[txid] = commitDecision;
+    decidedOrder.push_back(txid);
+    if (decidedOrder.size() <= 2 * SHARD_DECIDED_KEEP) return true;
+
+    while (decidedOrder.size() > SHARD_DECIDED_KEEP) {
+        decided.erase(decidedOrder.front());
+        decidedOrder.pop_front();
+    }
+    std::string content;
+    for (const auto& kept : decidedOrder) {
+        content += (decided[kept] ? "C " : "A ") + kept + "\n";
+    }
+    std::string path = dataFile + ".decided";
+    if (!writeFileDurably(path, content)) return true;
+    int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd >= 0) {
+        ::close(decidedFd);
+        decidedFd = fd;
+    }
+    return true;
+}
+
+// 重启时读回已决定的事务。决定在数据落盘后、删除准备记录前写入，
+// 两者之间崩溃留下的准备记录已经生效（或已回滚），直接去掉
+void ShardServer::loadDecided() {
+    std::ifstream file(dataFile + ".decided");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() < 3 || (line[0] != 'C' && line[0] != 'A') || line[1] != ' ') continue;
+        std::string txid = line.substr(2);
+        if (!decided.count(txid)) decidedOrder.push_back(txid);
+        decided[txid] = line[0] == 'C';
+    }
+    bool stale = false;
+    for (auto it = prepared.begin(); it != prepared.end();) {
+        if (!decided.count(it->first)) {
+            ++it;
+            continue;
+        }
+        for (const auto& write : it->second.writes) {
+            lockedKeys.erase(write.key);
+        }
+        it = prepared.erase(it);
+        stale = true;
+    }
+    if (stale) savePreparedLocked();
+}
+
+// ---------------- ShardedAccountStore ----------------
+
+ShardedAccountStore::ShardedAccountStore(const std::vector<std::string>& shardSockets,
+    const std::string& coordinatorLog) :
+    coordinatorLog(coordinatorLog),
+    logFd(-1),
+    txCounter(0),
+    dedup(1 << 20, 3600) {
+    for (const auto& path : shardSockets) {
+        shards.push_back({ path, -1, "" });
+    }
+}
+
+ShardedAccountStore::~ShardedAccountStore() {
+    for (auto& shard : shards) {
+        if (shard.fd >= 0) ::close(shard.fd);
+    }
+    if (logFd >= 0) ::close(logFd);
+}
+
+// 接手第一个能加上flock的槽位作为自己的日志；之后的槽位里能加锁的都是无主的，恢复完即释放。
+// 锁随进程退出或崩溃自动释放，所以下一个启动的协调者总能接手崩溃者留下的未决事务
+bool ShardedAccountStore::load() {
+    for (size_t slot = 0; ; slot++) {
+        std::string path = coordinatorLogSlot(coordinatorLog, slot);
+        bool own = logFd < 0;
+        int fd = ::open(path.c_str(), own ? O_WRONLY | O_CREAT | O_APPEND : O_WRONLY | O_APPEND, 0644);
+        if (fd < 0) {
+            // 槽位从0号起依次创建且不删除，第一个不存在的槽位之后就没有了
+            if (own) return false;
+            break;
+        }
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            ::close(fd);
+            continue;
+        }
+        if (own) {
+            logFd = fd;
+            if (!recover(path, fd)) return false;
+            continue;
+        }
+        recover(path, fd);
+        ::close(fd);
+    }
+    return true;
+}
+
+size_t ShardedAccountStore::shardOf(const std::string& key) const {
+    return hashKey(accountOfKey(key)) % shards.size();
+}
+
+// 每个分片一条长连接，出错时重连一次再重试
+bool ShardedAccountStore::request(size_t shard, const std::string& payload, std::string& reply) {
+    ShardConnection& connection = shards[shard];
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (connection.fd < 0) {
+            connection.fd = socketConnect(connection.path);
+            connection.buffer.clear();
+            if (connection.fd < 0) continue;
+        }
+        if (socketWriteAll(connection.fd, payload) &&
+            socketReadLine(connection.fd, connection.buffer, reply)) {
+            return true;
+        }
+        ::close(connection.fd);
+        connection.fd = -1;
+    }
+    return false;
+}
+
+bool ShardedAccountStore::lookup(size_t shard, const std::string& command, std::string& value) {
+    std::string reply;
+    if (!request(shard, command + "\n", reply) || reply.size() < 2 || reply[0] != 'V') {
+        return false;
+    }
+    value = reply.substr(2);
+    return true;
+}
+
+std::string ShardedAccountStore::get(const std::string& key) {
+    std::string value;
+    lookup(shardOf(key), "GET " + key, value);
+    readSet[key] = value;
+    return value;
+}
+
+bool ShardedAccountStore::hasKey(const std::string& key) {
+    std::string value;
+    return lookup(shardOf(key), "GET " + key, value);
+}
+
+std::string ShardedAccountStore::findAccountByIdCard(const std::string& idCard) {
+    for (size_t i = 0; i < shards.size(); i++) {
+        std::string account;
+        if (lookup(i, "FIND " + idCard, account)) return account;
+    }
+    return "";
+}
+
+// 以本批次之前读到的值作为期望值，分片上值已变化则提交失败
+bool ShardedAccountStore::commit(const ChangeBatch& changes, const std::string& requestId,
+    const RequestResult& result) {
+    retryUnresolved();
+
+    std::map<size_t, std::vector<ShardWrite>> writes;
+    for (const auto& change : changes) {
+        auto read = readSet.find(change.first);
+        ShardWrite write;
+        write.key = change.first;
+        write.checkExpected = read != readSet.end();
+        write.expected = write.checkExpected ? read->second : "";
+        write.value = change.second;
+        writes[shardOf(change.first)].push_back(write);
+    }
+    readSet.clear();
+
+    // 请求ID随写入交给分片持久化；重发的APPLY或已生效过的请求由分片识别，不会执行两次
+    std::string requestText = encodeShardRequest(requestId, result);
+    bool committed = true;
+    if (writes.size() == 1) {
+        auto& only = *writes.begin();
+        std::string reply;
+        committed = request(only.first, "APPLY " + std::to_string(only.second.size()) + requestText + "\n" +
+            encodeShardWrites(only.second), reply) && reply == "OK";
+    }
+    else if (writes.size() > 1) {
+        committed = twoPhaseCommit(writes, requestText);
+    }
+    if (committed && !requestId.empty()) {
+        dedup.insert(requestId, unixTimeNow(), result);
+    }
+    return committed;
+}
+
+// 本地缓存查不到时逐个询问分片：协调者重启过，或上次提交没收到应答，结果都只在分片上
+bool ShardedAccountStore::lookupRequest(const std::string& requestId, RequestResult& result) {
+    int64_t now = unixTimeNow();
+    if (dedup.lookup(requestId, now, result)) return true;
+    for (size_t shard = 0; shard < shards.size(); shard++) {
+        std::string reply;
+        if (!request(shard, "REQUEST " + requestId + "\n", reply) || reply.size() < 2 || reply[0] != 'R') continue;
+        std::istringstream in(reply.substr(2));
+        if (!(in >> result.kind >> result.amount)) continue;
+        dedup.insert(requestId, now, result);
+        return true;
+    }
+    return false;
+}
+
+void ShardedAccountStore::retryUnresolved() {
+    for (auto* pending : { &unresolvedCommits, &unresolvedAborts }) {
+        bool commitDecision = pending == &unresolvedCommits;
+        for (auto it = pending->begin(); it != pending->end();) {
+            if (finish(it->first, it->second, commitDecision, logFd)) {
+                it = pending->erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+}
+
+// 某个分片应答DUPLICATE时这个请求早已提交过（提交时每个参与分片都记下了请求），
+// 本次事务回滚，对调用方按已生效返回
+bool ShardedAccountStore::twoPhaseCommit(const std::map<size_t, std::vector<ShardWrite>>& writes,
+    const std::string& requestText) {
+    std::string txid = newTransactionId();
+    std::set<size_t> participants;
+    std::string shardList;
+    for (const auto& entry : writes) {
+        participants.insert(entry.first);
+        shardList += (shardList.empty() ? "" : ",") + std::to_string(entry.first);
+    }
+    if (!appendLog(logFd, "BEGIN " + txid + " " + shardList)) return false;
+
+    // 第一阶段：所有参与分片持久化准备记录并锁住相关键
+    bool allPrepared = true;
+    bool duplicate = false;
+    for (const auto& entry : writes) {
+        std::string reply;
+        if (!request(entry.first, "PREPARE " + txid + " " + std::to_string(entry.second.size()) + requestText + "\n" +
+            encodeShardWrites(entry.second), reply) || reply != "OK") {
+            allPrepared = false;
+            duplicate = reply == "DUPLICATE";
+            break;
+        }
+    }
+    faultPoint("coordinator_after_prepare");
+
+    // 决定落盘即为提交点；此后即使崩溃，恢复时也会重发COMMIT
+    if (!appendLog(logFd, (allPrepared ? "COMMIT " : "ABORT ") + txid)) {
+        allPrepared = false;
+    }
+    faultPoint("coordinator_after_decision");
+
+    if (!finish(txid, participants, allPrepared, logFd)) {
+        (allPrepared ? unresolvedCommits : unresolvedAborts)[txid] = participants;
+    }
+    return allPrepared || duplicate;
+}
+
+// 所有参与分片都应答OK后在fd所指的日志里记END
+bool ShardedAccountStore::finish(const std::string& txid, const std::set<size_t>& participants,
+    bool commitDecision, int fd) {
+    bool done = true;
+    for (size_t shard : participants) {
+        std::string reply;
+        if (!request(shard, (commitDecision ? "COMMIT " : "ABORT ") + txid + "\n", reply) || reply != "OK") {
+            done = false;
+        }
+        faultPoint("coordinator_mid_finish");
+    }
+    if (done) appendLog(fd, "END " + txid);
+    return done;
+}
+
+// 重放一个已加锁的日志槽位：有COMMIT记录的事务重发COMMIT，其余未结束的事务一律ABORT。
+// 自己槽位里没能送达的决定留在unresolvedCommits/unresolvedAborts里随后续提交重试；
+// 无主槽位里的则原样留在那个槽位，由下一个接手的协调者再试
+bool ShardedAccountStore::recover(const std::string& path, int fd) {
+    std::ifstream file(path);
+    std::map<std::string, std::set<size_t>> open;
+    std::set<std::string> committed;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string tag, txid, shardList;
+        in >> tag >> txid >> shardList;
+        if (tag == "BEGIN") {
+            std::istringstream list(shardList);
+            std::string shard;
+            while (std::getline(list, shard, ',')) {
+                size_t index = std::stoul(shard);
+                if (index < shards.size()) open[txid].insert(index);
+            }
+        }
+        else if (tag == "COMMIT") {
+            committed.insert(txid);
+        }
+        else if (tag == "END") {
+            open.erase(txid);
+            committed.erase(txid);
+        }
+    }
+
+    bool allResolved = true;
+    for (const auto& tx : open) {
+        bool commitDecision = committed.count(tx.first) > 0;
+        if (!commitDecision) appendLog(fd, "ABORT " + tx.first);
+        if (!finish(tx.first, tx.second, commitDecision, fd)) {
+            allResolved = false;
+            if (fd == logFd) (commitDecision ? unresolvedCommits : unresolvedAborts)[tx.first] = tx.second;
+        }
+    }
+
+    // 槽位里的事务全部结束时截断，避免无限增长；槽位由本进程持锁，不会截掉别人的记录
+    if (allResolved && ::ftruncate(fd, 0) != 0) {
+        return false;
+    }
+    return true;
+}
+
+bool ShardedAccountStore::appendLog(int fd, const std::string& line) {
+    std::string record = line + "\n";
+    return ::write(fd, record.data(), record.size()) == (ssize_t)record.size() && ::fsync(fd) == 0;
+}
+
+std::string ShardedAccountStore::newTransactionId() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::to_string(::getpid()) + "-" +
+        std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(now).count()) + "-" +
+        std::to_string(++txCounter);
+}
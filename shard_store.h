@@ -0,0 +1,134 @@
+#ifndef SHARD_STORE_H
+#define SHARD_STORE_H
+
+#include "account_store.h"
+#include "transaction_log.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// 分片上的一次写入。checkExpected为true时要求当前值等于expected（乐观并发控制）
+struct ShardWrite {
+    std::string key;
+    bool checkExpected;
+    std::string expected;
+    std::string value;
+};
+
+// 分片进程：持有一段账户空间的数据文件，参与两阶段提交。
+// 与单机存储一样，写入先追加到 <数据文件>.txlog 并fsync，日志超过阈值时才重写数据文件。
+// 已准备（prepared）的事务写入 <数据文件>.prepared 并fsync，崩溃重启后仍锁住相关键，
+// 直到协调者发来COMMIT或ABORT。已决定的事务追加到 <数据文件>.decided（C/A txid）并fsync，
+// 协调者重发的决定按它应答：重复的COMMIT返回OK，没有准备过或已回滚的事务收到COMMIT返回ERROR，
+// 不会把一笔另一半已经生效的转账当作成功。没准备过的事务收到ABORT时也记为已回滚，迟到的PREPARE一律冲突。
+// 携带请求ID的写入把请求结果记在同一条事务日志记录里，与修改一同落盘；重启时重放日志恢复去重窗口内的结果，
+// 协调者没收到应答而重发的APPLY直接应答OK，不会再执行一次。
+// 协议（按行），[请求] 为可选的 "请求ID 种类 金额"：
+//   GET key | FIND idcard                       -> V value | N
+//   APPLY n [请求]        + n行写入              -> OK | CONFLICT   单分片直接提交
+//   PREPARE txid n [请求] + n行写入              -> OK | CONFLICT | DUPLICATE（请求已生效过）
+//   COMMIT txid                                 -> OK | ERROR
+//   ABORT txid                                  -> OK | ERROR       已提交的事务不能回滚
+//   REQUEST 请求ID                               -> R 种类 金额 | N
+// 写入行格式：key\t<0|1>\texpected\tvalue
+class ShardServer {
+public:
+    ShardServer(const std::string& socketPath, const std::string& dataFile);
+
+    bool run();
+    void stop();
+
+private:
+    // 已准备的事务：写入和发起它的请求（请求ID为空表示不去重）
+    struct PreparedTransaction {
+        std::vector<ShardWrite> writes;
+        std::string requestId;
+        RequestResult result;
+    };
+
+    void serveConnection(int fd);
+    std::string handleCommand(const std::string& verb, const std::string& arg,
+        const std::vector<ShardWrite>& writes, const std::string& requestId, const RequestResult& result);
+    bool validateLocked(const std::vector<ShardWrite>& writes);
+    bool applyLocked(const std::vector<ShardWrite>& writes, const std::string& requestId, const RequestResult& result);
+    bool checkpointLocked();
+    bool savePreparedLocked();
+    void loadPrepared();
+    bool recordDecisionLocked(const std::string& txid, bool commitDecision);
+    void loadDecided();
+
+    std::string socketPath;
+    std::string dataFile;
+    SimpleJson data;
+    TransactionLog txLog;
+    DedupCache dedup;
+    std::map<std::string, PreparedTransaction> prepared;
+    std::map<std::string, std::string> lockedKeys;
+    // 最近已决定的事务（true为提交），decidedOrder按决定先后排列，用于淘汰最早的记录
+    std::map<std::string, bool> decided;
+    std::deque<std::string> decidedOrder;
+    int decidedFd;
+    std::mutex mutex;
+    int listenFd;
+    std::atomic<bool> running;
+};
+
+// 按账号哈希把请求路由到各分片的存储。
+// 跨分片的提交走两阶段提交，协调者的决定写入恢复日志：
+//   BEGIN txid s1,s2   COMMIT txid   ABORT txid   END txid
+// 多个终端可以共用同一个 --coordinator-log：每个协调者用flock独占一个槽位，0号是文件本身，
+// 其余为 <文件>.1、<文件>.2 ……，只写自己的槽位。启动时接手第一个空闲槽位，并顺带恢复其他无主的槽位
+// （上一任已退出或崩溃），未结束的事务按日志中的决定重做（没有COMMIT记录的一律回滚）；
+// 仍被其他协调者持有的槽位一律不碰，槽位里的事务全部结束后才截断。
+// 请求结果随写入持久化在分片上；lookupRequest()先查协调者本地的缓存，查不到再逐个询问分片。
+class ShardedAccountStore : public AccountStore {
+public:
+    ShardedAccountStore(const std::vector<std::string>& shardSockets, const std::string& coordinatorLog);
+    ~ShardedAccountStore();
+
+    bool load() override;
+    std::string get(const std::string& key) override;
+    bool hasKey(const std::string& key) override;
+    std::string findAccountByIdCard(const std::string& idCard) override;
+    bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) override;
+    bool lookupRequest(const std::string& requestId, RequestResult& result) override;
+
+    size_t shardOf(const std::string& key) const;
+
+private:
+    struct ShardConnection {
+        std::string path;
+        int fd;
+        std::string buffer;
+    };
+
+    bool request(size_t shard, const std::string& payload, std::string& reply);
+    bool lookup(size_t shard, const std::string& command, std::string& value);
+    bool twoPhaseCommit(const std::map<size_t, std::vector<ShardWrite>>& writes,
+        const std::string& requestText);
+    void retryUnresolved();
+    bool finish(const std::string& txid, const std::set<size_t>& participants, bool commitDecision, int fd);
+    bool recover(const std::string& path, int fd);
+    bool appendLog(int fd, const std::string& line);
+    std::string newTransactionId();
+
+    std::vector<ShardConnection> shards;
+    std::string coordinatorLog;
+    int logFd;
+    uint64_t txCounter;
+    std::map<std::string, std::string> readSet;
+    // 决定已落盘、但还没送到所有参与分片的事务，随后续提交重发；回滚送不到时分片上的键一直被锁着
+    std::map<std::string, std::set<size_t>> unresolvedCommits;
+    std::map<std::string, std::set<size_t>> unresolvedAborts;
+    // 已确认的请求结果的本地缓存，权威记录在分片上
+    DedupCache dedup;
+};
+
+std::string encodeShardWrites(const std::vector<ShardWrite>& writes);
+
+#endif
@@ -0,0 +1,424 @@
+#include "shm_account_store.h"
+#include "columnar_snapshot.h"
+#include "durable_file.h"
+#include "fault_injection.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <thread>
+
+static const char SHM_MAGIC[4] = { 'A', 'T', 'M', 'S' };
+static const uint32_t SHM_VERSION = 1;
+
+// 段头。重做区：提交时先写入本批所有账户记录的新值与槽位，pendingCount置位后才改表，
+// 改完清零；持锁进程中途崩溃时由下一个加锁的进程按重做区补完。
+struct ShmHeader {
+    char magic[4];
+    uint32_t version;
+    std::atomic<uint32_t> ready;
+    uint32_t pendingCount;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t commitSequence;
+    uint64_t checkpointSequence;
+    uint64_t logGeneration;
+    uint64_t pendingAccountCount;
+    pthread_mutex_t mutex;
+    uint64_t pendingSlots[ShmAccountStore::MAX_BATCH_ACCOUNTS];
+    AccountRecord pending[ShmAccountStore::MAX_BATCH_ACCOUNTS];
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ready flag must be lock-free to live in shared memory");
+
+static size_t tableOffset() {
+    return (sizeof(ShmHeader) + 127) / 128 * 128;
+}
+
+static std::string segmentPath(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+static uint64_t accountHash(uint64_t account) {
+    return (account * 0x9E3779B97F4A7C15ULL) >> 20;
+}
+
+ShmAccountStore::ShmAccountStore(const std::string& segmentName, const std::string& dataFile, size_t minCapacity) :
+    segmentName(segmentPath(segmentName)),
+    dataFile(dataFile),
+    minCapacity(minCapacity),
+    header(nullptr),
+    table(nullptr),
+    mappedBytes(0),
+    logGeneration(0),
+    dedup(1 << 20, 3600),
+    conflicts(0) {
+}
+
+ShmAccountStore::~ShmAccountStore() {
+    if (header) ::munmap(header, mappedBytes);
+}
+
+bool ShmAccountStore::removeSegment(const std::string& segmentName) {
+    return ::shm_unlink(segmentPath(segmentName).c_str()) == 0;
+}
+
+// 段已存在就直接映射；不存在时由从文件建段成功的那个进程初始化，其余进程等它完成后映射
+bool ShmAccountStore::load() {
+    if (header) return true;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        if (attach()) return true;
+        if (errno != ENOENT) return false;
+
+        std::vector<AccountRecord> records;
+        if (!loadRecords(records)) return false;
+        uint64_t capacity = 1024;
+        while (capacity < minCapacity || capacity < records.size() * 2) {
+            capacity *= 2;
+        }
+        if (create(tableOffset() + capacity * sizeof(AccountRecord), records, capacity)) return true;
+        if (errno != EEXIST) return false;
+    }
+    return false;
+}
+
+// 数据文件 + 上次检查点轮换出的日志 + 当前日志，按顺序重放
+bool ShmAccountStore::loadRecords(std::vector<AccountRecord>& records) {
+    std::map<std::string, std::string> data;
+    loadAccountData(dataFile, data);
+
+    std::map<uint64_t, AccountRecord> byAccount;
+    for (const auto& pair : data) {
+        uint64_t account;
+        std::string field;
+        if (!splitAccountKey(pair.first, account, field)) continue;
+        auto inserted = byAccount.emplace(account, AccountRecord());
+        if (inserted.second) {
+            std::memset(&inserted.first->second, 0, sizeof(AccountRecord));
+            inserted.first->second.account = account;
+        }
+        setAccountField(inserted.first->second, field, pair.second);
+    }
+    records.reserve(byAccount.size());
+    for (const auto& entry : byAccount) {
+        records.push_back(entry.second);
+    }
+    return true;
+}
+
+bool ShmAccountStore::create(size_t segmentBytes, const std::vector<AccountRecord>& records, uint64_t capacity) {
+    int fd = ::shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return false;
+    void* memory = MAP_FAILED;
+    if (::ftruncate(fd, segmentBytes) == 0) {
+        memory = ::mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        ::shm_unlink(segmentName.c_str());
+        errno = ENOMEM;
+        return false;
+    }
+
+    // ftruncate出来的段全为0，账号0即空槽
+    header = new (memory) ShmHeader;
+    mappedBytes = segmentBytes;
+    table = (AccountRecord*)((char*)memory + tableOffset());
+    std::memcpy(header->magic, SHM_MAGIC, 4);
+    header->version = SHM_VERSION;
+    header->capacity = capacity;
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    for (const auto& record : records) {
+        *slotFor(record.account) = record;
+    }
+    header->count = records.size();
+    header->ready.store(1, std::memory_order_release);
+    return true;
+}
+
+// 建段进程可能还没ftruncate或初始化完，最多等5秒
+bool ShmAccountStore::attach() {
+    int fd = ::shm_open(segmentName.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    struct stat info;
+    while (::fstat(fd, &info) == 0 && (size_t)info.st_size < tableOffset() &&
+        std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    void* memory = (size_t)info.st_size >= tableOffset() ?
+        ::mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        errno = EINVAL;
+        return false;
+    }
+
+    ShmHeader* mapped = (ShmHeader*)memory;
+    while (!mapped->ready.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!mapped->ready.load(std::memory_order_acquire) || std::memcmp(mapped->magic, SHM_MAGIC, 4) != 0 ||
+        mapped->version != SHM_VERSION || tableOffset() + mapped->capacity * sizeof(AccountRecord) > (size_t)info.st_size) {
+        ::munmap(memory, info.st_size);
+        errno = EINVAL;
+        return false;
+    }
+    header = mapped;
+    mappedBytes = info.st_size;
+    table = (AccountRecord*)((char*)memory + tableOffset());
+    return true;
+}
+
+bool ShmAccountStore::lock() {
+    if (!header) return false;
+    int rc = pthread_mutex_lock(&header->mutex);
+    if (rc == EOWNERDEAD) {
+        replayPendingLocked();
+        pthread_mutex_consistent(&header->mutex);
+        return true;
+    }
+    return rc == 0;
+}
+
+void ShmAccountStore::unlock() {
+    pthread_mutex_unlock(&header->mutex);
+}
+
+// 重做区里是整条记录的新值，重复执行结果相同
+void ShmAccountStore::replayPendingLocked() {
+    if (header->pendingCount == 0) return;
+    for (uint32_t i = 0; i < header->pendingCount; i++) {
+        table[header->pendingSlots[i]] = header->pending[i];
+        if (i == 0 && header->pendingCount > 1) faultPoint("shm_mid_apply");
+    }
+    header->count = header->pendingAccountCount;
+    header->commitSequence++;
+    header->pendingCount = 0;
+}
+
+AccountRecord* ShmAccountStore::findLocked(uint64_t account) {
+    uint64_t mask = header->capacity - 1;
+    for (uint64_t i = accountHash(account);; i++) {
+        AccountRecord& slot = table[i & mask];
+        if (slot.account == account) return &slot;
+        if (slot.account == 0) return nullptr;
+    }
+}
+
+// 账户所在的槽位，不存在时返回探测到的第一个空槽（表不会被填满，见commit中的容量检查）
+AccountRecord* ShmAccountStore::slotFor(uint64_t account) {
+    uint64_t mask = header->capacity - 1;
+    for (uint64_t i = accountHash(account);; i++) {
+        AccountRecord& slot = table[i & mask];
+        if (slot.account == account || slot.account == 0) return &slot;
+    }
+}
+
+std::string ShmAccountStore::get(const std::string& key) {
+    uint64_t account;
+    std::string field;
+    if (!splitAccountKey(key, account, field) || !lock()) return "";
+    const AccountRecord* record = findLocked(account);
+    std::string value = record ? getAccountField(*record, field) : "";
+    unlock();
+    readSet[key] = value;
+    return value;
+}
+
+bool ShmAccountStore::hasKey(const std::string& key) {
+    uint64_t account;
+    std::string field;
+    if (!splitAccountKey(key, account, field) || !lock()) return false;
+    const AccountRecord* record = findLocked(account);
+    bool exists = record && hasAccountField(*record, field);
+    unlock();
+    return exists;
+}
+
+std::string ShmAccountStore::findAccountByIdCard(const std::string& idCard) {
+    if (!lock()) return "";
+    std::string account;
+    for (uint64_t i = 0; i < header->capacity; i++) {
+        if (table[i].account != 0 && idCard == table[i].idCard) {
+            char buffer[24];
+            std::snprintf(buffer, sizeof(buffer), "%019llu", (unsigned long long)table[i].account);
+            account = buffer;
+            break;
+        }
+    }
+    unlock();
+    return account;
+}
+
+bool ShmAccountStore::reopenLogLocked() {
+    if (txLog && logGeneration == header->logGeneration) return true;
+    txLog.reset(new TransactionLog(dataFile + ".txlog"));
+    logGeneration = header->logGeneration;
+    if (!txLog->open()) {
+        txLog.reset();
+        return false;
+    }
+    return true;
+}
+
+// 以本批次之前读到的值作为期望值，段里的值已被其他进程改掉则提交失败
+bool ShmAccountStore::commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) {
+    std::map<std::string, std::string> expected;
+    expected.swap(readSet);
+    if (!lock()) return false;
+
+    std::map<uint64_t, AccountRecord> updated;
+    bool ok = true;
+    for (const auto& change : changes) {
+        uint64_t account;
+        std::string field;
+        if (!splitAccountKey(change.first, account, field)) {
+            ok = false;
+            break;
+        }
+        auto it = updated.find(account);
+        if (it == updated.end()) {
+            const AccountRecord* existing = findLocked(account);
+            AccountRecord record;
+            std::memset(&record, 0, sizeof(record));
+            record.account = account;
+            if (existing) record = *existing;
+            it = updated.emplace(account, record).first;
+        }
+        auto read = expected.find(change.first);
+        if (read != expected.end() && getAccountField(it->second, field) != read->second) {
+            conflicts++;
+            ok = false;
+            break;
+        }
+        if (!setAccountField(it->second, field, change.second)) {
+            ok = false;
+            break;
+        }
+    }
+
+    // 新账户不能让装载率超过3/4，保证探测总能遇到空槽
+    uint64_t accounts = header->count;
+    for (const auto& entry : updated) {
+        if (!findLocked(entry.first)) accounts++;
+    }
+    ok = ok && updated.size() <= MAX_BATCH_ACCOUNTS && accounts <= header->capacity / 4 * 3;
+
+    TransactionRecord record{ requestId, result, unixTimeNow(), changes };
+    ok = ok && (changes.empty() || (reopenLogLocked() && txLog->append(record)));
+    if (ok && !updated.empty()) {
+        uint32_t count = 0;
+        for (const auto& entry : updated) {
+            // 同一批的多个新账户不能落进同一个空槽
+            uint64_t mask = header->capacity - 1;
+            uint64_t slot = accountHash(entry.first);
+            for (;; slot++) {
+                const AccountRecord& candidate = table[slot & mask];
+                if (candidate.account == entry.first) break;
+                if (candidate.account == 0 && std::find(header->pendingSlots, header->pendingSlots + count, slot & mask) ==
+                    header->pendingSlots + count) break;
+            }
+            header->pendingSlots[count] = slot & mask;
+            header->pending[count] = entry.second;
+            count++;
+        }
+        header->pendingAccountCount = accounts;
+        header->pendingCount = count;
+        replayPendingLocked();
+    }
+    unlock();
+
+    if (ok && !requestId.empty()) {
+        dedup.insert(requestId, record.committedAt, result);
+    }
+    return ok;
+}
+
+bool ShmAccountStore::lookupRequest(const std::string& requestId, RequestResult& result) {
+    return dedup.lookup(requestId, unixTimeNow(), result);
+}
+
+uint64_t ShmAccountStore::commitCount() {
+    if (!lock()) return 0;
+    uint64_t sequence = header->commitSequence;
+    unlock();
+    return sequence;
+}
+
+uint64_t ShmAccountStore::accountCount() {
+    if (!lock()) return 0;
+    uint64_t count = header->count;
+    unlock();
+    return count;
+}
+
+// 锁内只复制记录并轮换日志，写文件在锁外进行，不阻塞其他进程的提交。
+// 上一次检查点失败时留下的旧日志还在，这次就不轮换：两份日志按顺序重放的结果相同。
+bool ShmAccountStore::checkpoint() {
+    if (!lock()) return false;
+    if (header->commitSequence == header->checkpointSequence) {
+        unlock();
+        return true;
+    }
+    uint64_t sequence = header->commitSequence;
+    std::vector<AccountRecord> records;
+    records.reserve(header->count);
+    for (uint64_t i = 0; i < header->capacity; i++) {
+        if (table[i].account != 0) records.push_back(table[i]);
+    }
+    std::string logFile = dataFile + ".txlog";
+    std::string rotated = logFile + ".checkpoint";
+    if (::access(rotated.c_str(), F_OK) != 0 && std::rename(logFile.c_str(), rotated.c_str()) == 0) {
+        header->logGeneration++;
+    }
+    unlock();
+
+    static const char* fields[] = { "_password", "_balance", "_daily_withdrawal", "_locked", "_locked_until", "_idcard", "_name" };
+    std::map<std::string, std::string> data;
+    for (const auto& record : records) {
+        char account[24];
+        std::snprintf(account, sizeof(account), "%019llu", (unsigned long long)record.account);
+        for (const char* field : fields) {
+            if (std::strcmp(field, "_locked_until") == 0 && record.lockedUntil == 0) continue;
+            data.emplace_hint(data.end(), std::string(account) + field, getAccountField(record, field));
+        }
+    }
+
+    bool ok;
+    if (isColumnarSnapshotFile(dataFile)) {
+        ok = saveColumnarSnapshot(data, dataFile, columnarCompressionAvailable());
+    }
+    else {
+        SimpleJson json;
+        for (const auto& pair : data) {
+            json.set(pair.first, pair.second);
+        }
+        std::string tmp = dataFile + ".tmp";
+        ok = json.saveToFile(tmp) && replaceFileDurably(tmp, dataFile);
+    }
+    // 数据文件连同目录项都落盘后，轮换出的日志才可以删除
+    if (!ok) return false;
+    std::remove(rotated.c_str());
+
+    if (!lock()) return false;
+    if (header->checkpointSequence < sequence) header->checkpointSequence = sequence;
+    unlock();
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef SHM_ACCOUNT_STORE_H
+#define SHM_ACCOUNT_STORE_H
+
+#include "account_store.h"
+#include "lazy_account_store.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+struct ShmHeader;
+
+// 同一台机器上多个ATM进程共用的存储：账户记录（与 .idx 相同的128字节定长记录）放在
+// POSIX共享内存段的开放寻址表里，任何进程提交后其他进程立即可见，不再各自读写数据文件。
+// 段头里的互斥锁是进程间共享的robust锁：持锁进程崩溃后，下一个加锁的进程收到EOWNERDEAD，
+// 先重放段头重做区里未写完的记录再继续，一次提交要么全部可见要么全部不可见。
+// 与分片存储一样做乐观并发控制：提交时检查本进程上次读到的值是否已被其他进程改掉，
+// 被改掉则提交失败，由调用方重新读取后重试，不会出现后写覆盖先写的丢失更新。
+// 每次提交先在锁内追加共用的事务日志 <数据文件>.txlog；数据文件只由检查点（atm_shm persist）重写。
+// 第一个打开段的进程从数据文件（JSON或.snap）和事务日志建段，之后的进程直接映射。
+// 请求ID含终端号（进程号+启动时间），重复请求只会来自同一进程，去重表留在进程内。
+// 账户随时可能由其他进程开户，不提供前缀计数（进程内的索引会过时，扫描全表又要长时间持有共享锁）。
+class ShmAccountStore : public AccountStore {
+public:
+    ShmAccountStore(const std::string& segmentName, const std::string& dataFile, size_t minCapacity = 0);
+    ~ShmAccountStore();
+
+    bool load() override;
+    std::string get(const std::string& key) override;
+    bool hasKey(const std::string& key) override;
+    std::string findAccountByIdCard(const std::string& idCard) override;
+    bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) override;
+    bool lookupRequest(const std::string& requestId, RequestResult& result) override;
+
+    // 有新的提交时把整个段写回数据文件，随后删除已落盘的事务日志；没有新提交返回true且不写文件
+    bool checkpoint();
+    uint64_t commitCount();
+    uint64_t accountCount();
+    uint64_t conflictCount() const { return conflicts; }
+
+    static bool removeSegment(const std::string& segmentName);
+
+    static const size_t MAX_BATCH_ACCOUNTS = 16;
+
+private:
+    bool create(size_t segmentBytes, const std::vector<AccountRecord>& records, uint64_t capacity);
+    bool attach();
+    bool loadRecords(std::vector<AccountRecord>& records);
+    bool lock();
+    void unlock();
+    void replayPendingLocked();
+    AccountRecord* findLocked(uint64_t account);
+    AccountRecord* slotFor(uint64_t account);
+    bool reopenLogLocked();
+
+    std::string segmentName;
+    std::string dataFile;
+    size_t minCapacity;
+    ShmHeader* header;
+    AccountRecord* table;
+    size_t mappedBytes;
+    uint64_t logGeneration;
+    std::unique_ptr<TransactionLog> txLog;
+    std::map<std::string, std::string> readSet;
+    DedupCache dedup;
+    uint64_t conflicts;
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "shm_account_store.h"
+#include "limit_rules.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <thread>
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 持久化进程：按间隔把共享内存段写回数据文件，收到SIGINT/SIGTERM时做完最后一次检查点再退出
+static int runPersist(const std::string& segment, const std::string& dataFile, int intervalMs) {
+    ShmAccountStore store(segment, dataFile);
+    if (!store.load()) {
+        std::cerr << "无法打开共享内存段: " << segment << std::endl;
+        return 1;
+    }
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::printf("共享内存段 %s，%llu 个账户，每 %d ms 检查点写回 %s\n", segment.c_str(),
+        (unsigned long long)store.accountCount(), intervalMs, dataFile.c_str());
+
+    uint64_t persisted = store.commitCount();
+    bool ok = true;
+    while (ok) {
+        bool last = stopRequested;
+        uint64_t commits = store.commitCount();
+        if (commits != persisted) {
+            auto start = std::chrono::steady_clock::now();
+            ok = store.checkpoint();
+            std::printf("检查点: 提交序号 %llu，耗时 %.1f ms%s\n", (unsigned long long)commits, elapsedMs(start),
+                ok ? "" : "，写入失败");
+            std::fflush(stdout);
+            persisted = commits;
+        }
+        if (last) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+    return ok ? 0 : 1;
+}
+
+static std::string stressAccount(int index) {
+    // 前缀14位加上最长11个字符的int
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "62220000000000%05d", index);
+    return buffer;
+}
+
+// 子进程：通过与界面相同的AccountOperations随机转账，提交冲突时沿用同一请求ID重试；
+// 结束时把每个账户的净变化（分）和冲突次数写进管道
+static void runStressWorker(const std::string& segment, const std::string& dataFile, int worker, int accounts,
+    int operations, int out) {
+    ShmAccountStore store(segment, dataFile);
+    if (!store.load()) std::_Exit(2);
+    LimitRules limitRules;
+    AccountOperations ops(store, "S" + std::to_string(worker), limitRules);
+    std::mt19937_64 rng(20240601 + worker);
+    std::vector<int64_t> deltas(accounts + 1, 0);
+
+    for (int i = 0; i < operations; i++) {
+        int from = rng() % accounts;
+        int to = (from + 1 + rng() % (accounts - 1)) % accounts;
+        int64_t cents = (1 + rng() % 50) * 100;
+        if (worker < 0) {
+            from = 0;
+            to = 1;
+            cents = 100;
+        }
+        std::string amountText = std::to_string(cents / 100);
+        RequestResult previous;
+        OperationStatus status = OPERATION_COMMIT_FAILED;
+        for (int attempt = 0; attempt < 1000 && status == OPERATION_COMMIT_FAILED; attempt++) {
+            status = ops.transfer(stressAccount(from), stressAccount(to), amountText, cents / 100.0, previous);
+        }
+        if (status == OPERATION_OK) {
+            deltas[from] -= cents;
+            deltas[to] += cents;
+        }
+    }
+    deltas[accounts] = (int64_t)store.conflictCount();
+    ssize_t bytes = deltas.size() * sizeof(int64_t);
+    std::_Exit(::write(out, deltas.data(), bytes) == bytes ? 0 : 3);
+}
+
+// 多进程压力测试：各进程并发转账，结束后每个账户的余额必须等于初始值加上所有成功转账的净变化，
+// 任何一次丢失更新都会让某个账户对不上。--crash 额外启动一个在提交中途崩溃的进程，
+// 它崩溃时持有段锁，其他进程靠robust锁接手并补完这次提交。
+static int runStress(int processes, int accounts, int operations, bool crash) {
+    const std::string segment = "/atm_stress_" + std::to_string(::getpid());
+    const std::string dataFile = "bench_shm.json";
+    const int64_t initialCents = 1000000;
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    {
+        SimpleJson json;
+        for (int i = 0; i < accounts; i++) {
+            json.set(stressAccount(i) + "_password", "123456");
+            json.set(stressAccount(i) + "_balance", std::to_string(initialCents / 100.0));
+            json.set(stressAccount(i) + "_daily_withdrawal", "0");
+            json.set(stressAccount(i) + "_name", "压测");
+        }
+        json.saveToFile(dataFile);
+    }
+    ShmAccountStore::removeSegment(segment);
+    ShmAccountStore store(segment, dataFile);
+    if (!store.load()) {
+        std::cerr << "无法创建共享内存段" << std::endl;
+        return 1;
+    }
+
+    std::vector<pid_t> children;
+    std::vector<int> pipes;
+    auto start = std::chrono::steady_clock::now();
+    for (int worker = crash ? -1 : 0; worker < processes; worker++) {
+        int fds[2];
+        if (::pipe(fds) != 0) return 1;
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::close(fds[0]);
+            if (worker < 0) ::setenv("ATM_FAULT", "shm_mid_apply", 1);
+            runStressWorker(segment, dataFile, worker, accounts, worker < 0 ? 1 : operations, fds[1]);
+        }
+        ::close(fds[1]);
+        children.push_back(pid);
+        pipes.push_back(fds[0]);
+    }
+
+    std::vector<int64_t> expected(accounts, initialCents);
+    uint64_t conflicts = 0;
+    bool ok = true;
+    bool crashed = false;
+    for (size_t i = 0; i < children.size(); i++) {
+        std::vector<int64_t> deltas(accounts + 1, 0);
+        ssize_t bytes = deltas.size() * sizeof(int64_t);
+        bool reported = ::read(pipes[i], deltas.data(), bytes) == bytes;
+        ::close(pipes[i]);
+        int status = 0;
+        ::waitpid(children[i], &status, 0);
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        if (crash && i == 0 && code == 86) {
+            // 崩溃时重做区已写好，下一个加锁的进程会补完这笔转账
+            expected[0] -= 100;
+            expected[1] += 100;
+            crashed = true;
+            continue;
+        }
+        if (!reported || code != 0) {
+            std::cerr << "压测进程异常退出: " << code << std::endl;
+            ok = false;
+            continue;
+        }
+        for (int account = 0; account < accounts; account++) {
+            expected[account] += deltas[account];
+        }
+        conflicts += deltas[accounts];
+    }
+    double ms = elapsedMs(start);
+
+    int64_t total = 0;
+    int mismatched = 0;
+    for (int i = 0; i < accounts; i++) {
+        int64_t cents = std::llround(std::stod(store.get(stressAccount(i) + "_balance")) * 100);
+        total += cents;
+        if (cents != expected[i]) mismatched++;
+    }
+    uint64_t commits = store.commitCount();
+    bool persisted = store.checkpoint();
+    SimpleJson saved;
+    persisted = persisted && saved.loadFromFile(dataFile);
+    for (int i = 0; persisted && i < accounts; i++) {
+        persisted = std::llround(std::stod(saved.get(stressAccount(i) + "_balance")) * 100) == expected[i];
+    }
+
+    std::printf("%d 个进程 x %d 次转账，%d 个账户：提交 %llu 次，冲突重试 %llu 次，%.0f 次提交/s\n", processes, operations,
+        accounts, (unsigned long long)commits, (unsigned long long)conflicts, commits / (ms / 1000));
+    std::printf("资金总额 %s，余额与成功转账不符的账户 %d 个，检查点%s\n",
+        total == initialCents * accounts ? "守恒" : "不守恒", mismatched, persisted ? "一致" : "不一致");
+    if (crashed) std::printf("持锁崩溃的进程留下的提交已由其他进程按重做区补完\n");
+
+    ShmAccountStore::removeSegment(segment);
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    return ok && mismatched == 0 && persisted && total == initialCents * accounts ? 0 : 1;
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " persist [--shm 名称] [--data 文件] [--interval-ms N]\n"
+        << "  " << program << " stress [--procs N] [--accounts N] [--ops N] [--crash]\n"
+        << "  " << program << " remove [--shm 名称]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    std::string segment = "/atm_users";
+    std::string dataFile = "users.json";
+    int intervalMs = 1000;
+    int processes = 8;
+    int accounts = 16;
+    int operations = 2000;
+    bool crash = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--shm" && i + 1 < argc) segment = argv[++i];
+        else if (arg == "--data" && i + 1 < argc) dataFile = argv[++i];
+        else if (arg == "--interval-ms" && i + 1 < argc) intervalMs = std::stoi(argv[++i]);
+        else if (arg == "--procs" && i + 1 < argc) processes = std::stoi(argv[++i]);
+        else if (arg == "--accounts" && i + 1 < argc) accounts = std::stoi(argv[++i]);
+        else if (arg == "--ops" && i + 1 < argc) operations = std::stoi(argv[++i]);
+        else if (arg == "--crash") crash = true;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (command == "persist") return runPersist(segment, dataFile, intervalMs);
+    if (command == "stress") return runStress(processes, accounts < 2 ? 2 : accounts, operations, crash);
+    if (command == "remove") {
+        if (!ShmAccountStore::removeSegment(segment)) {
+            std::cerr << "共享内存段不存在: " << segment << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    usage(argv[0]);
+    return 1;
+}
@@ -27,6 +27,9 @@ bool SimpleJson::loadFromFile(const std::string& filename) {
             key.erase(0, key.find_first_not_of(" \t\""));
             key.erase(key.find_last_not_of(" \t\"") + 1);
             value.erase(0, value.find_first_not_of(" \t\""));
+            value.erase(value.find_last_not_of(" \t\r") + 1);
+            // 除最后一项外每行以逗号结尾
+            if (!value.empty() && value.back() == ',') value.pop_back();
             value.erase(value.find_last_not_of(" \t\"") + 1);
             data[key] = value;
         }
@@ -47,7 +50,7 @@ bool SimpleJson::saveToFile(const std::string& filename) const {
     }
     file << "}";
     file.close();
-    return true;
+    return file.good();
 }
 
 bool SimpleJson::hasKey(const std::string& key) const {
@@ -68,4 +71,8 @@ std::string SimpleJson::findAccountByIdCard(const std::string& idCard) {
         }
     }
     return "";
+}
+
+const std::map<std::string, std::string>& SimpleJson::getAll() const {
+    return data;
 }
\ No newline at end of file
@@ -17,6 +17,7 @@ public:
     bool hasKey(const std::string& key) const;
     void clear();
     std::string findAccountByIdCard(const std::string& idCard);
+    const std::map<std::string, std::string>& getAll() const;
 };
 
 #endif
\ No newline at end of file
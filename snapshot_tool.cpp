@@ -0,0 +1,123 @@
+#include "columnar_snapshot.h"
+#include "lazy_account_store.h"
+#include "simple_json.h"
+#include "synthetic_accounts.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static long fileSize(const std::string& filename) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) return -1;
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fclose(file);
+    return size;
+}
+
+// 取三次中的最短时间，排除首次分配内存等一次性开销
+template <class F>
+static double timeMs(F&& body) {
+    double best = 0;
+    for (int run = 0; run < 3; run++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static int runBench(std::map<std::string, std::string>& data) {
+    size_t accounts = 0;
+    for (const auto& pair : data) {
+        if (pair.first.size() > 9 && pair.first.compare(pair.first.size() - 9, 9, "_password") == 0) accounts++;
+    }
+    if (accounts == 0) accounts = 1;
+
+    SimpleJson json;
+    for (const auto& pair : data) json.set(pair.first, pair.second);
+
+    const std::string jsonFile = "bench_users.json";
+    const std::string rawFile = "bench_users.raw.snap";
+    const std::string zipFile = "bench_users.zlib.snap";
+    std::map<std::string, std::string> loaded;
+
+    double jsonStore = timeMs([&] { json.saveToFile(jsonFile); });
+    double jsonLoad = timeMs([&] { json.loadFromFile(jsonFile); });
+    double rawStore = timeMs([&] { saveColumnarSnapshot(data, rawFile, false); });
+    double rawLoad = timeMs([&] { loadColumnarSnapshot(rawFile, loaded); });
+    bool rawExact = loaded == data;
+    double zipStore = timeMs([&] { saveColumnarSnapshot(data, zipFile, true); });
+    double zipLoad = timeMs([&] { loadColumnarSnapshot(zipFile, loaded); });
+    bool zipExact = loaded == data;
+
+    std::printf("accounts: %zu\n", accounts);
+    std::printf("%-22s %12s %14s %12s %12s\n", "format", "bytes", "bytes/account", "store ms", "load ms");
+    auto row = [&](const char* name, const std::string& file, double store, double load) {
+        long bytes = fileSize(file);
+        std::printf("%-22s %12ld %14.1f %12.1f %12.1f\n", name, bytes, (double)bytes / accounts, store, load);
+    };
+    row("json", jsonFile, jsonStore, jsonLoad);
+    row("columnar", rawFile, rawStore, rawLoad);
+    row(columnarCompressionAvailable() ? "columnar+zlib" : "columnar(no zlib)", zipFile, zipStore, zipLoad);
+    std::printf("round trip: columnar %s, columnar+zlib %s\n", rawExact ? "exact" : "MISMATCH", zipExact ? "exact" : "MISMATCH");
+
+    std::remove(jsonFile.c_str());
+    std::remove(rawFile.c_str());
+    std::remove(zipFile.c_str());
+    return rawExact && zipExact ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+
+    // 源数据文件连同它的 .txlog.checkpoint / .txlog 一起读，转换结果包含尚未写回数据文件的提交
+    if (command == "encode" && argc >= 4) {
+        std::map<std::string, std::string> data;
+        if (!loadAccountData(argv[2], data)) {
+            std::cerr << "无法读取: " << argv[2] << std::endl;
+            return 1;
+        }
+        bool compress = argc > 4 && std::string(argv[4]) == "--compress";
+        return saveColumnarSnapshot(data, argv[3], compress) ? 0 : 1;
+    }
+    if (command == "decode" && argc >= 4) {
+        std::map<std::string, std::string> data;
+        if (!loadAccountData(argv[2], data)) {
+            std::cerr << "快照格式错误: " << argv[2] << std::endl;
+            return 1;
+        }
+        SimpleJson json;
+        for (const auto& pair : data) json.set(pair.first, pair.second);
+        return json.saveToFile(argv[3]) ? 0 : 1;
+    }
+    if (command == "index" && argc >= 4) {
+        std::map<std::string, std::string> data;
+        std::string source = argv[2];
+        if (!loadAccountData(source, data)) {
+            std::cerr << "无法读取: " << source << std::endl;
+            return 1;
+        }
+        return buildAccountIndexFile(data, argv[3]) ? 0 : 1;
+    }
+    if (command == "bench" && argc >= 3) {
+        std::map<std::string, std::string> data;
+        std::string source = argv[2];
+        if (source == "--synthetic") {
+            generateAccounts(argc > 3 ? std::stoul(argv[3]) : 100000, data);
+        }
+        else if (!loadAccountData(source, data)) {
+            std::cerr << "无法读取: " << source << std::endl;
+            return 1;
+        }
+        return runBench(data);
+    }
+
+    std::cerr << "用法:\n"
+        << "  " << argv[0] << " encode users.json users.snap [--compress]\n"
+        << "  " << argv[0] << " decode users.snap users.json\n"
+        << "  " << argv[0] << " index users.json|users.snap users.idx\n"
+        << "  " << argv[0] << " bench users.json | --synthetic [账户数]" << std::endl;
+    return 1;
+}
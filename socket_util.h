@@ -0,0 +1,13 @@
+#ifndef SOCKET_UTIL_H
+#define SOCKET_UTIL_H
+
+#include <string>
+
+// 本地（Unix域）socket的简单封装，协议均为按行的文本
+int socketListen(const std::string& path, int backlog);
+int socketConnect(const std::string& path);
+bool socketWriteAll(int fd, const std::string& payload);
+// 读取一行（不含换行符），buffer保存已读取但未消费的数据
+bool socketReadLine(int fd, std::string& buffer, std::string& line);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+
+// 单生产者单消费者无锁环形队列，容量为2的幂。
+// 生产者只写tail、消费者只写head，各自缓存对方的位置，
+// 只有在缓存显示满/空时才去读对方的原子变量，减少缓存行往返。
+template <class T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscRing() : head(0), tail(0), cachedHead(0), cachedTail(0) {}
+
+    // 生产者调用；队列满时返回false，不等待
+    bool tryPush(const T& item) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cachedHead == Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (position - cachedHead == Capacity) return false;
+        }
+        items[position & (Capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用；队列空时返回false
+    bool tryPop(T& item) {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position == cachedTail) return false;
+        }
+        item = items[position & (Capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t cachedHead;      // 生产者私有
+    alignas(64) size_t cachedTail;      // 消费者私有
+    alignas(64) T items[Capacity];
+};
+
+#endif
@@ -0,0 +1,393 @@
+#include "standing_orders.h"
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+
+const char* standingPeriodName(uint32_t period) {
+    switch (period) {
+    case PERIOD_ONCE: return "once";
+    case PERIOD_DAILY: return "daily";
+    case PERIOD_WEEKLY: return "weekly";
+    case PERIOD_MONTHLY: return "monthly";
+    }
+    return "unknown";
+}
+
+bool parseStandingPeriod(const std::string& text, uint32_t& period) {
+    for (uint32_t candidate = PERIOD_ONCE; candidate <= PERIOD_MONTHLY; candidate++) {
+        if (text == standingPeriodName(candidate)) {
+            period = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 公历日期与1970-01-01起天数的互换（不经过mktime，补执行百万期时省去它的规范化开销）
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yearOfEra = (unsigned)(year - era * 400);
+    unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (int64_t)dayOfEra - 719468;
+}
+
+static void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned dayOfEra = (unsigned)(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned shifted = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted < 10 ? shifted + 3 : shifted - 9;
+    year = (int64_t)yearOfEra + era * 400 + (month <= 2);
+}
+
+static unsigned daysInMonth(int64_t year, unsigned month) {
+    static const unsigned days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+static int64_t localUtcOffset(int64_t at) {
+    time_t time = (time_t)at;
+    struct tm local;
+    localtime_r(&time, &local);
+    return local.tm_gmtoff;
+}
+
+// 本地钟点换算回UTC：偏移取自换算出的时刻本身，跨夏令时切换的各期不会差一小时。
+// 先按上一期的偏移猜一次，再用猜出时刻的偏移修正；切换时跳过的钟点落到切换之后
+static int64_t utcFromLocal(int64_t local, int64_t offsetHint) {
+    int64_t utc = local - localUtcOffset(local - offsetHint);
+    return std::max(utc, local - localUtcOffset(utc));
+}
+
+int64_t nextStandingRun(const StandingOrder& order, int64_t runAt) {
+    if (order.period != PERIOD_DAILY && order.period != PERIOD_WEEKLY && order.period != PERIOD_MONTHLY) {
+        return 0;
+    }
+
+    int64_t offset = localUtcOffset(runAt);
+    int64_t local = runAt + offset;
+    int64_t days = (local >= 0 ? local : local - 86399) / 86400;
+    int64_t secondsOfDay = local - days * 86400;
+    if (order.period == PERIOD_DAILY) return utcFromLocal((days + 1) * 86400 + secondsOfDay, offset);
+    if (order.period == PERIOD_WEEKLY) return utcFromLocal((days + 7) * 86400 + secondsOfDay, offset);
+
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    if (++month > 12) {
+        month = 1;
+        year++;
+    }
+    unsigned anchor = order.dayOfMonth ? order.dayOfMonth : day;
+    day = std::min(anchor, daysInMonth(year, month));
+    return utcFromLocal(daysFromCivil(year, month, day) * 86400 + secondsOfDay, offset);
+}
+
+StandingOrderBook::StandingOrderBook(const std::string& path) :
+    path(path),
+    nextId(1),
+    progressOut(nullptr) {
+}
+
+static bool parseOrder(const char* text, StandingOrder& order) {
+    char* end;
+    order.id = std::strtoull(text, &end, 10);
+    order.from = std::strtoull(end, &end, 10);
+    order.to = std::strtoull(end, &end, 10);
+    order.amountCents = std::strtoll(end, &end, 10);
+    order.nextRunAt = std::strtoll(end, &end, 10);
+    order.period = (uint32_t)std::strtoul(end, &end, 10);
+    char* last = end;
+    order.dayOfMonth = (uint32_t)std::strtoul(last, &end, 10);
+    return end != last && order.id != 0;
+}
+
+// 委托文件不存在视为空委托簿；进度文件末尾写到一半的记录丢弃（其对应的提交尚未发出）
+bool StandingOrderBook::load() {
+    entries.clear();
+    progress.clear();
+    nextId = 1;
+
+    std::ifstream file(path);
+    std::string line;
+    StandingOrder order;
+    while (std::getline(file, line)) {
+        if (!parseOrder(line.c_str(), order)) continue;
+        entries.push_back(order);
+        nextId = std::max(nextId, order.id + 1);
+    }
+
+    std::ifstream journal(path + ".progress");
+    while (std::getline(journal, line)) {
+        char tag = 0;
+        char requestId[128];
+        size_t count = 0;
+        long long writtenAt = 0;
+        // 早先的记录没有写入时间，按时间未知处理
+        if (std::sscanf(line.c_str(), "%c %127s %zu %lld", &tag, requestId, &count, &writtenAt) < 3 || tag != 'B') continue;
+
+        ProgressRecord record;
+        record.requestId = requestId;
+        record.writtenAt = writtenAt;
+        for (size_t i = 0; i < count && std::getline(journal, line); i++) {
+            char* end;
+            uint64_t id = std::strtoull(line.c_str(), &end, 10);
+            record.advances.emplace_back(id, std::strtoll(end, nullptr, 10));
+        }
+        if (record.advances.size() != count) break;
+        progress.push_back(std::move(record));
+    }
+    return true;
+}
+
+bool StandingOrderBook::recover(AccountStore& store, ProgressResolution resolution, int dedupWindowSeconds) {
+    if (progress.empty()) return true;
+
+    const ProgressRecord& last = progress.back();
+    bool lastCommitted = true;
+    RequestResult result;
+    if (last.requestId != "-" && resolution == RESOLVE_BY_STORE && !store.lookupRequest(last.requestId, result)) {
+        if (last.writtenAt == 0 || unixTimeNow() - last.writtenAt >= dedupWindowSeconds) {
+            error = "最后一批 " + last.requestId + " 已超出请求去重窗口，无法向存储确认是否已生效";
+            return false;
+        }
+        lastCommitted = false;
+    }
+    else if (last.requestId != "-" && resolution == RESOLVE_NOT_COMMITTED) {
+        lastCommitted = false;
+    }
+
+    std::unordered_map<uint64_t, size_t> positions;
+    positions.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        positions[entries[i].id] = i;
+    }
+    for (size_t i = 0; i < progress.size(); i++) {
+        const ProgressRecord& record = progress[i];
+        if (i + 1 == progress.size() && !lastCommitted) {
+            break;
+        }
+        for (const auto& advance : record.advances) {
+            auto position = positions.find(advance.first);
+            if (position != positions.end()) {
+                entries[position->second].nextRunAt = advance.second;
+            }
+        }
+    }
+    if (!save()) {
+        error = "无法重写委托文件: " + path;
+        return false;
+    }
+    return true;
+}
+
+// 先写临时文件并fsync再rename；之后才删除进度文件，中途崩溃时重放进度记录的结果相同
+bool StandingOrderBook::save() {
+    std::string tmp = path + ".tmp";
+    FILE* file = std::fopen(tmp.c_str(), "w");
+    if (!file) return false;
+    bool ok = true;
+    for (const auto& order : entries) {
+        if (order.nextRunAt == 0) continue;
+        ok = std::fprintf(file, "%" PRIu64 " %019" PRIu64 " %019" PRIu64 " %" PRId64 " %" PRId64 " %u %u\n",
+            order.id, order.from, order.to, order.amountCents, order.nextRunAt, order.period, order.dayOfMonth) > 0 && ok;
+    }
+    ok = std::fflush(file) == 0 && ok;
+    ok = ::fsync(fileno(file)) == 0 && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) return false;
+
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [](const StandingOrder& order) { return order.nextRunAt == 0; }), entries.end());
+    if (progressOut) {
+        std::fclose(progressOut);
+        progressOut = nullptr;
+    }
+    std::remove((path + ".progress").c_str());
+    progress.clear();
+    return true;
+}
+
+uint64_t StandingOrderBook::add(StandingOrder order) {
+    order.id = nextId++;
+    entries.push_back(order);
+    return order.id;
+}
+
+bool StandingOrderBook::cancel(uint64_t id) {
+    auto it = std::find_if(entries.begin(), entries.end(), [id](const StandingOrder& order) { return order.id == id; });
+    if (it == entries.end()) return false;
+    entries.erase(it);
+    return true;
+}
+
+bool StandingOrderBook::appendProgress(const std::string& requestId, const std::vector<std::pair<uint64_t, int64_t>>& advances) {
+    if (!progressOut) {
+        progressOut = std::fopen((path + ".progress").c_str(), "a");
+        if (!progressOut) return false;
+    }
+    bool ok = std::fprintf(progressOut, "B %s %zu %lld\n", requestId.c_str(), advances.size(),
+        (long long)unixTimeNow()) > 0;
+    for (const auto& advance : advances) {
+        ok = std::fprintf(progressOut, "%" PRIu64 " %" PRId64 "\n", advance.first, advance.second) > 0 && ok;
+    }
+    ok = std::fflush(progressOut) == 0 && ok;
+    return ::fsync(fileno(progressOut)) == 0 && ok;
+}
+
+TransferScheduler::TransferScheduler(AccountStore& store, StandingOrderBook& book, size_t batchSize) :
+    store(store),
+    book(book),
+    batchSize(batchSize ? batchSize : 1) {
+}
+
+const std::string& TransferScheduler::key(uint64_t account, const char* field) {
+    char buffer[24];
+    int length = std::snprintf(buffer, sizeof(buffer), "%019" PRIu64, account);
+    keyBuffer.assign(buffer, length).append(field);
+    return keyBuffer;
+}
+
+// batchAccounts已排序去重
+void TransferScheduler::loadAccounts() {
+    states.resize(batchAccounts.size());
+    for (size_t i = 0; i < batchAccounts.size(); i++) {
+        AccountState& state = states[i];
+        state.account = batchAccounts[i];
+        state.exists = store.hasKey(key(state.account, "_password"));
+        state.changed = false;
+        state.balance = state.exists ? std::strtod(store.get(key(state.account, "_balance")).c_str(), nullptr) : 0;
+    }
+    for (auto& entry : batch) {
+        const StandingOrder& order = book.orders()[entry.index];
+        entry.fromSlot = (uint32_t)(std::lower_bound(batchAccounts.begin(), batchAccounts.end(), order.from) - batchAccounts.begin());
+        entry.toSlot = (uint32_t)(std::lower_bound(batchAccounts.begin(), batchAccounts.end(), order.to) - batchAccounts.begin());
+    }
+}
+
+// 成功返回nullptr，否则返回失败原因
+const char* TransferScheduler::execute(const StandingOrder& order, const BatchEntry& entry) {
+    AccountState& from = states[entry.fromSlot];
+    AccountState& to = states[entry.toSlot];
+    if (!from.exists) return "source_missing";
+
+    double amount = order.amountCents / 100.0;
+    switch (checkTransferRules(order.from == order.to, to.exists, amount, from.balance)) {
+    case OPERATION_OK: break;
+    case OPERATION_SELF_TRANSFER: return "self_transfer";
+    case OPERATION_TARGET_MISSING: return "target_missing";
+    case OPERATION_NOT_POSITIVE: return "not_positive";
+    case OPERATION_INSUFFICIENT_BALANCE: return "insufficient_balance";
+    default: return "rejected";
+    }
+    from.balance -= amount;
+    to.balance += amount;
+    from.changed = true;
+    to.changed = true;
+    return nullptr;
+}
+
+bool TransferScheduler::runDue(int64_t now, FILE* report, StandingRunStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<StandingOrder>& orders = book.orders();
+
+    // (执行时间, 委托下标) 的最小堆；补执行时同一委托的下一期仍到期则重新入堆
+    typedef std::pair<int64_t, size_t> Due;
+    std::greater<Due> later;
+    std::vector<Due> heap;
+    for (size_t i = 0; i < orders.size(); i++) {
+        if (orders[i].nextRunAt != 0 && orders[i].nextRunAt <= now) {
+            heap.emplace_back(orders[i].nextRunAt, i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+
+    std::vector<std::pair<uint64_t, int64_t>> advances;
+    std::vector<std::pair<size_t, int64_t>> updates;
+    std::vector<std::pair<const BatchEntry*, const char*>> failures;
+    ChangeBatch group;
+    std::string requestId;
+    std::string runId = "SO-" + std::to_string(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+
+    while (!heap.empty()) {
+        batch.clear();
+        batchAccounts.clear();
+        advances.clear();
+        updates.clear();
+        failures.clear();
+        while (!heap.empty() && batch.size() < batchSize) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Due due = heap.back();
+            heap.pop_back();
+
+            const StandingOrder& order = orders[due.second];
+            batch.push_back(BatchEntry{ due.first, due.second, 0, 0 });
+            batchAccounts.push_back(order.from);
+            batchAccounts.push_back(order.to);
+
+            int64_t next = nextStandingRun(order, due.first);
+            advances.emplace_back(order.id, next);
+            updates.emplace_back(due.second, next);
+            if (next != 0 && next <= now) {
+                heap.emplace_back(next, due.second);
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+        std::sort(batchAccounts.begin(), batchAccounts.end());
+        batchAccounts.erase(std::unique(batchAccounts.begin(), batchAccounts.end()), batchAccounts.end());
+        loadAccounts();
+
+        double total = 0;
+        for (const auto& entry : batch) {
+            const StandingOrder& order = orders[entry.index];
+            const char* reason = execute(order, entry);
+            if (reason) {
+                failures.emplace_back(&entry, reason);
+            }
+            else {
+                total += order.amountCents / 100.0;
+            }
+        }
+
+        size_t changed = 0;
+        for (const auto& state : states) {
+            if (!state.changed) continue;
+            if (group.size() <= changed) group.emplace_back();
+            group[changed].first.assign(key(state.account, "_balance"));
+            formatAmount(group[changed].second, state.balance);
+            changed++;
+        }
+        group.resize(changed);
+
+        requestId = group.empty() ? std::string("-") : runId + "-" + std::to_string(stats.batches);
+        if (!book.appendProgress(requestId, advances)) return false;
+        if (!group.empty() && !store.commit(group, requestId, RequestResult{ REQUEST_TRANSFER, total })) return false;
+
+        for (const auto& update : updates) {
+            orders[update.first].nextRunAt = update.second;
+        }
+        for (const auto& failure : failures) {
+            const StandingOrder& order = orders[failure.first->index];
+            std::fprintf(report, "%" PRId64 " %" PRIu64 " %019" PRIu64 " %019" PRIu64 " %" PRId64 " %s\n",
+                failure.first->runAt, order.id, order.from, order.to, order.amountCents, failure.second);
+        }
+        stats.executed += batch.size() - failures.size();
+        stats.failed += failures.size();
+        stats.batches++;
+    }
+    std::fflush(report);
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,138 @@
+#ifndef STANDING_ORDERS_H
+#define STANDING_ORDERS_H
+
+#include "account_store.h"
+#include "account_operations.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdint>
+
+enum StandingPeriod : uint32_t {
+    PERIOD_ONCE = 0,
+    PERIOD_DAILY = 1,
+    PERIOD_WEEKLY = 2,
+    PERIOD_MONTHLY = 3
+};
+
+// 一笔定期（或预约的一次性）转账委托，定长48字节
+struct StandingOrder {
+    uint64_t id;
+    uint64_t from;
+    uint64_t to;
+    int64_t amountCents;
+    int64_t nextRunAt;      // 下一次执行时间，unix秒；0表示已执行完毕
+    uint32_t period;
+    uint32_t dayOfMonth;    // 按月委托的约定日，小月按月末执行
+};
+
+const char* standingPeriodName(uint32_t period);
+bool parseStandingPeriod(const std::string& text, uint32_t& period);
+// 按本地时间推算下一期的执行时间，每期保持相同的本地钟点（时区偏移按各期的时刻取，
+// 跨夏令时切换不漂移）；一次性委托返回0
+int64_t nextStandingRun(const StandingOrder& order, int64_t runAt);
+
+// 委托簿：委托文件每行一条
+//   <编号> <付款账号> <收款账号> <金额分> <下次执行时间> <周期> <约定日>
+// 恢复时最后一批是否已生效的判定方式：默认向存储查询请求ID，查不到结果时由运维指定
+enum ProgressResolution {
+    RESOLVE_BY_STORE = 0,
+    RESOLVE_COMMITTED = 1,
+    RESOLVE_NOT_COMMITTED = 2
+};
+
+// 委托簿：委托文件每行一条
+//   <编号> <付款账号> <收款账号> <金额分> <下次执行时间> <周期> <约定日>
+// 执行进度先追加到 <委托文件>.progress 再提交转账，每批一条记录：
+//   B <提交的请求ID|-> <条数> <写入时间>
+//   <编号> <新的下次执行时间>
+// 重启时只有最后一条记录可能对应未完成的提交，用请求ID向存储查询是否已生效。
+// 存储只在去重窗口内记得请求结果，记录早于窗口时查不到并不说明没生效，
+// 这时不自动恢复，须由运维核对后指定判定方式。
+// 同一时刻只应有一个进程修改委托簿。
+class StandingOrderBook {
+public:
+    StandingOrderBook(const std::string& path);
+
+    bool load();
+    // 把进度记录合入委托并重写委托文件，之后清空进度记录；
+    // 最后一批无法判定时返回false，进度记录原样保留，原因见lastError()
+    bool recover(AccountStore& store, ProgressResolution resolution = RESOLVE_BY_STORE,
+        int dedupWindowSeconds = 3600);
+    bool save();
+    bool hasPendingProgress() const { return !progress.empty(); }
+    const std::string& lastError() const { return error; }
+
+    uint64_t add(StandingOrder order);
+    bool cancel(uint64_t id);
+    std::vector<StandingOrder>& orders() { return entries; }
+
+    bool appendProgress(const std::string& requestId, const std::vector<std::pair<uint64_t, int64_t>>& advances);
+
+private:
+    struct ProgressRecord {
+        std::string requestId;
+        int64_t writtenAt;
+        std::vector<std::pair<uint64_t, int64_t>> advances;
+    };
+
+    std::string path;
+    std::vector<StandingOrder> entries;
+    std::vector<ProgressRecord> progress;
+    uint64_t nextId;
+    FILE* progressOut;
+    std::string error;
+};
+
+struct StandingRunStats {
+    uint64_t executed = 0;
+    uint64_t failed = 0;
+    uint64_t batches = 0;
+    double seconds = 0;
+};
+
+// 按执行时间从早到晚（最小堆）处理所有到期委托，停机期间错过的各期依次补执行。
+// 每批最多batchSize笔：先按账号顺序读入本批涉及账户的存在性与余额（有序访问比随机查找快数倍），
+// 再按执行时间逐笔套用转账的基本规则（checkTransferRules，委托已预先授权，不套用层级限额），扣款记在批内的账户表上，
+// 因此同一账户在一批内的多笔转账按顺序扣款；整批的余额修改合成一次提交，
+// 事务日志追加与数据文件重写每批各一次。
+// 某一期校验失败时该期跳过（不重试），失败明细逐行写入report：
+//   <执行时间> <编号> <付款账号> <收款账号> <金额分> <原因>
+class TransferScheduler {
+public:
+    TransferScheduler(AccountStore& store, StandingOrderBook& book, size_t batchSize = 65536);
+
+    // 提交失败时停止并返回false，已提交的批次保留，未确认的一批留待下次recover()判断
+    bool runDue(int64_t now, FILE* report, StandingRunStats& stats);
+
+private:
+    struct AccountState {
+        uint64_t account;
+        bool exists;
+        bool changed;
+        double balance;
+    };
+
+    struct BatchEntry {
+        int64_t runAt;
+        size_t index;
+        uint32_t fromSlot;
+        uint32_t toSlot;
+    };
+
+    void loadAccounts();
+    const char* execute(const StandingOrder& order, const BatchEntry& entry);
+    const std::string& key(uint64_t account, const char* field);
+
+    AccountStore& store;
+    StandingOrderBook& book;
+    size_t batchSize;
+
+    std::vector<BatchEntry> batch;
+    std::vector<uint64_t> batchAccounts;
+    std::vector<AccountState> states;   // 本批涉及的账户，按账号排序
+    std::string keyBuffer;
+};
+
+#endif
@@ -0,0 +1,487 @@
+#include "account_store.h"
+#include "shm_account_store.h"
+#include "limit_rules.h"
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+// 逻辑时钟：每取一张票前进1/8秒，锁定时长按逻辑时间计，运行结果不依赖真实时间
+static const int64_t BASE_TIME = 1700000000;
+static const uint64_t TICKETS_PER_SECOND = 8;
+static const int64_t INITIAL_CENTS = 1000000;
+static const char* const PASSWORD = "123456";
+
+static int64_t logicalNow(uint64_t ticket) {
+    return BASE_TIME + (int64_t)(ticket / TICKETS_PER_SECOND);
+}
+
+static std::string stressAccount(size_t index) {
+    // 前缀4位加上最长20位的size_t
+    char text[32];
+    std::snprintf(text, sizeof(text), "6222%015zu", index);
+    return text;
+}
+
+// 每16个账户中有一个人工锁定，任何终端都不应登录成功
+static bool manuallyLocked(size_t index) {
+    return index % 16 == 15;
+}
+
+// 确定性调度：同一时刻只有一个工作线程在运行，每次访问存储前按种子随机选出下一个运行的线程，
+// 同一种子得到完全相同的交错顺序，出问题时用同一种子即可复现
+class SeededScheduler {
+public:
+    SeededScheduler(size_t threads, uint64_t seed) :
+        done(threads, false),
+        remaining(threads),
+        rng(seed) {
+        current = rng() % threads;
+    }
+
+    void begin(size_t self) {
+        std::unique_lock<std::mutex> lock(mutex);
+        turn.wait(lock, [&] { return current == self; });
+    }
+
+    void yield(size_t self) {
+        std::unique_lock<std::mutex> lock(mutex);
+        pickNextLocked();
+        turn.notify_all();
+        turn.wait(lock, [&] { return current == self; });
+    }
+
+    void finish(size_t self) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done[self] = true;
+        if (--remaining > 0) pickNextLocked();
+        turn.notify_all();
+    }
+
+private:
+    void pickNextLocked() {
+        size_t skip = rng() % remaining;
+        for (size_t i = 0; i < done.size(); i++) {
+            if (!done[i] && skip-- == 0) {
+                current = i;
+                return;
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable turn;
+    std::vector<bool> done;
+    size_t remaining;
+    size_t current;
+    std::mt19937_64 rng;
+};
+
+// 每次访问存储前让出执行权，交错点与真实并发时可能发生竞争的位置一致
+class InterleavingStore : public AccountStore {
+public:
+    InterleavingStore(AccountStore& inner, SeededScheduler& scheduler, size_t self) :
+        inner(inner),
+        scheduler(scheduler),
+        self(self) {
+    }
+
+    bool load() override { return inner.load(); }
+    std::string get(const std::string& key) override {
+        scheduler.yield(self);
+        return inner.get(key);
+    }
+    bool hasKey(const std::string& key) override {
+        scheduler.yield(self);
+        return inner.hasKey(key);
+    }
+    std::string findAccountByIdCard(const std::string& idCard) override {
+        scheduler.yield(self);
+        return inner.findAccountByIdCard(idCard);
+    }
+    bool commit(const ChangeBatch& changes, const std::string& requestId, const RequestResult& result) override {
+        scheduler.yield(self);
+        return inner.commit(changes, requestId, result);
+    }
+    bool lookupRequest(const std::string& requestId, RequestResult& result) override {
+        scheduler.yield(self);
+        return inner.lookupRequest(requestId, result);
+    }
+
+private:
+    AccountStore& inner;
+    SeededScheduler& scheduler;
+    size_t self;
+};
+
+struct LoginEvent {
+    size_t account;
+    uint64_t ticket;
+};
+
+struct LockEvent {
+    size_t account;
+    uint64_t ticket;        // 锁定截止时间写入存储之后取的票
+    int64_t lockedUntil;
+};
+
+struct WorkerResult {
+    std::vector<int64_t> balanceDeltas;
+    std::vector<int64_t> withdrawn;
+    std::vector<LoginEvent> logins;
+    std::vector<LockEvent> locks;
+    uint64_t operations = 0;
+    uint64_t rejected = 0;
+    uint64_t retries = 0;
+    uint64_t refusedLogins = 0;
+    uint64_t failedLogins = 0;
+    uint64_t abandoned = 0;
+};
+
+struct StressOptions {
+    std::string store = "local";
+    std::string dir = ".";
+    std::vector<size_t> threadCounts{ 1, 2, 4, 8 };
+    size_t sessions = 500;
+    size_t accounts = 32;
+    uint64_t seed = 1;
+    bool seeded = false;
+};
+
+// 提交冲突时沿用同一请求ID重试（与界面上用户点"重试"相同），记下成功操作对余额的影响
+template <class Operation>
+static OperationStatus runWithRetry(WorkerResult& result, Operation operation) {
+    OperationStatus status = OPERATION_COMMIT_FAILED;
+    for (int attempt = 0; attempt < 10000 && status == OPERATION_COMMIT_FAILED; attempt++) {
+        if (attempt > 0) result.retries++;
+        status = operation();
+    }
+    if (status == OPERATION_COMMIT_FAILED) result.abandoned++;
+    return status;
+}
+
+// 一个终端：随机选账户登录（部分故意输错密码），登录成功后做1-3笔取款或转账。
+// 八成会话集中在前8个账户上，制造同一账户上的并发冲突
+static void runWorker(AccountStore& store, size_t self, const StressOptions& options, std::atomic<uint64_t>& tickets,
+    WorkerResult& result) {
+    std::mt19937_64 rng(options.seed * 1000003 + self);
+    LimitRules rules;
+    LockoutManager lockouts(3, 60, 60);
+    AccountOperations operations(store, "S" + std::to_string(self), rules);
+    result.balanceDeltas.assign(options.accounts, 0);
+    result.withdrawn.assign(options.accounts, 0);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < options.accounts; i++) names.push_back(stressAccount(i));
+    size_t hot = std::min<size_t>(options.accounts, 8);
+
+    for (size_t session = 0; session < options.sessions; session++) {
+        size_t account = rng() % 5 == 0 ? rng() % options.accounts : rng() % hot;
+        bool wrongPassword = rng() % 100 < 20;
+        uint64_t ticket = tickets.fetch_add(1);
+        LockoutManager::Status status;
+        OperationStatus login = operations.login(lockouts, names[account], wrongPassword ? "654321" : PASSWORD,
+            logicalNow(ticket), status);
+        if (login == OPERATION_WRONG_PASSWORD) {
+            result.failedLogins++;
+            if (status.locked) result.locks.push_back({ account, tickets.fetch_add(1), status.lockedUntil });
+            continue;
+        }
+        if (login != OPERATION_OK) {
+            result.refusedLogins++;
+            continue;
+        }
+        result.logins.push_back({ account, ticket });
+
+        for (int count = 1 + rng() % 3; count > 0; count--) {
+            RequestResult previous;
+            char amountText[32];
+            if (rng() % 5 < 2) {
+                // 取款：100-1000元，偶尔带50元（面额不符）或超过单笔限额
+                int64_t cents = (int64_t)(1 + rng() % 10) * 10000;
+                uint64_t unusual = rng() % 20;
+                if (unusual == 0) cents += 5000;
+                if (unusual == 1) cents = 250000;
+                std::snprintf(amountText, sizeof(amountText), "%.2f", cents / 100.0);
+                OperationStatus withdrawal = runWithRetry(result, [&] {
+                    return operations.withdraw(names[account], amountText, cents / 100.0, previous);
+                });
+                if (withdrawal == OPERATION_OK || withdrawal == OPERATION_DUPLICATE) {
+                    result.operations++;
+                    result.balanceDeltas[account] -= cents;
+                    result.withdrawn[account] += cents;
+                }
+                else if (withdrawal != OPERATION_COMMIT_FAILED) {
+                    result.rejected++;
+                }
+            }
+            else {
+                size_t target = rng() % options.accounts;
+                int64_t cents = 1 + (int64_t)(rng() % 100000);
+                std::snprintf(amountText, sizeof(amountText), "%.2f", cents / 100.0);
+                OperationStatus transfer = runWithRetry(result, [&] {
+                    return operations.transfer(names[account], names[target], amountText, cents / 100.0, previous);
+                });
+                if (transfer == OPERATION_OK || transfer == OPERATION_DUPLICATE) {
+                    result.operations++;
+                    result.balanceDeltas[account] -= cents;
+                    result.balanceDeltas[target] += cents;
+                }
+                else if (transfer != OPERATION_COMMIT_FAILED) {
+                    result.rejected++;
+                }
+            }
+        }
+    }
+}
+
+struct Violations {
+    std::vector<std::string> details;
+    size_t count = 0;
+
+    void add(const std::string& detail) {
+        if (++count <= 10) details.push_back(detail);
+    }
+};
+
+// 运行结束后从新打开的存储读回全部账户，逐项核对不变量
+static void checkInvariants(AccountStore& store, const StressOptions& options, const std::vector<WorkerResult>& results,
+    Violations& violations, uint64_t& digest) {
+    LimitRules rules;
+    std::vector<int64_t> expected(options.accounts, INITIAL_CENTS);
+    std::vector<int64_t> withdrawn(options.accounts, 0);
+    std::vector<std::vector<const LockEvent*>> locks(options.accounts);
+    for (const auto& result : results) {
+        for (size_t i = 0; i < options.accounts; i++) {
+            expected[i] += result.balanceDeltas[i];
+            withdrawn[i] += result.withdrawn[i];
+        }
+        for (const auto& lock : result.locks) locks[lock.account].push_back(&lock);
+    }
+
+    int64_t total = 0;
+    int64_t totalWithdrawn = 0;
+    std::string state;
+    for (size_t i = 0; i < options.accounts; i++) {
+        std::string account = stressAccount(i);
+        int64_t balance = toCents(std::stod(store.get(account + "_balance")));
+        int64_t daily = toCents(std::stod(store.get(account + "_daily_withdrawal")));
+        std::string lockedUntil = store.get(account + "_locked_until");
+        total += balance;
+        totalWithdrawn += withdrawn[i];
+        if (balance < 0) violations.add(account + " 余额为负: " + std::to_string(balance) + " 分");
+        if (balance != expected[i]) {
+            violations.add(account + " 余额 " + std::to_string(balance) + " 分，按成功操作应为 " +
+                std::to_string(expected[i]) + " 分（丢失更新）");
+        }
+        if (daily != withdrawn[i]) {
+            violations.add(account + " 今日已取 " + std::to_string(daily) + " 分，成功取款合计 " +
+                std::to_string(withdrawn[i]) + " 分");
+        }
+        if (daily > rules.table().rowFor(accountNumber(account)).withdrawDaily) {
+            violations.add(account + " 今日已取 " + std::to_string(daily) + " 分，超过单日限额");
+        }
+        state += std::to_string(balance) + ":" + std::to_string(daily) + ":" +
+            std::to_string(lockedUntil.empty() ? 0 : std::stoll(lockedUntil) - BASE_TIME) + ";";
+    }
+    if (total != INITIAL_CENTS * (int64_t)options.accounts - totalWithdrawn) {
+        violations.add("资金不守恒：余额合计 " + std::to_string(total) + " 分，初始合计减成功取款应为 " +
+            std::to_string(INITIAL_CENTS * (int64_t)options.accounts - totalWithdrawn) + " 分");
+    }
+
+    // 锁定：人工锁定的账户不应登录成功；锁定写入存储之后才开始的登录，在截止时间前不应成功
+    for (const auto& result : results) {
+        for (const auto& login : result.logins) {
+            if (manuallyLocked(login.account)) {
+                violations.add(stressAccount(login.account) + " 已人工锁定，仍登录成功");
+            }
+            for (const LockEvent* lock : locks[login.account]) {
+                if (lock->ticket < login.ticket && lock->lockedUntil > logicalNow(login.ticket)) {
+                    violations.add(stressAccount(login.account) + " 锁定到 " + std::to_string(lock->lockedUntil - BASE_TIME) +
+                        "，登录于 " + std::to_string(logicalNow(login.ticket) - BASE_TIME) + " 仍成功");
+                }
+            }
+        }
+    }
+    digest = hashKey(state);
+}
+
+static void writeInitialData(const std::string& dataFile, size_t accounts) {
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    SimpleJson json;
+    for (size_t i = 0; i < accounts; i++) {
+        std::string account = stressAccount(i);
+        json.set(account + "_password", PASSWORD);
+        json.set(account + "_balance", std::to_string(INITIAL_CENTS / 100.0));
+        json.set(account + "_daily_withdrawal", "0");
+        json.set(account + "_locked", manuallyLocked(i) ? "true" : "false");
+        json.set(account + "_name", "压测");
+    }
+    json.saveToFile(dataFile);
+}
+
+// 一轮：重建数据，threads个终端并发运行，结束后核对不变量并输出一行
+static bool runRound(const StressOptions& options, size_t threads) {
+    const std::string dataFile = options.dir + "/stress_" + std::to_string(::getpid()) + ".json";
+    const std::string segment = "/atm_stress_" + std::to_string(::getpid());
+    writeInitialData(dataFile, options.accounts);
+
+    bool shm = options.store == "shm";
+    std::unique_ptr<LocalAccountStore> local;
+    std::unique_ptr<ShmAccountStore> owner;
+    std::vector<std::unique_ptr<AccountStore>> workerStores;
+    if (shm) {
+        ShmAccountStore::removeSegment(segment);
+        owner.reset(new ShmAccountStore(segment, dataFile));
+        if (!owner->load()) {
+            std::cerr << "无法创建共享内存段" << std::endl;
+            return false;
+        }
+        // 共享内存存储的读集合在对象内，每个线程各自映射同一个段
+        for (size_t i = 0; i < threads; i++) {
+            workerStores.emplace_back(new ShmAccountStore(segment, dataFile));
+            if (!workerStores.back()->load()) return false;
+        }
+    }
+    else {
+        local.reset(new LocalAccountStore(dataFile));
+        local->load();
+    }
+
+    std::unique_ptr<SeededScheduler> scheduler;
+    std::vector<std::unique_ptr<InterleavingStore>> interleaved;
+    if (options.seeded) {
+        scheduler.reset(new SeededScheduler(threads, options.seed + threads));
+        for (size_t i = 0; i < threads; i++) {
+            AccountStore& inner = shm ? *workerStores[i] : *local;
+            interleaved.emplace_back(new InterleavingStore(inner, *scheduler, i));
+        }
+    }
+
+    std::atomic<uint64_t> tickets(0);
+    std::vector<WorkerResult> results(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < threads; i++) {
+        AccountStore& store = options.seeded ? (AccountStore&)*interleaved[i] : shm ? *workerStores[i] : (AccountStore&)*local;
+        workers.emplace_back([&, i, storePtr = &store] {
+            if (scheduler) scheduler->begin(i);
+            runWorker(*storePtr, i, options, tickets, results[i]);
+            if (scheduler) scheduler->finish(i);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    WorkerResult total;
+    for (const auto& result : results) {
+        total.operations += result.operations;
+        total.rejected += result.rejected;
+        total.retries += result.retries;
+        total.refusedLogins += result.refusedLogins;
+        total.failedLogins += result.failedLogins;
+        total.abandoned += result.abandoned;
+        total.locks.insert(total.locks.end(), result.locks.begin(), result.locks.end());
+    }
+
+    // 单机存储从数据文件和事务日志重新加载，连同持久化一起核对
+    Violations violations;
+    uint64_t digest = 0;
+    workerStores.clear();
+    local.reset();
+    if (shm) {
+        checkInvariants(*owner, options, results, violations, digest);
+    }
+    else {
+        LocalAccountStore reloaded(dataFile);
+        reloaded.load();
+        checkInvariants(reloaded, options, results, violations, digest);
+    }
+
+    std::printf("%4zu %8zu %8llu %8llu %8llu %8llu %8zu %8.2f %10.0f  %016llx  %s\n", threads, threads * options.sessions,
+        (unsigned long long)total.operations, (unsigned long long)total.rejected, (unsigned long long)total.retries,
+        (unsigned long long)total.refusedLogins, total.locks.size(), seconds, total.operations / seconds,
+        (unsigned long long)digest, violations.count == 0 ? "通过" : "失败");
+    for (const auto& detail : violations.details) std::printf("      %s\n", detail.c_str());
+    if (violations.count > violations.details.size()) {
+        std::printf("      ……共 %zu 处违反\n", violations.count);
+    }
+    if (total.abandoned > 0) {
+        std::printf("      %llu 笔操作重试上限内未能提交\n", (unsigned long long)total.abandoned);
+    }
+
+    owner.reset();
+    if (shm) ShmAccountStore::removeSegment(segment);
+    for (const auto& file : { dataFile, dataFile + ".txlog", dataFile + ".txlog.checkpoint" }) {
+        std::remove(file.c_str());
+    }
+    return violations.count == 0 && total.abandoned == 0;
+}
+
+static bool parseThreadList(const std::string& text, std::vector<size_t>& counts) {
+    counts.clear();
+    std::istringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        int count = std::atoi(item.c_str());
+        if (count <= 0) return false;
+        counts.push_back((size_t)count);
+    }
+    return !counts.empty();
+}
+
+static void usage(const char* program) {
+    std::cerr << "用法:\n"
+        << "  " << program << " [--store local|shm] [--threads 1,2,4,8] [--sessions N] [--accounts N]\n"
+        << "      [--seed N] [--schedule free|seeded] [--dir 目录]\n"
+        << "  free: 真实并发，测各线程数的吞吐（可在 ATM_TSAN 构建下运行）\n"
+        << "  seeded: 按种子确定交错顺序，同一种子结果（状态摘要）完全相同" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    StressOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--store" && i + 1 < argc) options.store = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc && parseThreadList(argv[i + 1], options.threadCounts)) i++;
+        else if (arg == "--sessions" && i + 1 < argc) options.sessions = std::stoul(argv[++i]);
+        else if (arg == "--accounts" && i + 1 < argc) options.accounts = std::max(2ul, std::stoul(argv[++i]));
+        else if (arg == "--seed" && i + 1 < argc) options.seed = std::stoull(argv[++i]);
+        else if (arg == "--schedule" && i + 1 < argc) {
+            std::string schedule = argv[++i];
+            if (schedule != "free" && schedule != "seeded") {
+                usage(argv[0]);
+                return 1;
+            }
+            options.seeded = schedule == "seeded";
+        }
+        else if (arg == "--dir" && i + 1 < argc) options.dir = argv[++i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.store != "local" && options.store != "shm") {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::printf("存储 %s，%zu 个账户，每线程 %zu 个会话，种子 %llu，%s\n", options.store.c_str(), options.accounts,
+        options.sessions, (unsigned long long)options.seed, options.seeded ? "确定性交错（串行执行）" : "真实并发");
+    std::printf("%4s %8s %8s %8s %8s %8s %8s %8s %10s  %-16s  %s\n", "线程", "会话", "成功操作", "规则拒绝", "冲突重试",
+        "拒绝登录", "新锁定", "耗时s", "操作/s", "状态摘要", "不变量");
+    bool ok = true;
+    for (size_t threads : options.threadCounts) {
+        ok = runRound(options, threads) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#include "synthetic_accounts.h"
+#include <cstdio>
+#include <cstdint>
+#include <random>
+
+void generateAccounts(size_t count, std::map<std::string, std::string>& data) {
+    static const char* surnames[] = { "张", "王", "李", "赵", "刘", "陈", "杨", "黄" };
+    static const char* givenNames[] = { "伟", "芳", "娜", "敏", "静", "强", "磊", "洋", "艳", "军" };
+    std::mt19937_64 rng(20240601);
+    uint64_t account = 6222000000000000000ULL;
+    for (size_t i = 0; i < count; i++) {
+        account += 1 + rng() % 1000;
+        std::string key = std::to_string(account);
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%06llu", (unsigned long long)(rng() % 1000000));
+        data[key + "_password"] = buffer;
+        data[key + "_balance"] = std::to_string((double)(rng() % 2000000) / 100.0);
+        data[key + "_daily_withdrawal"] = rng() % 4 ? "0" : std::to_string((double)(rng() % 50) * 100);
+        data[key + "_locked"] = rng() % 50 ? "false" : "true";
+        std::snprintf(buffer, sizeof(buffer), "%017llu%c", (unsigned long long)(110101199000000000ULL + rng() % 10000000000ULL),
+            rng() % 11 ? (char)('0' + rng() % 10) : 'X');
+        data[key + "_idcard"] = buffer;
+        data[key + "_name"] = std::string(surnames[rng() % 8]) + givenNames[rng() % 10] + (rng() % 2 ? givenNames[rng() % 10] : "");
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef SYNTHETIC_ACCOUNTS_H
+#define SYNTHETIC_ACCOUNTS_H
+
+#include <string>
+#include <map>
+#include <cstddef>
+
+// 生成与注册流程写入格式一致的合成账户（固定种子，结果可复现），供各基准工具使用
+void generateAccounts(size_t count, std::map<std::string, std::string>& data);
+
+#endif
@@ -0,0 +1,110 @@
+#include "transaction_log.h"
+#include "durable_file.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static std::string encodeRecord(const TransactionRecord& record) {
+    std::string text = "R " + (record.requestId.empty() ? std::string("-") : record.requestId) + " " +
+        std::to_string(record.result.kind) + " " + std::to_string(record.result.amount) + " " +
+        std::to_string(record.committedAt) + " " + std::to_string(record.changes.size()) + "\n";
+    for (const auto& change : record.changes) {
+        text += change.first + "\t" + change.second + "\n";
+    }
+    return text;
+}
+
+TransactionLog::TransactionLog(const std::string& path) :
+    path(path),
+    fd(-1),
+    bytes(0) {
+}
+
+TransactionLog::~TransactionLog() {
+    if (fd >= 0) ::close(fd);
+}
+
+bool TransactionLog::open() {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    struct stat info;
+    bytes = ::fstat(fd, &info) == 0 ? info.st_size : 0;
+    return true;
+}
+
+bool TransactionLog::append(const TransactionRecord& record) {
+    std::string text = encodeRecord(record);
+    if (::write(fd, text.data(), text.size()) != (ssize_t)text.size() || ::fsync(fd) != 0) {
+        return false;
+    }
+    bytes += text.size();
+    return true;
+}
+
+// 末尾不完整的记录（写到一半崩溃）直接丢弃
+bool TransactionLog::replay(std::function<void(const TransactionRecord&)> apply) const {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream in(line);
+        std::string tag;
+        size_t count = 0;
+        TransactionRecord record;
+        in >> tag >> record.requestId >> record.result.kind >> record.result.amount >> record.committedAt >> count;
+        if (tag != "R" || in.fail()) continue;
+        if (record.requestId == "-") record.requestId.clear();
+
+        bool complete = true;
+        for (size_t i = 0; i < count; i++) {
+            size_t tab;
+            if (!std::getline(file, line) || (tab = line.find('\t')) == std::string::npos) {
+                complete = false;
+                break;
+            }
+            record.changes.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+        }
+        if (!complete) break;
+        apply(record);
+    }
+    return true;
+}
+
+bool TransactionLog::rewrite(const std::vector<TransactionRecord>& records) {
+    std::string tmp = path + ".tmp";
+    int tmpFd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (tmpFd < 0) return false;
+
+    std::string text;
+    for (const auto& record : records) {
+        text += encodeRecord(record);
+    }
+    bool ok = ::write(tmpFd, text.data(), text.size()) == (ssize_t)text.size() && ::fsync(tmpFd) == 0;
+    ::close(tmpFd);
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) return false;
+
+    if (fd >= 0) ::close(fd);
+    return open();
+}
+
+// 新日志的目录项也要落盘，否则掉电后fsync过的记录可能随文件一起消失
+bool TransactionLog::rotate(const std::string& rotatedPath) {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    bool renamed = std::rename(path.c_str(), rotatedPath.c_str()) == 0;
+    return open() && renamed && syncParentDirectory(path);
+}
+
+bool TransactionLog::compact(int64_t keepAfter) {
+    std::vector<TransactionRecord> recent;
+    replay([&](const TransactionRecord& record) {
+        if (!record.requestId.empty() && record.committedAt > keepAfter) {
+            recent.push_back({ record.requestId, record.result, record.committedAt, ChangeBatch() });
+        }
+    });
+    return rewrite(recent);
+}
@@ -0,0 +1,44 @@
+#ifndef TRANSACTION_LOG_H
+#define TRANSACTION_LOG_H
+
+#include "replication.h"
+#include "request_dedup.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// 事务日志中的一条记录：一次提交的全部修改以及发起它的请求
+struct TransactionRecord {
+    std::string requestId;
+    RequestResult result;
+    int64_t committedAt;
+    ChangeBatch changes;
+};
+
+// 追加写、逐条fsync的事务日志（预写日志）。格式：
+//   R <请求ID|-> <kind> <amount> <时间> <修改条数>
+//   key\tvalue  ...
+class TransactionLog {
+public:
+    TransactionLog(const std::string& path);
+    ~TransactionLog();
+
+    bool open();
+    bool append(const TransactionRecord& record);
+    bool replay(std::function<void(const TransactionRecord&)> apply) const;
+    // 用给定记录替换整个日志
+    bool rewrite(const std::vector<TransactionRecord>& records);
+    // 数据文件已包含全部修改后调用：只保留keepAfter之后提交的请求结果（去掉修改内容）
+    bool compact(int64_t keepAfter);
+    // 检查点开始时调用：当前日志改名为rotatedPath，之后的提交写入新建的空日志
+    bool rotate(const std::string& rotatedPath);
+    size_t size() const { return bytes; }
+
+private:
+    std::string path;
+    int fd;
+    size_t bytes;
+};
+
+#endif